@@ -17,7 +17,7 @@ writer = generator.writer
 toolchain = generator.toolchain
 
 network_lib = generator.lib( module = 'network', sources = [
-  'address.c', 'network.c', 'poll.c', 'socket.c', 'tcp.c', 'udp.c', 'version.c' ] )
+  'address.c', 'buffer.c', 'capture.c', 'frame.c', 'network.c', 'poll.c', 'socket.c', 'tcp.c', 'trace.c', 'transform.c', 'udp.c', 'version.c' ] )
 
 includepaths = generator.test_includepaths()
 
@@ -29,6 +29,7 @@ if not target.is_ios() and not target.is_android():
   configs = [ config for config in toolchain.configs if config not in [ 'profile', 'deploy' ] ]
   if not configs == []:
     generator.bin( 'blast', [ 'main.c', 'client.c', 'reader.c', 'server.c', 'writer.c' ], 'blast', basepath = 'tools', implicit_deps = [ network_lib ], libs = [ 'network', 'foundation' ] + extralibs, configs = configs )
+    generator.bin( 'tracedump', [ 'main.c' ], 'tracedump', basepath = 'tools', implicit_deps = [ network_lib ], libs = [ 'network', 'foundation' ] + extralibs, configs = configs )
 
 test_cases = [
   'address', 'socket', 'tcp', 'udp'
@@ -0,0 +1,252 @@
+/* buffer.c  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <network/buffer.h>
+#include <network/internal.h>
+#include <network/hashstrings.h>
+
+#include <foundation/foundation.h>
+
+typedef struct network_buffer_free_t network_buffer_free_t;
+typedef struct network_buffer_cache_t network_buffer_cache_t;
+
+//Idle buffers are chained through their own first bytes
+struct network_buffer_free_t {
+	network_buffer_free_t* next;
+};
+
+//Buffers released by a thread are kept for its next acquire of the same class, so a
+//stream draining and refilling its buffer on every read never takes the shared lock
+struct network_buffer_cache_t {
+	network_buffer_free_t* free[NETWORK_BUFFER_CLASSES];
+	unsigned int count[NETWORK_BUFFER_CLASSES];
+};
+
+static mutex_t* _network_buffer_lock;
+static network_buffer_free_t* _network_buffer_free[NETWORK_BUFFER_CLASSES];
+static atomic64_t _network_buffer_allocated;
+static atomic64_t _network_buffer_in_use;
+static atomic64_t _network_buffer_cached;
+static atomic64_t _network_buffer_count;
+
+//Thread exit hook returning the thread cache to the shared lists
+static network_thread_key_t _network_buffer_key;
+static bool _network_buffer_key_valid;
+
+FOUNDATION_DECLARE_THREAD_LOCAL(network_buffer_cache_t*, buffer_cache, 0)
+
+static unsigned int
+_network_buffer_class(size_t size) {
+	unsigned int sizeclass = 0;
+	while ((sizeclass < NETWORK_BUFFER_CLASSES - 1) && (((size_t)64 << sizeclass) < size))
+		++sizeclass;
+	return sizeclass;
+}
+
+static void
+_network_buffer_cache_flush(network_buffer_cache_t* cache) {
+	unsigned int sizeclass;
+
+	mutex_lock(_network_buffer_lock);
+	for (sizeclass = 0; sizeclass < NETWORK_BUFFER_CLASSES; ++sizeclass) {
+		while (cache->free[sizeclass]) {
+			network_buffer_free_t* entry = cache->free[sizeclass];
+			cache->free[sizeclass] = entry->next;
+			entry->next = _network_buffer_free[sizeclass];
+			_network_buffer_free[sizeclass] = entry;
+		}
+		cache->count[sizeclass] = 0;
+	}
+	mutex_unlock(_network_buffer_lock);
+}
+
+static void NETWORK_THREAD_EXIT_CALL
+_network_buffer_thread_exit(void* arg) {
+	network_buffer_cache_t* cache = arg;
+	if (!_network_buffer_key_valid)
+		return;
+	_network_buffer_cache_flush(cache);
+	memory_deallocate(cache);
+}
+
+static network_buffer_cache_t*
+_network_buffer_thread_cache(void) {
+	network_buffer_cache_t* cache = get_thread_buffer_cache();
+	if (!cache && _network_buffer_key_valid) {
+		cache = memory_allocate(HASH_NETWORK, sizeof(network_buffer_cache_t), 0,
+		                        MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		_network_thread_key_set(_network_buffer_key, cache);
+		set_thread_buffer_cache(cache);
+	}
+	return cache;
+}
+
+int
+network_buffer_module_initialize(void) {
+	_network_buffer_lock = mutex_allocate(STRING_CONST("network_buffer"));
+	atomic_store64(&_network_buffer_allocated, 0);
+	atomic_store64(&_network_buffer_in_use, 0);
+	atomic_store64(&_network_buffer_cached, 0);
+	atomic_store64(&_network_buffer_count, 0);
+	_network_buffer_key_valid = _network_thread_key_allocate(&_network_buffer_key, _network_buffer_thread_exit);
+	return 0;
+}
+
+void
+network_buffer_module_finalize(void) {
+	network_buffer_cache_t* cache = get_thread_buffer_cache();
+	int64_t buffers = atomic_load64(&_network_buffer_count);
+
+	//Only the calling thread cache can be reclaimed, threads still running keep theirs
+	if (cache) {
+		_network_thread_key_set(_network_buffer_key, 0);
+		_network_buffer_cache_flush(cache);
+		memory_deallocate(cache);
+		set_thread_buffer_cache(0);
+	}
+	if (_network_buffer_key_valid) {
+		_network_buffer_key_valid = false;
+		_network_thread_key_deallocate(_network_buffer_key);
+	}
+
+	network_buffer_pool_trim(0);
+	if (buffers)
+		log_warnf(HASH_NETWORK, WARNING_MEMORY,
+		          STRING_CONST("Stream buffer pool finalized with %" PRIsize " buffers (%" PRIsize " bytes) in use"),
+		          (size_t)buffers, (size_t)atomic_load64(&_network_buffer_in_use));
+
+	mutex_deallocate(_network_buffer_lock);
+	_network_buffer_lock = 0;
+}
+
+void*
+_network_buffer_acquire(size_t size) {
+	unsigned int sizeclass = _network_buffer_class(size);
+	size_t capacity = (size_t)64 << sizeclass;
+	network_buffer_cache_t* cache;
+	network_buffer_free_t* buffer = 0;
+
+	if ((capacity < size) || !_network_buffer_lock)
+		return memory_allocate(HASH_NETWORK, size, 0, MEMORY_PERSISTENT);
+
+	cache = _network_buffer_thread_cache();
+	if (cache && cache->free[sizeclass]) {
+		buffer = cache->free[sizeclass];
+		cache->free[sizeclass] = buffer->next;
+		--cache->count[sizeclass];
+	}
+	else {
+		mutex_lock(_network_buffer_lock);
+		buffer = _network_buffer_free[sizeclass];
+		if (buffer)
+			_network_buffer_free[sizeclass] = buffer->next;
+		mutex_unlock(_network_buffer_lock);
+	}
+
+	if (buffer) {
+		atomic_add64(&_network_buffer_cached, -(int64_t)capacity);
+	}
+	else {
+		atomic_add64(&_network_buffer_allocated, (int64_t)capacity);
+		buffer = memory_allocate(HASH_NETWORK, capacity, 0, MEMORY_PERSISTENT);
+	}
+	atomic_add64(&_network_buffer_in_use, (int64_t)capacity);
+	atomic_add64(&_network_buffer_count, 1);
+
+	return buffer;
+}
+
+void
+_network_buffer_release(void* buffer, size_t size) {
+	unsigned int sizeclass = _network_buffer_class(size);
+	size_t capacity = (size_t)64 << sizeclass;
+	network_buffer_free_t* entry = buffer;
+	network_buffer_cache_t* cache;
+
+	if (!buffer)
+		return;
+
+	if ((capacity < size) || !_network_buffer_lock) {
+		memory_deallocate(buffer);
+		return;
+	}
+
+	atomic_add64(&_network_buffer_in_use, -(int64_t)capacity);
+	atomic_add64(&_network_buffer_count, -1);
+	if ((size_t)atomic_add64(&_network_buffer_cached, (int64_t)capacity) > _network_config.stream_buffer_pool_size) {
+		atomic_add64(&_network_buffer_cached, -(int64_t)capacity);
+		atomic_add64(&_network_buffer_allocated, -(int64_t)capacity);
+		memory_deallocate(buffer);
+		return;
+	}
+
+	cache = _network_buffer_thread_cache();
+	if (cache && (cache->count[sizeclass] < NETWORK_BUFFER_CACHE_DEPTH)) {
+		entry->next = cache->free[sizeclass];
+		cache->free[sizeclass] = entry;
+		++cache->count[sizeclass];
+		return;
+	}
+
+	mutex_lock(_network_buffer_lock);
+	entry->next = _network_buffer_free[sizeclass];
+	_network_buffer_free[sizeclass] = entry;
+	mutex_unlock(_network_buffer_lock);
+}
+
+network_buffer_pool_usage_t
+network_buffer_pool_usage(void) {
+	network_buffer_pool_usage_t usage;
+	usage.allocated = (size_t)atomic_load64(&_network_buffer_allocated);
+	usage.in_use = (size_t)atomic_load64(&_network_buffer_in_use);
+	usage.cached = (size_t)atomic_load64(&_network_buffer_cached);
+	usage.buffers = (size_t)atomic_load64(&_network_buffer_count);
+	return usage;
+}
+
+size_t
+network_buffer_pool_trim(size_t keep) {
+	network_buffer_cache_t* cache = get_thread_buffer_cache();
+	network_buffer_free_t* release = 0;
+	size_t released = 0;
+	unsigned int sizeclass;
+
+	if (!_network_buffer_lock)
+		return 0;
+
+	//Buffers cached by the calling thread are trimmed too, other threads keep theirs
+	if (cache)
+		_network_buffer_cache_flush(cache);
+
+	//Release largest buffers first, unlink under lock and free outside it
+	mutex_lock(_network_buffer_lock);
+	for (sizeclass = NETWORK_BUFFER_CLASSES; sizeclass-- > 0;) {
+		size_t capacity = (size_t)64 << sizeclass;
+		while (_network_buffer_free[sizeclass] && ((size_t)atomic_load64(&_network_buffer_cached) > keep)) {
+			network_buffer_free_t* entry = _network_buffer_free[sizeclass];
+			_network_buffer_free[sizeclass] = entry->next;
+			entry->next = release;
+			release = entry;
+			atomic_add64(&_network_buffer_cached, -(int64_t)capacity);
+			atomic_add64(&_network_buffer_allocated, -(int64_t)capacity);
+			released += capacity;
+		}
+	}
+	mutex_unlock(_network_buffer_lock);
+
+	while (release) {
+		network_buffer_free_t* next = release->next;
+		memory_deallocate(release);
+		release = next;
+	}
+
+	return released;
+}
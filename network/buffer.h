@@ -0,0 +1,32 @@
+/* buffer.h  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#pragma once
+
+/*! \file buffer.h
+    Shared buffer pool for socket streams */
+
+#include <foundation/platform.h>
+
+#include <network/types.h>
+
+/*! Query memory usage of the shared stream buffer pool. Socket streams borrow buffers
+from the pool only while holding unread or unflushed data, idle streams hold no buffers.
+\return Current pool memory usage */
+NETWORK_API network_buffer_pool_usage_t
+network_buffer_pool_usage(void);
+
+/*! Release cached idle buffers in the pool back to the system, for example in
+response to memory pressure
+\param keep Maximum number of bytes of idle buffers to keep cached
+\return     Number of bytes released */
+NETWORK_API size_t
+network_buffer_pool_trim(size_t keep);
@@ -18,6 +18,10 @@
 
 #include <network/types.h>
 
-/*! Dump network traffic to log (debug). Dump read/write information if > 0,
-dump full traffic (payload data) if > 1 */
+/*! Dump network read/write information to log (debug) if > 0. Payload data
+is captured at runtime with #network_capture_start */
 #define BUILD_ENABLE_NETWORK_DUMP_TRAFFIC     0
+
+/*! Compile binary event trace points, recording is enabled at runtime with
+#network_trace_enable */
+#define BUILD_ENABLE_NETWORK_TRACE            1
@@ -0,0 +1,393 @@
+/* capture.c  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <network/capture.h>
+#include <network/internal.h>
+#include <network/hashstrings.h>
+
+#include <foundation/foundation.h>
+
+#if FOUNDATION_PLATFORM_WINDOWS
+#  include <foundation/windows.h>
+#endif
+
+/*! Nanosecond resolution pcap file magic */
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+
+/*! Link type for raw IPv4/IPv6 packets without link layer header */
+#define PCAP_LINKTYPE_RAW 101
+
+/*! Size of pcap record header plus largest synthesized IP and transport header */
+#define PCAP_HEADER_MAX (16 + 40 + 20)
+
+typedef struct network_capture_file_header_t network_capture_file_header_t;
+typedef struct network_capture_record_t network_capture_record_t;
+typedef struct network_capture_t network_capture_t;
+
+//pcap global header, all fields in native byte order as identified by the magic
+struct network_capture_file_header_t {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t  thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+};
+
+struct network_capture_record_t {
+	atomic64_t sequence;
+	tick_t     tick;
+	uint32_t   length;
+	uint32_t   captured;
+	uint32_t   offset;
+	uint32_t   ack;
+	uint8_t    ipv6;
+	uint8_t    datagram;
+	uint8_t    outbound;
+	uint8_t    _unused;
+	uint16_t   local_port;
+	uint16_t   remote_port;
+	uint8_t    local_ip[16];
+	uint8_t    remote_ip[16];
+	uint8_t    data[FOUNDATION_FLEXIBLE_ARRAY];
+};
+
+struct network_capture_t {
+	atomic64_t head;
+	int64_t    tail;
+	size_t     snaplen;
+	size_t     stride;
+	stream_t*  stream;
+	tick_t     tick_base;
+	uint64_t   time_base;
+	thread_t   thread;
+	uint8_t*   packet;
+	uint8_t*   records;
+};
+
+atomic32_t _network_capture_mode;
+static atomicptr_t _network_capture_active;
+static atomic32_t _network_capture_users;
+static atomic32_t _network_capture_dropped;
+
+static network_capture_record_t*
+_network_capture_record(network_capture_t* capture, int64_t pos) {
+	size_t index = (size_t)pos & (NETWORK_CAPTURE_RING_SIZE - 1);
+	return (network_capture_record_t*)(capture->records + (index * capture->stride));
+}
+
+static void
+_network_capture_address(const network_address_t* address, uint8_t* ip, uint16_t* port) {
+	if (!address)
+		return;
+	if (address->family == NETWORK_ADDRESSFAMILY_IPV6) {
+		const network_address_ipv6_t* address_ipv6 = (const network_address_ipv6_t*)address;
+		memcpy(ip, &address_ipv6->saddr.sin6_addr, 16);
+		*port = address_ipv6->saddr.sin6_port;
+	}
+	else {
+		const network_address_ipv4_t* address_ipv4 = (const network_address_ipv4_t*)address;
+		memcpy(ip, &address_ipv4->saddr.sin_addr, 4);
+		*port = address_ipv4->saddr.sin_port;
+	}
+}
+
+void
+_network_capture(socket_t* sock, bool outbound, uint64_t offset, const socket_iovec_t* iov,
+                 size_t count, size_t size, const network_address_t* remote) {
+	network_capture_t* capture;
+	network_capture_record_t* record = 0;
+	socket_base_t* sockbase;
+	int64_t pos;
+
+	if (sock->base < 0)
+		return;
+
+	atomic_incr32(&_network_capture_users);
+	capture = atomic_load_ptr(&_network_capture_active);
+	if (!capture) {
+		atomic_decr32(&_network_capture_users);
+		return;
+	}
+
+	//Claim a free record, bounded multi-producer queue with per-record sequence numbers
+	pos = atomic_load64(&capture->head);
+	while (!record) {
+		network_capture_record_t* candidate = _network_capture_record(capture, pos);
+		int64_t diff = atomic_load64(&candidate->sequence) - pos;
+		if (!diff) {
+			if (atomic_cas64(&capture->head, pos + 1, pos))
+				record = candidate;
+			else
+				pos = atomic_load64(&capture->head);
+		}
+		else if (diff < 0) {
+			atomic_incr32(&_network_capture_dropped);
+			atomic_decr32(&_network_capture_users);
+			return;
+		}
+		else {
+			pos = atomic_load64(&capture->head);
+		}
+	}
+
+	sockbase = _socket_base + sock->base;
+	record->tick = time_current();
+	record->length = (uint32_t)size;
+	record->offset = (uint32_t)offset;
+	record->ack = (uint32_t)(outbound ? sock->bytes_read : sock->bytes_written);
+	record->ipv6 = (sock->family == NETWORK_ADDRESSFAMILY_IPV6);
+	record->datagram = ((sockbase->flags & SOCKETFLAG_DATAGRAM) != 0);
+	record->outbound = outbound;
+	record->local_port = 0;
+	record->remote_port = 0;
+	memset(record->local_ip, 0, sizeof(record->local_ip));
+	memset(record->remote_ip, 0, sizeof(record->remote_ip));
+	_network_capture_address(sock->address_local, record->local_ip, &record->local_port);
+	_network_capture_address(remote, record->remote_ip, &record->remote_port);
+
+	record->captured = 0;
+	if (iov) {
+		size_t iiov;
+		size_t snaplen = (size < capture->snaplen) ? size : capture->snaplen;
+		for (iiov = 0; (iiov < count) && (record->captured < snaplen); ++iiov) {
+			size_t copy = iov[iiov].length;
+			if (copy > snaplen - record->captured)
+				copy = snaplen - record->captured;
+			memcpy(record->data + record->captured, iov[iiov].buffer, copy);
+			record->captured += (uint32_t)copy;
+		}
+	}
+
+	atomic_thread_fence_release();
+	atomic_store64(&record->sequence, pos + 1);
+	atomic_decr32(&_network_capture_users);
+}
+
+void
+_network_capture_buffer(socket_t* sock, bool outbound, uint64_t offset, const void* buffer,
+                        size_t size, const network_address_t* remote) {
+	socket_iovec_t iov;
+	iov.buffer = (void*)buffer;
+	iov.length = (unsigned long)size;
+	_network_capture(sock, outbound, offset, &iov, 1, size, remote);
+}
+
+static uint16_t
+_network_capture_checksum(const uint8_t* header, size_t size) {
+	uint32_t sum = 0;
+	size_t ofs;
+	for (ofs = 0; ofs < size; ofs += 2)
+		sum += ((uint32_t)header[ofs] << 8) | header[ofs + 1];
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t)~sum;
+}
+
+static void
+_network_capture_store16(uint8_t* dest, uint16_t value) {
+	dest[0] = (uint8_t)(value >> 8);
+	dest[1] = (uint8_t)value;
+}
+
+static void
+_network_capture_store32(uint8_t* dest, uint32_t value) {
+	dest[0] = (uint8_t)(value >> 24);
+	dest[1] = (uint8_t)(value >> 16);
+	dest[2] = (uint8_t)(value >> 8);
+	dest[3] = (uint8_t)value;
+}
+
+static void
+_network_capture_write(network_capture_t* capture, const network_capture_record_t* record) {
+	uint8_t* packet = capture->packet;
+	uint8_t* ip = packet + 16;
+	uint8_t* transport;
+	const uint8_t* src_ip = record->outbound ? record->local_ip : record->remote_ip;
+	const uint8_t* dst_ip = record->outbound ? record->remote_ip : record->local_ip;
+	uint16_t src_port = record->outbound ? record->local_port : record->remote_port;
+	uint16_t dst_port = record->outbound ? record->remote_port : record->local_port;
+	size_t ip_size = record->ipv6 ? 40 : 20;
+	size_t transport_size = record->datagram ? 8 : 20;
+	size_t total = ip_size + transport_size + record->length;
+	uint64_t time = capture->time_base +
+	                (uint64_t)(time_ticks_to_seconds(record->tick - capture->tick_base) * 1000000000.0);
+	uint32_t header[4];
+
+	header[0] = (uint32_t)(time / 1000000000ULL);
+	header[1] = (uint32_t)(time % 1000000000ULL);
+	header[2] = (uint32_t)(ip_size + transport_size + record->captured);
+	header[3] = (uint32_t)total;
+	memcpy(packet, header, sizeof(header));
+
+	memset(ip, 0, ip_size + transport_size);
+	if (record->ipv6) {
+		ip[0] = 0x60;
+		_network_capture_store16(ip + 4, (uint16_t)(((transport_size + record->length) > 0xFFFF) ? 0xFFFF :
+		                                            (transport_size + record->length)));
+		ip[6] = record->datagram ? IPPROTO_UDP : IPPROTO_TCP;
+		ip[7] = 64;
+		memcpy(ip + 8, src_ip, 16);
+		memcpy(ip + 24, dst_ip, 16);
+	}
+	else {
+		ip[0] = 0x45;
+		_network_capture_store16(ip + 2, (uint16_t)((total > 0xFFFF) ? 0xFFFF : total));
+		ip[6] = 0x40;
+		ip[8] = 64;
+		ip[9] = record->datagram ? IPPROTO_UDP : IPPROTO_TCP;
+		memcpy(ip + 12, src_ip, 4);
+		memcpy(ip + 16, dst_ip, 4);
+		_network_capture_store16(ip + 10, _network_capture_checksum(ip, 20));
+	}
+
+	//Ports are stored in network byte order
+	transport = ip + ip_size;
+	memcpy(transport, &src_port, 2);
+	memcpy(transport + 2, &dst_port, 2);
+	if (record->datagram) {
+		_network_capture_store16(transport + 4, (uint16_t)(((8 + record->length) > 0xFFFF) ? 0xFFFF :
+		                                                   (8 + record->length)));
+	}
+	else {
+		_network_capture_store32(transport + 4, record->offset);
+		_network_capture_store32(transport + 8, record->ack);
+		transport[12] = 0x50;
+		transport[13] = 0x18; //PSH | ACK
+		_network_capture_store16(transport + 14, 0xFFFF);
+	}
+
+	memcpy(transport + transport_size, record->data, record->captured);
+	stream_write(capture->stream, packet, 16 + ip_size + transport_size + record->captured);
+}
+
+static size_t
+_network_capture_drain(network_capture_t* capture) {
+	size_t written = 0;
+	while (true) {
+		network_capture_record_t* record = _network_capture_record(capture, capture->tail);
+		if (atomic_load64(&record->sequence) != capture->tail + 1)
+			break;
+		atomic_thread_fence_acquire();
+		_network_capture_write(capture, record);
+		atomic_store64(&record->sequence, capture->tail + NETWORK_CAPTURE_RING_SIZE);
+		++capture->tail;
+		++written;
+	}
+	if (written)
+		stream_flush(capture->stream);
+	return written;
+}
+
+static void*
+_network_capture_thread(void* arg) {
+	network_capture_t* capture = arg;
+	while (!thread_try_wait(NETWORK_CAPTURE_INTERVAL))
+		_network_capture_drain(capture);
+	_network_capture_drain(capture);
+	return 0;
+}
+
+bool
+network_capture_start(const char* path, size_t length, size_t snaplen, unsigned int flags) {
+	network_capture_t* capture;
+	stream_t* stream;
+	size_t stride;
+	size_t irec;
+	network_capture_file_header_t header;
+
+	if (atomic_load_ptr(&_network_capture_active)) {
+		log_warn(HASH_NETWORK, WARNING_SUSPICIOUS, STRING_CONST("Traffic capture already active"));
+		return false;
+	}
+
+	stream = stream_open(path, length, STREAM_OUT | STREAM_BINARY | STREAM_CREATE | STREAM_TRUNCATE);
+	if (!stream) {
+		log_errorf(HASH_NETWORK, ERROR_SYSTEM_CALL_FAIL, STRING_CONST("Unable to open capture file: %.*s"),
+		           (int)length, path);
+		return false;
+	}
+
+	if (!snaplen)
+		snaplen = NETWORK_CAPTURE_SNAPLEN;
+	stride = (sizeof(network_capture_record_t) + snaplen + 15) & ~(size_t)15;
+
+	capture = memory_allocate(HASH_NETWORK, sizeof(network_capture_t) + PCAP_HEADER_MAX + snaplen +
+	                          (stride * NETWORK_CAPTURE_RING_SIZE), 16, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	capture->snaplen = snaplen;
+	capture->stride = stride;
+	capture->stream = stream;
+	capture->records = pointer_offset(capture, sizeof(network_capture_t));
+	capture->packet = capture->records + (stride * NETWORK_CAPTURE_RING_SIZE);
+	for (irec = 0; irec < NETWORK_CAPTURE_RING_SIZE; ++irec)
+		atomic_store64(&_network_capture_record(capture, (int64_t)irec)->sequence, (int64_t)irec);
+
+	capture->tick_base = time_current();
+	capture->time_base = (uint64_t)time_system() * 1000000ULL;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = PCAP_MAGIC_NSEC;
+	header.version_major = 2;
+	header.version_minor = 4;
+	header.snaplen = 0xFFFF;
+	header.network = PCAP_LINKTYPE_RAW;
+	stream_write(stream, &header, sizeof(header));
+
+	thread_initialize(&capture->thread, _network_capture_thread, capture, STRING_CONST("network_capture"),
+	                  THREAD_PRIORITY_BELOWNORMAL, 0);
+	thread_start(&capture->thread);
+
+	atomic_store32(&_network_capture_dropped, 0);
+	atomic_store_ptr(&_network_capture_active, capture);
+	atomic_store32(&_network_capture_mode, NETWORKCAPTURE_MODE_SOCKET |
+	               ((flags & NETWORKCAPTURE_ALL_SOCKETS) ? NETWORKCAPTURE_MODE_ALL : 0));
+
+	log_infof(HASH_NETWORK, STRING_CONST("Started traffic capture to %.*s"), (int)length, path);
+
+	return true;
+}
+
+void
+network_capture_stop(void) {
+	network_capture_t* capture = atomic_load_ptr(&_network_capture_active);
+	if (!capture)
+		return;
+
+	atomic_store32(&_network_capture_mode, 0);
+	atomic_store_ptr(&_network_capture_active, 0);
+	while (atomic_load32(&_network_capture_users))
+		thread_yield();
+
+	//Capture thread drains remaining records before exiting
+	thread_signal(&capture->thread);
+	thread_finalize(&capture->thread);
+
+	if (atomic_load32(&_network_capture_dropped))
+		log_warnf(HASH_NETWORK, WARNING_PERFORMANCE,
+		          STRING_CONST("Traffic capture dropped %d records, ring full"),
+		          atomic_load32(&_network_capture_dropped));
+
+	stream_deallocate(capture->stream);
+	memory_deallocate(capture);
+
+	log_info(HASH_NETWORK, STRING_CONST("Stopped traffic capture"));
+}
+
+bool
+network_capture_is_active(void) {
+	return atomic_load_ptr(&_network_capture_active) != 0;
+}
+
+size_t
+network_capture_dropped(void) {
+	return (size_t)atomic_load32(&_network_capture_dropped);
+}
@@ -0,0 +1,45 @@
+/* capture.h  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#pragma once
+
+/*! \file capture.h
+    Runtime traffic capture to pcap files */
+
+#include <foundation/platform.h>
+
+#include <network/types.h>
+
+/*! Start capturing socket traffic to a pcap file. Payload is copied into a lock-free ring
+on the I/O path and written by a background thread with synthesized IP and TCP/UDP headers,
+records are dropped if the ring is full. Only sockets marked with #socket_set_capture are
+captured unless NETWORKCAPTURE_ALL_SOCKETS is given.
+\param path    File path
+\param length  Length of file path
+\param snaplen Maximum number of payload bytes stored per packet, 0 for default
+\param flags   Combination of network_capture_flag_t flags
+\return        true if capture started, false if already active or file could not be opened */
+NETWORK_API bool
+network_capture_start(const char* path, size_t length, size_t snaplen, unsigned int flags);
+
+/*! Stop capturing traffic, writing all pending records and closing the capture file */
+NETWORK_API void
+network_capture_stop(void);
+
+/*! Query if traffic capture is active
+\return true if active, false if not */
+NETWORK_API bool
+network_capture_is_active(void);
+
+/*! Query number of records dropped because the capture ring was full
+\return Number of dropped records since capture was started */
+NETWORK_API size_t
+network_capture_dropped(void);
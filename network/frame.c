@@ -0,0 +1,301 @@
+/* frame.c  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <network/frame.h>
+#include <network/socket.h>
+#include <network/internal.h>
+#include <network/hashstrings.h>
+
+#include <foundation/foundation.h>
+
+//Maximum encoded size of a length prefix (64-bit varint)
+#define SOCKET_FRAME_PREFIX_MAX 10
+
+socket_framer_t*
+socket_framer_allocate(socket_t* sock, socket_frame_prefix_t prefix, size_t max_size) {
+	socket_framer_t* framer = memory_allocate(HASH_NETWORK, sizeof(socket_framer_t), 0,
+	                                          MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	framer->sock = sock;
+	framer->stream = socket_stream(sock);
+	framer->prefix = prefix;
+	framer->max_size = max_size;
+	return framer;
+}
+
+void
+socket_framer_deallocate(socket_framer_t* framer) {
+	if (!framer)
+		return;
+	if (framer->stream)
+		stream_deallocate(framer->stream);
+	memory_deallocate(framer->scratch);
+	memory_deallocate(framer->tail);
+	memory_deallocate(framer);
+}
+
+static size_t
+_socket_framer_encode(socket_frame_prefix_t prefix, uint8_t* buffer, size_t size) {
+	size_t length = 0;
+	if (prefix == SOCKETFRAME_PREFIX_FIXED32) {
+		buffer[0] = (uint8_t)(size >> 24);
+		buffer[1] = (uint8_t)(size >> 16);
+		buffer[2] = (uint8_t)(size >> 8);
+		buffer[3] = (uint8_t)size;
+		return 4;
+	}
+	do {
+		uint8_t byte = (uint8_t)(size & 0x7F);
+		size >>= 7;
+		buffer[length++] = size ? (byte | 0x80) : byte;
+	}
+	while (size);
+	return length;
+}
+
+//Returns prefix length, 0 if more data is needed or -1 if the prefix is invalid
+static ssize_t
+_socket_framer_decode(socket_framer_t* framer, size_t* size) {
+	socket_stream_view_t view;
+	const uint8_t* data;
+	uint64_t value = 0;
+	size_t ibyte;
+
+	if (framer->prefix == SOCKETFRAME_PREFIX_FIXED32) {
+		view = socket_stream_peek(framer->stream, 4);
+		if (view.length < 4)
+			return 0;
+		data = view.buffer;
+		*size = ((size_t)data[0] << 24) | ((size_t)data[1] << 16) | ((size_t)data[2] << 8) | data[3];
+		return 4;
+	}
+
+	view = socket_stream_peek(framer->stream, 1);
+	for (ibyte = 0; ibyte < SOCKET_FRAME_PREFIX_MAX; ++ibyte) {
+		if (ibyte >= view.length) {
+			//Only ask for one more byte so a blocking socket never waits past the prefix
+			view = socket_stream_peek(framer->stream, ibyte + 1);
+			if (ibyte >= view.length)
+				return 0;
+		}
+		data = view.buffer;
+		value |= (uint64_t)(data[ibyte] & 0x7F) << (7 * ibyte);
+		if (!(data[ibyte] & 0x80)) {
+			*size = (size_t)value;
+			return (ssize_t)(ibyte + 1);
+		}
+	}
+	return -1;
+}
+
+static bool
+_socket_framer_assemble(socket_framer_t* framer, socket_frame_t* frame) {
+	while (framer->assembled < framer->assemble_size) {
+		socket_stream_view_t view = socket_stream_peek(framer->stream, 1);
+		size_t copy = framer->assemble_size - framer->assembled;
+		if (!view.length)
+			return false;
+		if (copy > view.length)
+			copy = view.length;
+		memcpy(framer->scratch + framer->assembled, view.buffer, copy);
+		socket_stream_consume(framer->stream, copy);
+		framer->assembled += copy;
+	}
+
+	frame->data = framer->scratch;
+	frame->size = framer->assemble_size;
+	framer->assemble_size = 0;
+	framer->assembled = 0;
+	return true;
+}
+
+bool
+socket_framer_read(socket_framer_t* framer, socket_frame_t* frame) {
+	socket_stream_view_t view;
+	ssize_t prefix;
+	size_t size = 0;
+	size_t total;
+
+	if (framer->consume) {
+		socket_stream_consume(framer->stream, framer->consume);
+		framer->consume = 0;
+	}
+
+	if (framer->assemble_size)
+		return _socket_framer_assemble(framer, frame);
+
+	prefix = _socket_framer_decode(framer, &size);
+	if (!prefix)
+		return false;
+
+	if ((prefix < 0) || (size > framer->max_size)) {
+		log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+		          STRING_CONST("Socket framer (0x%" PRIfixPTR "): invalid or oversized message (%" PRIsize
+		                       " bytes, limit %" PRIsize "), closing socket"),
+		          framer->sock, (prefix < 0) ? 0 : size, framer->max_size);
+		socket_close(framer->sock);
+		return false;
+	}
+
+	//Frames that fit the stream buffer are delivered in place once complete
+	total = (size_t)prefix + size;
+	if (total <= socket_stream_read_buffer_size(framer->sock)) {
+		view = socket_stream_peek(framer->stream, total);
+		if (view.length < total)
+			return false;
+		frame->data = pointer_offset_const(view.buffer, prefix);
+		frame->size = size;
+		framer->consume = total;
+		return true;
+	}
+
+	socket_stream_consume(framer->stream, (size_t)prefix);
+	if (framer->scratch_size < size) {
+		memory_deallocate(framer->scratch);
+		framer->scratch = memory_allocate(HASH_NETWORK, size, 0, MEMORY_PERSISTENT);
+		framer->scratch_size = size;
+	}
+	framer->assemble_size = size;
+	framer->assembled = 0;
+	return _socket_framer_assemble(framer, frame);
+}
+
+bool
+socket_framer_write(socket_framer_t* framer, const void* data, size_t size) {
+	socket_frame_t frame;
+	frame.data = data;
+	frame.size = size;
+	return socket_framer_write_batch(framer, &frame, 1) == 1;
+}
+
+static void
+_socket_framer_hold(socket_framer_t* framer, const void* data, size_t size) {
+	if (!size)
+		return;
+	if (framer->tail_capacity < framer->tail_size + size) {
+		size_t capacity = framer->tail_size + size;
+		uint8_t* tail = memory_allocate(HASH_NETWORK, capacity, 0, MEMORY_PERSISTENT);
+		if (framer->tail_size)
+			memcpy(tail, framer->tail, framer->tail_size);
+		memory_deallocate(framer->tail);
+		framer->tail = tail;
+		framer->tail_capacity = capacity;
+	}
+	memcpy(framer->tail + framer->tail_size, data, size);
+	framer->tail_size += size;
+}
+
+//Writes the rest of a started frame through the stream, holding what the stream cannot
+//take so the frame is completed by later writes instead of left truncated on the wire
+static void
+_socket_framer_complete(socket_framer_t* framer, const void* prefix, size_t length,
+                        const void* data, size_t size) {
+	size_t written = length ? stream_write(framer->stream, prefix, length) : 0;
+	if (written < length) {
+		_socket_framer_hold(framer, pointer_offset_const(prefix, written), length - written);
+		_socket_framer_hold(framer, data, size);
+		return;
+	}
+	written = size ? stream_write(framer->stream, data, size) : 0;
+	_socket_framer_hold(framer, pointer_offset_const(data, written), size - written);
+}
+
+static bool
+_socket_framer_flush_tail(socket_framer_t* framer) {
+	size_t written = stream_write(framer->stream, framer->tail, framer->tail_size);
+	if (written && (written < framer->tail_size))
+		memmove(framer->tail, framer->tail + written, framer->tail_size - written);
+	framer->tail_size -= written;
+	return !framer->tail_size;
+}
+
+size_t
+socket_framer_write_batch(socket_framer_t* framer, const socket_frame_t* frames, size_t count) {
+	uint8_t prefix[SOCKET_IOVEC_MAX / 2][SOCKET_FRAME_PREFIX_MAX];
+	socket_iovec_t iov[SOCKET_IOVEC_MAX];
+	size_t sent = 0;
+	bool transformed;
+
+	//Data buffered in the stream and the rest of a started frame must go out first to
+	//preserve message order
+	stream_flush(framer->stream);
+	if (framer->tail_size && !_socket_framer_flush_tail(framer))
+		return 0;
+	//Transformed streams must encode every frame, never write around the stream
+	transformed = (framer->sock->stream->transform_count > 0);
+	if (transformed || (socket_stream_pending_write(framer->stream) > socket_send_queue_size(framer->sock))) {
+		for (; sent < count; ++sent) {
+			size_t length = _socket_framer_encode(framer->prefix, prefix[0], frames[sent].size);
+			size_t written = stream_write(framer->stream, prefix[0], length);
+			if (!written)
+				break;
+			if (written < length) {
+				_socket_framer_complete(framer, prefix[0] + written, length - written,
+				                        frames[sent].data, frames[sent].size);
+				++sent;
+				break;
+			}
+			written = stream_write(framer->stream, frames[sent].data, frames[sent].size);
+			if (written < frames[sent].size) {
+				_socket_framer_complete(framer, 0, 0, pointer_offset_const(frames[sent].data, written),
+				                        frames[sent].size - written);
+				++sent;
+				break;
+			}
+		}
+		if (transformed)
+			stream_flush(framer->stream);
+		return sent;
+	}
+
+	while (sent < count) {
+		size_t batch = count - sent;
+		size_t iframe, written, total = 0;
+
+		if (batch > SOCKET_IOVEC_MAX / 2)
+			batch = SOCKET_IOVEC_MAX / 2;
+		for (iframe = 0; iframe < batch; ++iframe) {
+			const socket_frame_t* frame = frames + sent + iframe;
+			iov[iframe * 2].buffer = prefix[iframe];
+			iov[iframe * 2].length = _socket_framer_encode(framer->prefix, prefix[iframe], frame->size);
+			iov[(iframe * 2) + 1].buffer = (void*)frame->data;
+			iov[(iframe * 2) + 1].length = frame->size;
+			total += iov[iframe * 2].length + frame->size;
+		}
+
+		written = socket_writev(framer->sock, iov, batch * 2);
+		if (written < total) {
+			//Count messages that made it out in full and complete the one cut short
+			for (iframe = 0; iframe < batch; ++iframe) {
+				size_t length = iov[iframe * 2].length;
+				size_t size = iov[(iframe * 2) + 1].length;
+				if (written < length + size) {
+					if (written) {
+						if (written < length)
+							_socket_framer_complete(framer, prefix[iframe] + written, length - written,
+							                        iov[(iframe * 2) + 1].buffer, size);
+						else
+							_socket_framer_complete(framer, 0, 0,
+							                        pointer_offset_const(iov[(iframe * 2) + 1].buffer, written - length),
+							                        size - (written - length));
+						++sent;
+					}
+					break;
+				}
+				written -= length + size;
+				++sent;
+			}
+			break;
+		}
+		sent += batch;
+	}
+
+	return sent;
+}
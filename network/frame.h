@@ -0,0 +1,67 @@
+/* frame.h  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#pragma once
+
+/*! \file frame.h
+    Length prefixed message framing over socket streams */
+
+#include <foundation/platform.h>
+
+#include <network/types.h>
+
+/*! Allocate a message framer for a connected socket. Each message is preceded by its
+length, either as a 32-bit big endian integer or as an unsigned LEB128 varint. The
+framer owns the socket stream until deallocated. Transforms added to the socket stream
+apply to the framed data, messages are written through the stream and parsed from
+decoded chunks.
+\param sock     Socket
+\param prefix   Length prefix encoding
+\param max_size Maximum message size, larger messages close the socket
+\return         New framer */
+NETWORK_API socket_framer_t*
+socket_framer_allocate(socket_t* sock, socket_frame_prefix_t prefix, size_t max_size);
+
+/*! Deallocate a message framer and the socket stream it owns
+\param framer Framer */
+NETWORK_API void
+socket_framer_deallocate(socket_framer_t* framer);
+
+/*! Get the next complete message without blocking on a non-blocking socket. Call
+repeatedly on NETWORKEVENT_DATAIN until it returns false. Messages contiguous in the
+stream buffer are returned in place, larger messages are assembled in framer memory.
+The message data is valid until the next call.
+\param framer Framer
+\param frame  Receives the message
+\return       true if a complete message was received, false if more data is needed
+              or the socket was closed due to an invalid or oversized message */
+NETWORK_API bool
+socket_framer_read(socket_framer_t* framer, socket_frame_t* frame);
+
+/*! Send a single message
+\param framer Framer
+\param data   Message data
+\param size   Message size
+\return       true if the message was sent or queued, false if not */
+NETWORK_API bool
+socket_framer_write(socket_framer_t* framer, const void* data, size_t size);
+
+/*! Send a batch of messages with as few system calls as possible, gathering length
+prefixes and message data into vectored writes. A message cut short by a full kernel
+buffer on a non-blocking socket is counted as sent and its remainder is kept in the
+stream buffer and framer memory, to be sent before any later message. Call with no
+messages to push out such a remainder, or use a send queue (#socket_set_send_queue).
+\param framer Framer
+\param frames Messages to send
+\param count  Number of messages
+\return       Number of messages completely sent, queued or held for sending */
+NETWORK_API size_t
+socket_framer_write_batch(socket_framer_t* framer, const socket_frame_t* frames, size_t count);
@@ -25,6 +25,7 @@
 #  include <foundation/windows.h>
 #elif FOUNDATION_PLATFORM_POSIX
 #  include <foundation/posix.h>
+#  include <pthread.h>
 #  include <fcntl.h>
 #  include <sys/select.h>
 #  include <arpa/inet.h>
@@ -45,13 +46,147 @@
 #  endif
 #endif
 
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+#  include <linux/errqueue.h>
+#  include <linux/net_tstamp.h>
+#  include <linux/filter.h>
+#  ifndef SO_ZEROCOPY
+#    define SO_ZEROCOPY 60
+#  endif
+#  ifndef MSG_ZEROCOPY
+#    define MSG_ZEROCOPY 0x4000000
+#  endif
+#  ifndef SO_EE_ORIGIN_ZEROCOPY
+#    define SO_EE_ORIGIN_ZEROCOPY 5
+#  endif
+#  ifndef SO_INCOMING_CPU
+#    define SO_INCOMING_CPU 49
+#  endif
+#  ifndef SO_ATTACH_REUSEPORT_CBPF
+#    define SO_ATTACH_REUSEPORT_CBPF 51
+#  endif
+#  ifndef UDP_SEGMENT
+#    define UDP_SEGMENT 103
+#  endif
+#  ifndef UDP_GRO
+#    define UDP_GRO 104
+#  endif
+#  define NETWORK_HAVE_ZEROCOPY 1
+#  define NETWORK_HAVE_ERRQUEUE 1
+#  define NETWORK_HAVE_REUSEPORT_CBPF 1
+#  define NETWORK_HAVE_UDP_SEGMENT 1
+#else
+#  define NETWORK_HAVE_ZEROCOPY 0
+#  define NETWORK_HAVE_ERRQUEUE 0
+#  define NETWORK_HAVE_REUSEPORT_CBPF 0
+#  define NETWORK_HAVE_UDP_SEGMENT 0
+#endif
+
 typedef enum {
 	SOCKETFLAG_BLOCKING             = 0x00000001,
 	SOCKETFLAG_TCPDELAY             = 0x00000002,
 	SOCKETFLAG_REUSE_ADDR           = 0x00000004,
-	SOCKETFLAG_REUSE_PORT           = 0x00000008
+	SOCKETFLAG_REUSE_PORT           = 0x00000008,
+	SOCKETFLAG_ZEROCOPY             = 0x00000010,
+	SOCKETFLAG_BATCH                = 0x00000020,
+	SOCKETFLAG_TIMESTAMP_RECEIVE    = 0x00000040,
+	SOCKETFLAG_TIMESTAMP_TRANSMIT   = 0x00000080,
+	SOCKETFLAG_CAPTURE              = 0x00000100,
+	SOCKETFLAG_DATAGRAM             = 0x00000200,
+	SOCKETFLAG_SEGMENT_PROBED       = 0x00000400,
+	SOCKETFLAG_SEGMENT_OFFLOAD      = 0x00000800,
+	SOCKETFLAG_RECEIVE_OFFLOAD      = 0x00001000
 } socket_flag_t;
 
+/*! Notifications found by an error queue read */
+typedef enum {
+	SOCKETERRQUEUE_ZEROCOPY         = 0x00000001,
+	SOCKETERRQUEUE_TIMESTAMP        = 0x00000002
+} socket_errqueue_t;
+
+typedef enum {
+	NETWORKCAPTURE_MODE_SOCKET      = 0x00000001,
+	NETWORKCAPTURE_MODE_ALL         = 0x00000002
+} network_capture_mode_t;
+
+/*! Socket type flags applying close-on-exec and the blocking mode atomically at creation */
+#if (FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID) && defined(SOCK_NONBLOCK)
+#  define SOCKET_TYPE_FLAGS(sockbase) \
+	(SOCK_CLOEXEC | (((sockbase)->flags & SOCKETFLAG_BLOCKING) ? 0 : SOCK_NONBLOCK))
+#  define NETWORK_HAVE_SOCKET_TYPE_FLAGS 1
+#else
+#  define SOCKET_TYPE_FLAGS(sockbase) 0
+#  define NETWORK_HAVE_SOCKET_TYPE_FLAGS 0
+#endif
+
+/*! Minimum size of a block in the socket send queue */
+#define SOCKET_QUEUE_BLOCK_SIZE 4096
+
+/*! Number of transmit timestamps buffered per socket between error queue reads and
+#socket_transmit_timestamps, must be a power of two */
+#define SOCKET_TIMESTAMP_QUEUE_SIZE 64
+
+/*! Size of the copy buffer used when sending a file without kernel support */
+#define SOCKET_SENDFILE_BUFFER_SIZE 16384
+
+/*! Minimum write size for zero-copy sends, below this page pinning costs more than the copy */
+#define SOCKET_ZEROCOPY_THRESHOLD 65536
+
+/*! Time in seconds without a full read after which an autotuned stream read buffer
+shrinks back to its initial size */
+#define SOCKET_STREAM_IDLE_TIMEOUT 2
+
+/*! Send queue high watermark used when non-blocking stream writes enable the queue */
+#define SOCKET_STREAM_QUEUE_WATERMARK (256 * 1024)
+
+/*! Maximum number of segments the kernel accepts in a single segmentation offload send */
+#define UDP_SEGMENT_MAX_COUNT 64
+
+/*! Maximum total size of a single segmentation offload send, bounded by the IPv4
+datagram size limit */
+#define UDP_SEGMENT_MAX_SIZE 65507
+
+/*! Size of the buffer receiving coalesced datagrams with receive offload enabled */
+#define UDP_COALESCE_BUFFER_SIZE 65536
+
+/*! Size of the header preceding each transformed stream chunk, encoded and plain size */
+#define SOCKET_STREAM_CHUNK_HEADER 8
+
+/*! Maximum configurable chunk limit of a transformed stream */
+#define SOCKET_STREAM_CHUNK_MAX (16 * 1024 * 1024)
+
+/*! Number of power of two size classes in the stream buffer pool, smallest class is 64 bytes */
+#define NETWORK_BUFFER_CLASSES 26
+
+/*! Number of released buffers per size class kept in each thread for reuse without locking */
+#define NETWORK_BUFFER_CACHE_DEPTH 2
+
+/*! Default number of payload bytes stored per captured packet */
+#define NETWORK_CAPTURE_SNAPLEN 256
+
+/*! Number of records in the capture ring, must be a power of two */
+#define NETWORK_CAPTURE_RING_SIZE 4096
+
+/*! Interval in milliseconds at which the capture thread drains the ring */
+#define NETWORK_CAPTURE_INTERVAL 10
+
+/*! Number of records in each thread trace ring, must be a power of two */
+#define NETWORK_TRACE_RING_SIZE 4096
+
+/*! Record a trace event, a single atomic load when tracing is disabled */
+#if BUILD_ENABLE_NETWORK_TRACE
+#  define NETWORK_TRACE(event, sock, fd, error, bytes) \
+	do { if (atomic_load32(&_network_trace_enabled)) \
+		_network_trace((event), (sock), (int)(fd), (int)(error), (size_t)(bytes)); } while (0)
+#else
+#  define NETWORK_TRACE(event, sock, fd, error, bytes) do {} while (0)
+#endif
+
+/*! Query if traffic on the socket is captured, a single atomic load when capture is stopped */
+#define SOCKET_CAPTURE(sockbase) \
+	(atomic_load32(&_network_capture_mode) & \
+	 (((sockbase)->flags & SOCKETFLAG_CAPTURE) ? NETWORKCAPTURE_MODE_SOCKET : NETWORKCAPTURE_MODE_ALL))
+
 #define NETWORK_DECLARE_NETWORK_ADDRESS_IP   \
 	NETWORK_DECLARE_NETWORK_ADDRESS
 
@@ -80,13 +215,24 @@ typedef struct network_address_ipv6_t {
 #  define SOCKET_INVALID -1
 #endif
 
+#if FOUNDATION_PLATFORM_WINDOWS
+typedef DWORD network_thread_key_t;
+#  define NETWORK_THREAD_EXIT_CALL WINAPI
+#else
+typedef pthread_key_t network_thread_key_t;
+#  define NETWORK_THREAD_EXIT_CALL
+#endif
+
+//Called with the value a thread holds in a thread key when the thread exits
+typedef void (NETWORK_THREAD_EXIT_CALL* network_thread_exit_fn)(void*);
+
 typedef struct socket_base_t socket_base_t;
 
 struct socket_base_t {
 	int      fd;
-	uint32_t flags: 10;
+	uint32_t flags: 16;
 	uint32_t state: 6;
-	uint32_t _unused: 16;
+	uint32_t _unused: 10;
 	atomicptr_t sock;
 };
 
@@ -94,6 +240,8 @@ NETWORK_EXTERN network_config_t  _network_config;
 NETWORK_EXTERN socket_base_t*    _socket_base;
 NETWORK_EXTERN int32_t           _socket_base_size;
 NETWORK_EXTERN atomic32_t        _socket_base_next;
+NETWORK_EXTERN atomic32_t        _network_capture_mode;
+NETWORK_EXTERN atomic32_t        _network_trace_enabled;
 
 NETWORK_API int
 _socket_create_fd(socket_t* sock, network_address_family_t family);
@@ -116,8 +264,70 @@ _socket_available_fd(int fd);
 NETWORK_API socket_state_t
 _socket_poll_state(socket_base_t* sockbase);
 
+NETWORK_API unsigned int
+_socket_read_error_queue(socket_t* sock, socket_timestamp_t* timestamps, size_t capacity, size_t* count);
+
+NETWORK_API void
+_socket_batch_arm(socket_t* sock);
+
+NETWORK_API void
+_network_poll_update_socket(socket_t* sock);
+
+NETWORK_API void
+_network_poll_batch_arm(socket_t* sock);
+
+NETWORK_API void
+_network_poll_batch_disarm(socket_t* sock);
+
+NETWORK_API void
+_socket_autotune_receive_buffer(socket_t* sock, bool dropping);
+
+NETWORK_API bool
+_socket_bind_group(socket_t** sockets, size_t count, const network_address_t* address);
+
+NETWORK_API bool
+_socket_attach_reuseport_cpu(socket_t* sock, size_t count);
+
+NETWORK_API void
+_network_capture(socket_t* sock, bool outbound, uint64_t offset, const socket_iovec_t* iov,
+                 size_t count, size_t size, const network_address_t* remote);
+
+NETWORK_API void
+_network_trace(network_trace_event_t event, const socket_t* sock, int fd, int error, size_t bytes);
+
+NETWORK_API void
+_network_capture_buffer(socket_t* sock, bool outbound, uint64_t offset, const void* buffer,
+                        size_t size, const network_address_t* remote);
+
 NETWORK_API int
 socket_module_initialize(size_t max_sockets);
 
 NETWORK_API void
 socket_module_finalize(void);
+
+NETWORK_API void*
+_network_buffer_acquire(size_t size);
+
+NETWORK_API void
+_network_buffer_release(void* buffer, size_t size);
+
+NETWORK_API bool
+_network_thread_key_allocate(network_thread_key_t* key, network_thread_exit_fn exit_fn);
+
+NETWORK_API void
+_network_thread_key_deallocate(network_thread_key_t key);
+
+NETWORK_API void
+_network_thread_key_set(network_thread_key_t key, void* value);
+
+NETWORK_API int
+network_buffer_module_initialize(void);
+
+NETWORK_API void
+network_buffer_module_finalize(void);
+
+NETWORK_API int
+network_trace_module_initialize(void);
+
+NETWORK_API void
+network_trace_module_finalize(void);
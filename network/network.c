@@ -35,6 +35,11 @@ network_initialize_config(const network_config_t config) {
 	                                           config.stream_write_buffer_size : 1024;
 	_network_config.stream_read_buffer_size  = config.stream_read_buffer_size  ?
 	                                           config.stream_read_buffer_size  : 1024;
+	_network_config.stream_read_buffer_max   = config.stream_read_buffer_max;
+	_network_config.stream_buffer_pool_size  = config.stream_buffer_pool_size  ?
+	                                           config.stream_buffer_pool_size  : 1024 * 1024;
+	_network_config.socket_send_buffer_size    = config.socket_send_buffer_size;
+	_network_config.socket_receive_buffer_size = config.socket_receive_buffer_size;
 }
 
 int
@@ -64,6 +69,12 @@ network_module_initialize(const network_config_t config) {
 	if (socket_module_initialize(_network_config.max_sockets) < 0)
 		return -1;
 
+	if (network_buffer_module_initialize() < 0)
+		return -1;
+
+	if (network_trace_module_initialize() < 0)
+		return -1;
+
 	//Check support
 	fd = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
 	_network_supports_ipv4 = !(fd < 0);
@@ -90,7 +101,10 @@ network_module_finalize(void) {
 
 	log_debug(HASH_NETWORK, STRING_CONST("Terminating network services"));
 
+	network_capture_stop();
 	socket_module_finalize();
+	network_buffer_module_finalize();
+	network_trace_module_finalize();
 
 #if FOUNDATION_PLATFORM_WINDOWS
 	WSACleanup();
@@ -111,3 +125,33 @@ bool
 network_supports_ipv6(void) {
 	return _network_supports_ipv6;
 }
+
+bool
+_network_thread_key_allocate(network_thread_key_t* key, network_thread_exit_fn exit_fn) {
+#if FOUNDATION_PLATFORM_WINDOWS
+	*key = FlsAlloc(exit_fn);
+	return *key != FLS_OUT_OF_INDEXES;
+#else
+	return !pthread_key_create(key, exit_fn);
+#endif
+}
+
+void
+_network_thread_key_deallocate(network_thread_key_t key) {
+	//Windows runs the exit callback for values threads still hold, callbacks must check
+	//that their module is still initialized
+#if FOUNDATION_PLATFORM_WINDOWS
+	FlsFree(key);
+#else
+	pthread_key_delete(key);
+#endif
+}
+
+void
+_network_thread_key_set(network_thread_key_t key, void* value) {
+#if FOUNDATION_PLATFORM_WINDOWS
+	FlsSetValue(key, value);
+#else
+	pthread_setspecific(key, value);
+#endif
+}
@@ -19,9 +19,14 @@
 #include <network/types.h>
 #include <network/hashstrings.h>
 #include <network/address.h>
+#include <network/buffer.h>
+#include <network/capture.h>
+#include <network/frame.h>
 #include <network/poll.h>
 #include <network/socket.h>
 #include <network/tcp.h>
+#include <network/trace.h>
+#include <network/transform.h>
 #include <network/udp.h>
 
 /*! Initialize network functionality. Must be called prior to any other network
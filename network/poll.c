@@ -11,6 +11,7 @@
 
 #include <network/poll.h>
 #include <network/socket.h>
+#include <network/tcp.h>
 #include <network/address.h>
 #include <network/internal.h>
 
@@ -35,11 +36,145 @@
 		++(num); \
 	} } while (false)
 
+static uint32_t
+_network_poll_events(socket_t* sock, socket_base_t* sockbase) {
+	bool connecting = (sockbase->state == SOCKETSTATE_CONNECTING);
+	bool queued = (socket_send_queue_size(sock) > 0);
+#if FOUNDATION_PLATFORM_APPLE
+	return (connecting ? POLLOUT : (POLLIN | (queued ? POLLOUT : 0))) | POLLERR | POLLHUP;
+#elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	return (connecting ? EPOLLOUT : (EPOLLIN | (queued ? EPOLLOUT : 0))) | EPOLLERR | EPOLLHUP;
+#else
+	return (connecting || queued) ? 1 : 0;
+#endif
+}
+
+//Poll lock must be held, interest is computed and applied as one step so an update
+//from another thread can never be overwritten by one computed from older queue state
+static void
+_network_poll_update_slot(network_poll_t* pollobj, size_t islot) {
+	network_poll_slot_t* slot = pollobj->slots + islot;
+	socket_base_t* sockbase = _socket_base + slot->base;
+	uint32_t events;
+
+	if (sockbase->fd != slot->fd)
+		return;
+
+	events = _network_poll_events(slot->sock, sockbase);
+	if (events == slot->events)
+		return;
+
+	slot->events = events;
+#if FOUNDATION_PLATFORM_APPLE
+	pollobj->pollfds[islot].events = (short)events;
+#elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	struct epoll_event event;
+	event.events = events;
+	event.data.fd = (int)islot;
+	epoll_ctl(pollobj->fd_poll, EPOLL_CTL_MOD, slot->fd, &event);
+#endif
+}
+
+void
+_network_poll_update_socket(socket_t* sock) {
+	network_poll_t* pollobj = sock->poll;
+	if (!pollobj)
+		return;
+	mutex_lock(pollobj->lock);
+	if ((sock->poll == pollobj) && (sock->poll_slot < pollobj->num_sockets) &&
+	        (pollobj->slots[sock->poll_slot].sock == sock))
+		_network_poll_update_slot(pollobj, sock->poll_slot);
+	mutex_unlock(pollobj->lock);
+}
+
+//Batch list helpers, poll lock must be held
+static void
+_network_poll_batch_insert(network_poll_t* pollobj, socket_t* sock) {
+	if (sock->poll_batch >= 0)
+		return;
+	sock->poll_batch = (int)pollobj->num_batch;
+	pollobj->batch[pollobj->num_batch++] = sock;
+}
+
+static void
+_network_poll_batch_erase(network_poll_t* pollobj, socket_t* sock) {
+	size_t last;
+	if (sock->poll_batch < 0)
+		return;
+	last = --pollobj->num_batch;
+	if ((size_t)sock->poll_batch < last) {
+		pollobj->batch[sock->poll_batch] = pollobj->batch[last];
+		pollobj->batch[sock->poll_batch]->poll_batch = sock->poll_batch;
+	}
+	sock->poll_batch = -1;
+}
+
+void
+_network_poll_batch_arm(socket_t* sock) {
+	network_poll_t* pollobj = sock->poll;
+	if (!pollobj)
+		return;
+	mutex_lock(pollobj->lock);
+	if (sock->poll == pollobj)
+		_network_poll_batch_insert(pollobj, sock);
+	mutex_unlock(pollobj->lock);
+}
+
+void
+_network_poll_batch_disarm(socket_t* sock) {
+	network_poll_t* pollobj = sock->poll;
+	if (!pollobj)
+		return;
+	mutex_lock(pollobj->lock);
+	if (sock->poll == pollobj)
+		_network_poll_batch_erase(pollobj, sock);
+	mutex_unlock(pollobj->lock);
+}
+
+static unsigned int
+_network_poll_flush_batches(network_poll_t* pollobj, unsigned int timeoutms) {
+	socket_t* due[16];
+	size_t num_due, idue;
+	tick_t now;
+	size_t ibatch;
+
+	if (!pollobj->num_batch)
+		return timeoutms;
+
+	//Due sockets are taken off the list under the lock and flushed after releasing it,
+	//sockets are armed from the threads writing to them
+	now = time_current();
+	do {
+		num_due = 0;
+		mutex_lock(pollobj->lock);
+		//Erasing moves the last entry into the slot, walk backwards so it is already visited
+		for (ibatch = pollobj->num_batch; (ibatch-- > 0) && (num_due < sizeof(due) / sizeof(due[0]));) {
+			socket_t* sock = pollobj->batch[ibatch];
+			tick_t remain;
+			if (now >= sock->batch_flush) {
+				_network_poll_batch_erase(pollobj, sock);
+				due[num_due++] = sock;
+				continue;
+			}
+			remain = ((sock->batch_flush - now) * 1000) / time_ticks_per_second() + 1;
+			if (remain < (tick_t)timeoutms)
+				timeoutms = (unsigned int)remain;
+		}
+		mutex_unlock(pollobj->lock);
+
+		for (idue = 0; idue < num_due; ++idue)
+			tcp_socket_flush_batch(due[idue]);
+	}
+	while (num_due == sizeof(due) / sizeof(due[0]));
+
+	return timeoutms;
+}
+
 network_poll_t*
 network_poll_allocate(unsigned int num_sockets) {
 	network_poll_t* poll;
 	size_t memsize = sizeof(network_poll_t) +
-	                 sizeof(network_poll_slot_t) * num_sockets;
+	                 sizeof(network_poll_slot_t) * num_sockets + sizeof(socket_t*) * num_sockets;
 #if FOUNDATION_PLATFORM_APPLE
 	memsize += sizeof(struct pollfd) * num_sockets;
 #elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
@@ -47,10 +182,12 @@ network_poll_allocate(unsigned int num_sockets) {
 #endif
 	poll = memory_allocate(HASH_NETWORK, memsize, 8, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
 	poll->max_sockets = num_sockets;
+	poll->lock = mutex_allocate(STRING_CONST("network_poll"));
+	poll->batch = pointer_offset(poll->slots, sizeof(network_poll_slot_t) * num_sockets);
 #if FOUNDATION_PLATFORM_APPLE
-	poll->pollfds = pointer_offset(poll->slots, sizeof(network_poll_slot_t) * num_sockets);
+	poll->pollfds = pointer_offset(poll->batch, sizeof(socket_t*) * num_sockets);
 #elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
-	poll->events = pointer_offset(poll->slots, sizeof(network_poll_slot_t) * num_sockets);
+	poll->events = pointer_offset(poll->batch, sizeof(socket_t*) * num_sockets);
 	poll->fd_poll = epoll_create(num_sockets);
 #endif
 	return poll;
@@ -58,10 +195,20 @@ network_poll_allocate(unsigned int num_sockets) {
 
 void
 network_poll_deallocate(network_poll_t* pollobj) {
+	size_t islot;
+	for (islot = 0; islot < pollobj->num_sockets; ++islot) {
+		socket_t* sock = pollobj->slots[islot].sock;
+		if (sock->poll == pollobj) {
+			sock->poll = 0;
+			sock->poll_batch = -1;
+		}
+	}
+
 #if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
 	close(pollobj->fd_poll);
 #endif
 
+	mutex_deallocate(pollobj->lock);
 	memory_deallocate(pollobj);
 }
 
@@ -80,7 +227,14 @@ network_poll_sockets(network_poll_t* pollobj, socket_t** sockets, size_t max_soc
 
 bool
 network_poll_add_socket(network_poll_t* pollobj, socket_t* sock) {
-	size_t num_sockets = pollobj->num_sockets;
+	size_t num_sockets;
+	bool added = false;
+
+	//Leave the deadline list of any poll the socket was registered with before
+	_network_poll_batch_disarm(sock);
+
+	mutex_lock(pollobj->lock);
+	num_sockets = pollobj->num_sockets;
 	if ((sock->base >= 0) && (num_sockets < pollobj->max_sockets)) {
 		socket_base_t* sockbase = _socket_base + sock->base;
 
@@ -90,31 +244,42 @@ network_poll_add_socket(network_poll_t* pollobj, socket_t* sock) {
 		pollobj->slots[ num_sockets ].sock = sock;
 		pollobj->slots[ num_sockets ].base = sock->base;
 		pollobj->slots[ num_sockets ].fd = sockbase->fd;
+		sock->poll = pollobj;
+		sock->poll_slot = num_sockets;
+		if (sock->batch_flush)
+			_network_poll_batch_insert(pollobj, sock);
 
 		if (sockbase->state == SOCKETSTATE_CONNECTING)
 			_socket_poll_state(sockbase);
 
+		pollobj->slots[ num_sockets ].events = _network_poll_events(sock, sockbase);
+
 #if FOUNDATION_PLATFORM_APPLE
 		pollobj->pollfds[ num_sockets ].fd = sockbase->fd;
-		pollobj->pollfds[ num_sockets ].events = ((sockbase->state == SOCKETSTATE_CONNECTING) ? POLLOUT :
-		                                          POLLIN) | POLLERR | POLLHUP;
+		pollobj->pollfds[ num_sockets ].events = (short)pollobj->slots[ num_sockets ].events;
 #elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
 		struct epoll_event event;
-		event.events = ((sockbase->state == SOCKETSTATE_CONNECTING) ? EPOLLOUT : EPOLLIN) | EPOLLERR |
-		               EPOLLHUP;
+		event.events = pollobj->slots[ num_sockets ].events;
 		event.data.fd = (int)pollobj->num_sockets;
 		epoll_ctl(pollobj->fd_poll, EPOLL_CTL_ADD, sockbase->fd, &event);
 #endif
 		++pollobj->num_sockets;
-
-		return true;
+		added = true;
 	}
-	return false;
+	mutex_unlock(pollobj->lock);
+
+	if (!added && sock->batch_flush)
+		_network_poll_batch_arm(sock);
+
+	return added;
 }
 
 void
 network_poll_remove_socket(network_poll_t* pollobj, socket_t* sock) {
-	size_t islot, num_sockets = pollobj->num_sockets;
+	size_t islot, num_sockets;
+
+	mutex_lock(pollobj->lock);
+	num_sockets = pollobj->num_sockets;
 	for (islot = 0; islot < num_sockets; ++islot) {
 		if (pollobj->slots[islot].sock == sock) {
 #if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
@@ -124,17 +289,23 @@ network_poll_remove_socket(network_poll_t* pollobj, socket_t* sock) {
 			           STRING_CONST("Network poll: Removing socket (0x%" PRIfixPTR " : %d)"),
 			           pollobj->slots[islot].sock, pollobj->slots[islot].fd);
 
+			if (sock->poll == pollobj) {
+				_network_poll_batch_erase(pollobj, sock);
+				sock->poll = 0;
+			}
+
 			//Swap with last slot and erase
 			if (islot < pollobj->num_sockets - 1) {
 				memcpy(pollobj->slots + islot, pollobj->slots + (num_sockets - 1), sizeof(network_poll_slot_t));
+				if (pollobj->slots[islot].sock->poll == pollobj)
+					pollobj->slots[islot].sock->poll_slot = islot;
 #if FOUNDATION_PLATFORM_APPLE
 				memcpy(pollobj->pollfds + islot, pollobj->pollfds + (num_sockets - 1), sizeof(struct pollfd));
 #elif FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
 				//Mod the moved socket
 				FOUNDATION_ASSERT(pollobj->slots[islot].base >= 0);
 				struct epoll_event event;
-				event.events = ((_socket_base[ pollobj->slots[islot].base ].state == SOCKETSTATE_CONNECTING) ?
-				                EPOLLOUT : EPOLLIN) | EPOLLERR | EPOLLHUP;
+				event.events = pollobj->slots[islot].events;
 				event.data.fd = (int)islot;
 				epoll_ctl(pollobj->fd_poll, EPOLL_CTL_MOD, pollobj->slots[islot].fd, &event);
 #endif
@@ -149,6 +320,7 @@ network_poll_remove_socket(network_poll_t* pollobj, socket_t* sock) {
 			num_sockets = --pollobj->num_sockets;
 		}
 	}
+	mutex_unlock(pollobj->lock);
 }
 
 bool
@@ -179,6 +351,8 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 	if (!pollobj->num_sockets)
 		return num_events;
 
+	timeoutms = _network_poll_flush_batches(pollobj, timeoutms);
+
 #if FOUNDATION_PLATFORM_APPLE
 
 	int ret = poll(pollobj->pollfds, pollobj->num_sockets, timeoutms);
@@ -199,7 +373,7 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 		socket_base_t* sockbase = _socket_base + pollobj->slots[islot].base;
 
 		FD_SET(fd, &fdread);
-		if (sockbase->state == SOCKETSTATE_CONNECTING)
+		if (_network_poll_events(pollobj->slots[islot].sock, sockbase))
 			FD_SET(fd, &fdwrite);
 		FD_SET(fd, &fderr);
 
@@ -223,6 +397,8 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 #  error Not implemented
 #endif
 
+	_network_poll_flush_batches(pollobj, 0);
+
 	if (ret < 0) {
 		int err = NETWORK_SOCKET_ERROR;
 		string_const_t errmsg = system_error_message(err);
@@ -253,9 +429,15 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 		}
 		if ((sockbase->state == SOCKETSTATE_CONNECTING) && (pfd->revents & POLLOUT)) {
 			sockbase->state = SOCKETSTATE_CONNECTED;
-			pfd->events = POLLIN | POLLERR | POLLHUP;
 			network_poll_push_event(events, capacity, num_events, NETWORKEVENT_CONNECTED, sock);
 		}
+		if ((pfd->revents & POLLOUT) && sock->queue)
+			socket_send_queue_flush(sock);
+		if (!(pfd->revents & (POLLERR | POLLHUP))) {
+			mutex_lock(pollobj->lock);
+			_network_poll_update_slot(pollobj, i);
+			mutex_unlock(pollobj->lock);
+		}
 		if (pfd->revents & POLLERR) {
 			pfd->events = POLLOUT | POLLERR | POLLHUP;
 			network_poll_push_event(events, capacity, num_events, NETWORKEVENT_ERROR, sock);
@@ -287,12 +469,37 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 		}
 		if ((sockbase->state == SOCKETSTATE_CONNECTING) && (event->events & EPOLLOUT)) {
 			sockbase->state = SOCKETSTATE_CONNECTED;
-			struct epoll_event mod_event;
-			mod_event.events = EPOLLIN | EPOLLERR | EPOLLHUP;
-			mod_event.data.fd = event->data.fd;
-			epoll_ctl(pollobj->fd_poll, EPOLL_CTL_MOD, fd, &mod_event);
 			network_poll_push_event(events, capacity, num_events, NETWORKEVENT_CONNECTED, sock);
 		}
+		if ((event->events & EPOLLOUT) && sock->queue)
+			socket_send_queue_flush(sock);
+		if (!(event->events & (EPOLLERR | EPOLLHUP))) {
+			mutex_lock(pollobj->lock);
+			_network_poll_update_slot(pollobj, (size_t)event->data.fd);
+			mutex_unlock(pollobj->lock);
+		}
+		if ((event->events & EPOLLERR) && (sockbase->flags & (SOCKETFLAG_TIMESTAMP_TRANSMIT | SOCKETFLAG_ZEROCOPY))) {
+			//Drain zero-copy completions and transmit timestamps in one pass, a pending error queue keeps
+			//the level triggered EPOLLERR raised. Only an error if the socket also has one pending
+			unsigned int found = _socket_read_error_queue(sock, 0, 0, 0);
+			if (found) {
+				int serr = 0;
+				socklen_t slen = sizeof(int);
+				getsockopt(fd, SOL_SOCKET, SO_ERROR, (void*)&serr, &slen);
+				if (found & SOCKETERRQUEUE_ZEROCOPY)
+					network_poll_push_event(events, capacity, num_events, NETWORKEVENT_ZEROCOPY, sock);
+				if (found & SOCKETERRQUEUE_TIMESTAMP)
+					network_poll_push_event(events, capacity, num_events, NETWORKEVENT_TIMESTAMP, sock);
+				if (!serr) {
+					event->events &= ~(uint32_t)EPOLLERR;
+					if (!(event->events & EPOLLHUP)) {
+						mutex_lock(pollobj->lock);
+						_network_poll_update_slot(pollobj, (size_t)event->data.fd);
+						mutex_unlock(pollobj->lock);
+					}
+				}
+			}
+		}
 		if (event->events & EPOLLERR) {
 			struct epoll_event del_event;
 			epoll_ctl(pollobj->fd_poll, EPOLL_CTL_DEL, fd, &del_event);
@@ -329,6 +536,8 @@ network_poll(network_poll_t* pollobj, network_poll_event_t* events, size_t capac
 			sockbase->state = SOCKETSTATE_CONNECTED;
 			network_poll_push_event(events, capacity, num_events, NETWORKEVENT_CONNECTED, sock);
 		}
+		if (FD_ISSET(fd, &fdwrite) && sock->queue)
+			socket_send_queue_flush(sock);
 		if (FD_ISSET(fd, &fderr)) {
 			network_poll_push_event(events, capacity, num_events, NETWORKEVENT_HANGUP, sock);
 			socket_close(sock);
@@ -11,11 +11,20 @@
 
 #include <network/socket.h>
 #include <network/address.h>
+#include <network/poll.h>
 #include <network/internal.h>
 #include <network/hashstrings.h>
 
 #include <foundation/foundation.h>
 
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+#  include <sys/sendfile.h>
+#elif FOUNDATION_PLATFORM_APPLE
+#  include <sys/uio.h>
+#elif FOUNDATION_PLATFORM_WINDOWS
+#  include <io.h>
+#endif
+
 socket_base_t*           _socket_base;
 atomic32_t               _socket_base_next;
 int32_t                  _socket_base_size;
@@ -34,12 +43,18 @@ _socket_stream_finalize(stream_t* stream);
 static size_t
 _socket_stream_available_nonblock_read(const socket_stream_t* stream);
 
+static void
+_socket_stream_resize(uint8_t** buffer, size_t* size, size_t* offset, size_t used, size_t new_size);
+
 static size_t
 _socket_stream_buffered_in(const socket_stream_t* stream);
 
 static void
 _socket_stream_doflush(socket_stream_t* stream);
 
+static socket_stream_view_t
+_socket_stream_peek_raw(socket_stream_t* stream, size_t min_bytes);
+
 static bool
 _socket_stream_eos(stream_t* stream);
 
@@ -67,6 +82,12 @@ _socket_stream_last_modified(const stream_t* stream);
 void
 _socket_initialize(socket_t* sock) {
 	sock->base = -1;
+	sock->send_buffer_size = _network_config.socket_send_buffer_size;
+	sock->receive_buffer_size = _network_config.socket_receive_buffer_size;
+	sock->stream_read_buffer_size = _network_config.stream_read_buffer_size;
+	sock->stream_write_buffer_size = _network_config.stream_write_buffer_size;
+	sock->stream_read_buffer_max = _network_config.stream_read_buffer_max;
+	sock->poll_batch = -1;
 }
 
 int
@@ -77,7 +98,7 @@ _socket_allocate_base(socket_t* sock) {
 	//TODO: Better allocation scheme
 	do {
 		int base = atomic_exchange_and_add32(&_socket_base_next, 1);
-		if (base > _socket_base_size) {
+		if (base >= _socket_base_size) {
 			atomic_store32(&_socket_base_next, 0);
 			continue;
 		}
@@ -119,10 +140,27 @@ _socket_create_fd(socket_t* sock, network_address_family_t family) {
 	if (sockbase->fd == SOCKET_INVALID) {
 		sock->open_fn(sock, family);
 		if (sockbase->fd != SOCKET_INVALID) {
+			NETWORK_TRACE(NETWORKTRACE_OPEN, sock, sockbase->fd, 0, 0);
 			sock->family = family;
-			socket_set_blocking(sock, sockbase->flags & SOCKETFLAG_BLOCKING);
-			socket_set_reuse_address(sock, sockbase->flags & SOCKETFLAG_REUSE_ADDR);
-			socket_set_reuse_port(sock, sockbase->flags & SOCKETFLAG_REUSE_PORT);
+			//New sockets are blocking with options off, only change what differs
+#if !NETWORK_HAVE_SOCKET_TYPE_FLAGS
+			if (!(sockbase->flags & SOCKETFLAG_BLOCKING))
+				_socket_set_blocking_fd(sockbase->fd, false);
+#endif
+			if (sockbase->flags & SOCKETFLAG_REUSE_ADDR)
+				socket_set_reuse_address(sock, true);
+			if (sockbase->flags & SOCKETFLAG_REUSE_PORT)
+				socket_set_reuse_port(sock, true);
+			if (sockbase->flags & SOCKETFLAG_ZEROCOPY)
+				socket_set_zerocopy(sock, true);
+			if (sockbase->flags & (SOCKETFLAG_TIMESTAMP_RECEIVE | SOCKETFLAG_TIMESTAMP_TRANSMIT))
+				socket_set_timestamping(sock, socket_timestamping(sock));
+			if (sock->send_buffer_size)
+				socket_set_send_buffer_size(sock, sock->send_buffer_size);
+			if (sock->receive_buffer_size)
+				socket_set_receive_buffer_size(sock, sock->receive_buffer_size);
+			if (sock->receive_buffer_max)
+				socket_set_receive_buffer_autotune(sock, sock->receive_buffer_max);
 		}
 	}
 
@@ -146,9 +184,17 @@ socket_deallocate(socket_t* sock) {
 
 	socket_close(sock);
 
+	if (sock->poll)
+		network_poll_remove_socket(sock->poll, sock);
+
 	if (!FOUNDATION_VALIDATE_MSG(!sock->stream, "Socket deallocated while still holding stream"))
 		stream_deallocate((stream_t*)sock->stream);
 
+	socket_set_send_queue(sock, 0, 0, nullptr);
+
+	memory_deallocate(sock->timestamp_queue);
+	sock->timestamp_queue = nullptr;
+
 	if (sock->base >= 0) {
 		socket_base_t* sockbase = _socket_base + sock->base;
 		atomic_store_ptr(&sockbase->sock, nullptr);
@@ -174,6 +220,7 @@ socket_bind(socket_t* sock, const network_address_t* address) {
 	if (bind(sockbase->fd, &address_ip->saddr, address_ip->address_size) == 0) {
 		//Store local address
 		_socket_store_address_local(sock, address_ip->family);
+		NETWORK_TRACE(NETWORKTRACE_BIND, sock, sockbase->fd, 0, 0);
 		success = true;
 #if BUILD_ENABLE_LOG
 		{
@@ -185,15 +232,17 @@ socket_bind(socket_t* sock, const network_address_t* address) {
 #endif
 	}
 	else {
+		int sockerr = NETWORK_SOCKET_ERROR;
 #if BUILD_ENABLE_LOG
 		char buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
-		int sockerr = NETWORK_SOCKET_ERROR;
 		string_const_t errmsg = system_error_message(sockerr);
 		string_t address_str = network_address_to_string(buffer, sizeof(buffer), address, true);
 		log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
 		          STRING_CONST("Unable to bind socket (0x%" PRIfixPTR " : %d) to local address %.*s: %.*s (%d)"),
 		          sock, sockbase->fd, STRING_FORMAT(address_str), STRING_FORMAT(errmsg), sockerr);
 #endif
+		NETWORK_TRACE(NETWORKTRACE_BIND, sock, sockbase->fd, sockerr, 0);
+		FOUNDATION_UNUSED(sockerr);
 	}
 
 	return success;
@@ -301,6 +350,8 @@ _socket_connect(socket_t* sock, const network_address_t* address, unsigned int t
 	if ((timeoutms > 0) && blocking)
 		socket_set_blocking(sock, true);
 
+	NETWORK_TRACE(NETWORKTRACE_CONNECT, sock, sockbase->fd, failed ? err : 0, 0);
+
 	if (failed) {
 #if BUILD_ENABLE_DEBUG_LOG
 		char buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
@@ -312,8 +363,11 @@ _socket_connect(socket_t* sock, const network_address_t* address, unsigned int t
 		return err;
 	}
 
-	memory_deallocate(sock->address_remote);
-	sock->address_remote = network_address_clone(address);
+	//The address may be the last datagram source, which is already stored as remote address
+	if (address != sock->address_remote) {
+		memory_deallocate(sock->address_remote);
+		sock->address_remote = network_address_clone(address);
+	}
 
 	if (!sock->address_local)
 		_socket_store_address_local(sock, address_ip->family);
@@ -368,8 +422,10 @@ socket_connect(socket_t* sock, const network_address_t* address, unsigned int ti
 		return false;
 	}
 
-	memory_deallocate(sock->address_remote);
-	sock->address_remote = network_address_clone(address);
+	if (address != sock->address_remote) {
+		memory_deallocate(sock->address_remote);
+		sock->address_remote = network_address_clone(address);
+	}
 
 	return true;
 }
@@ -481,6 +537,378 @@ socket_set_reuse_port(socket_t* sock, bool reuse) {
 #endif
 }
 
+static size_t
+_socket_buffer_size_fd(int fd, int option) {
+#if FOUNDATION_PLATFORM_WINDOWS
+	int size = 0;
+	int slen = sizeof(int);
+	if (getsockopt(fd, SOL_SOCKET, option, (char*)&size, &slen) < 0)
+		return 0;
+#else
+	int size = 0;
+	socklen_t slen = sizeof(int);
+	if (getsockopt(fd, SOL_SOCKET, option, (void*)&size, &slen) < 0)
+		return 0;
+#endif
+	return (size > 0) ? (size_t)size : 0;
+}
+
+static size_t
+_socket_set_buffer_size_fd(socket_t* sock, int fd, int option, size_t size) {
+	int optval = (size > INT32_MAX) ? INT32_MAX : (int)size;
+	if (setsockopt(fd, SOL_SOCKET, option, (const char*)&optval, sizeof(optval)) < 0) {
+		const int sockerr = NETWORK_SOCKET_ERROR;
+		const string_const_t errmsg = system_error_message(sockerr);
+		log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+		          STRING_CONST("Unable to set %s buffer size %" PRIsize " on socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
+		          (option == SO_SNDBUF) ? "send" : "receive", size, sock, fd, STRING_FORMAT(errmsg), sockerr);
+	}
+	return _socket_buffer_size_fd(fd, option);
+}
+
+size_t
+socket_send_buffer_size(const socket_t* sock) {
+	if ((sock->base >= 0) && (_socket_base[sock->base].fd != SOCKET_INVALID))
+		return _socket_buffer_size_fd(_socket_base[sock->base].fd, SO_SNDBUF);
+	return sock->send_buffer_size;
+}
+
+size_t
+socket_set_send_buffer_size(socket_t* sock, size_t size) {
+	sock->send_buffer_size = size;
+	if ((sock->base < 0) || (_socket_base[sock->base].fd == SOCKET_INVALID))
+		return size;
+	return _socket_set_buffer_size_fd(sock, _socket_base[sock->base].fd, SO_SNDBUF, size);
+}
+
+size_t
+socket_receive_buffer_size(const socket_t* sock) {
+	if ((sock->base >= 0) && (_socket_base[sock->base].fd != SOCKET_INVALID))
+		return _socket_buffer_size_fd(_socket_base[sock->base].fd, SO_RCVBUF);
+	return sock->receive_buffer_size;
+}
+
+size_t
+socket_set_receive_buffer_size(socket_t* sock, size_t size) {
+	sock->receive_buffer_size = size;
+	if ((sock->base < 0) || (_socket_base[sock->base].fd == SOCKET_INVALID))
+		return size;
+	return _socket_set_buffer_size_fd(sock, _socket_base[sock->base].fd, SO_RCVBUF, size);
+}
+
+void
+socket_set_receive_buffer_autotune(socket_t* sock, size_t max_size) {
+	sock->receive_buffer_max = max_size;
+	sock->receive_dropped = 0;
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	if ((sock->base >= 0) && (_socket_base[sock->base].fd != SOCKET_INVALID)) {
+		int optval = (max_size ? 1 : 0);
+		setsockopt(_socket_base[sock->base].fd, SOL_SOCKET, SO_RXQ_OVFL, &optval, sizeof(optval));
+	}
+#endif
+}
+
+size_t
+socket_receive_dropped(const socket_t* sock) {
+	return sock->receive_dropped;
+}
+
+void
+_socket_autotune_receive_buffer(socket_t* sock, bool dropping) {
+	size_t previous, current, size;
+	int fd;
+
+	if (!dropping || !sock->receive_buffer_max || (sock->base < 0))
+		return;
+	fd = _socket_base[sock->base].fd;
+	if (fd == SOCKET_INVALID)
+		return;
+
+	previous = current = _socket_buffer_size_fd(fd, SO_RCVBUF);
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	//Kernel reports twice the requested size to account for bookkeeping overhead
+	current /= 2;
+#endif
+	if (current >= sock->receive_buffer_max)
+		return;
+
+	size = current * 2;
+	if (size > sock->receive_buffer_max)
+		size = sock->receive_buffer_max;
+	sock->receive_buffer_size = size;
+	size = _socket_set_buffer_size_fd(sock, fd, SO_RCVBUF, size);
+
+	if (size <= previous) {
+		log_warnf(HASH_NETWORK, WARNING_RESOURCE,
+		          STRING_CONST("Receive buffer on socket (0x%" PRIfixPTR " : %d) limited by system to %" PRIsize " bytes, autotuning stopped"),
+		          sock, fd, size);
+		sock->receive_buffer_max = 0;
+		return;
+	}
+
+	log_infof(HASH_NETWORK,
+	          STRING_CONST("Grew receive buffer on socket (0x%" PRIfixPTR " : %d) to %" PRIsize " bytes (%u drops)"),
+	          sock, fd, size, sock->receive_dropped);
+}
+
+void
+socket_set_stream_buffer_size(socket_t* sock, size_t read_size, size_t write_size) {
+	socket_stream_t* stream = sock->stream;
+	sock->stream_read_buffer_size = read_size ? read_size : _network_config.stream_read_buffer_size;
+	sock->stream_write_buffer_size = write_size ? write_size : _network_config.stream_write_buffer_size;
+	if (!stream)
+		return;
+	_socket_stream_resize(&stream->buffer_in, &stream->size_in, &stream->offset_in, stream->used_in,
+	                      sock->stream_read_buffer_size);
+	_socket_stream_resize(&stream->buffer_out, &stream->size_out, &stream->offset_out, stream->used_out,
+	                      sock->stream_write_buffer_size);
+}
+
+void
+socket_set_stream_buffer_autotune(socket_t* sock, size_t max_size) {
+	sock->stream_read_buffer_max = max_size;
+}
+
+size_t
+socket_stream_read_buffer_size(const socket_t* sock) {
+	return sock->stream ? sock->stream->size_in : sock->stream_read_buffer_size;
+}
+
+size_t
+socket_stream_write_buffer_size(const socket_t* sock) {
+	return sock->stream ? sock->stream->size_out : sock->stream_write_buffer_size;
+}
+
+unsigned int
+socket_timestamping(const socket_t* sock) {
+	unsigned int flags = 0;
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		if (sockbase->flags & SOCKETFLAG_TIMESTAMP_RECEIVE)
+			flags |= SOCKETTIMESTAMP_RECEIVE;
+		if (sockbase->flags & SOCKETFLAG_TIMESTAMP_TRANSMIT)
+			flags |= SOCKETTIMESTAMP_TRANSMIT;
+	}
+	return flags;
+}
+
+unsigned int
+socket_set_timestamping(socket_t* sock, unsigned int flags) {
+	socket_base_t* sockbase;
+
+	if (_socket_allocate_base(sock) < 0)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	sockbase->flags &= ~(SOCKETFLAG_TIMESTAMP_RECEIVE | SOCKETFLAG_TIMESTAMP_TRANSMIT);
+#if FOUNDATION_PLATFORM_WINDOWS
+	flags = 0;
+#elif !NETWORK_HAVE_ERRQUEUE
+	flags &= SOCKETTIMESTAMP_RECEIVE;
+#endif
+
+	if (sockbase->fd != SOCKET_INVALID) {
+		unsigned int requested = flags;
+#if FOUNDATION_PLATFORM_POSIX
+		int optval = (flags & SOCKETTIMESTAMP_RECEIVE) ? 1 : 0;
+#  if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+		const int rxopt = SO_TIMESTAMPNS;
+#  else
+		const int rxopt = SO_TIMESTAMP;
+#  endif
+		if (setsockopt(sockbase->fd, SOL_SOCKET, rxopt, &optval, sizeof(optval)) < 0)
+			flags &= ~(unsigned int)SOCKETTIMESTAMP_RECEIVE;
+#endif
+#if NETWORK_HAVE_ERRQUEUE
+		optval = (flags & SOCKETTIMESTAMP_TRANSMIT) ?
+		         (SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+		          SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY) : 0;
+		if (setsockopt(sockbase->fd, SOL_SOCKET, SO_TIMESTAMPING, &optval, sizeof(optval)) < 0)
+			flags &= ~(unsigned int)SOCKETTIMESTAMP_TRANSMIT;
+#endif
+		if (flags != requested) {
+			const int sockerr = NETWORK_SOCKET_ERROR;
+			const string_const_t errmsg = system_error_message(sockerr);
+			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+			          STRING_CONST("Unable to set timestamping on socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
+			          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr);
+		}
+	}
+
+	if (flags & SOCKETTIMESTAMP_RECEIVE)
+		sockbase->flags |= SOCKETFLAG_TIMESTAMP_RECEIVE;
+	if (flags & SOCKETTIMESTAMP_TRANSMIT) {
+		sockbase->flags |= SOCKETFLAG_TIMESTAMP_TRANSMIT;
+		if (!sock->timestamp_queue)
+			sock->timestamp_queue = memory_allocate(HASH_NETWORK, sizeof(socket_timestamp_t) *
+			                                        SOCKET_TIMESTAMP_QUEUE_SIZE, 0, MEMORY_PERSISTENT);
+	}
+
+	return flags;
+}
+
+size_t
+socket_transmit_timestamps(socket_t* sock, socket_timestamp_t* timestamps, size_t capacity) {
+	size_t count = 0;
+	int32_t head, tail;
+
+	if (sock->timestamp_queue) {
+		head = atomic_load32(&sock->timestamp_head);
+		tail = atomic_load32(&sock->timestamp_tail);
+		atomic_thread_fence_acquire();
+		for (; (head != tail) && (count < capacity); ++head, ++count)
+			timestamps[count] = sock->timestamp_queue[head & (SOCKET_TIMESTAMP_QUEUE_SIZE - 1)];
+		atomic_store32(&sock->timestamp_head, head);
+	}
+
+	//A poll object drains the error queue for registered sockets
+	if (!sock->poll && (count < capacity))
+		_socket_read_error_queue(sock, timestamps, capacity, &count);
+	return count;
+}
+
+bool
+socket_capture(const socket_t* sock) {
+	bool capture = false;
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		capture = ((sockbase->flags & SOCKETFLAG_CAPTURE) != 0);
+	}
+	return capture;
+}
+
+void
+socket_set_capture(socket_t* sock, bool capture) {
+	socket_base_t* sockbase;
+
+	if (_socket_allocate_base(sock) < 0)
+		return;
+
+	sockbase = _socket_base + sock->base;
+	sockbase->flags = (capture ? sockbase->flags | SOCKETFLAG_CAPTURE : sockbase->flags &
+	                   ~SOCKETFLAG_CAPTURE);
+}
+
+int
+socket_incoming_cpu(const socket_t* sock) {
+	int cpu = -1;
+#if NETWORK_HAVE_REUSEPORT_CBPF
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		socklen_t optlen = sizeof(cpu);
+		if ((sockbase->fd == SOCKET_INVALID) ||
+		        (getsockopt(sockbase->fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0))
+			cpu = -1;
+	}
+#else
+	FOUNDATION_UNUSED(sock);
+#endif
+	return cpu;
+}
+
+bool
+_socket_bind_group(socket_t** sockets, size_t count, const network_address_t* address) {
+	network_address_t* bind_address = network_address_clone(address);
+	bool success = true;
+	size_t isock;
+
+	for (isock = 0; success && (isock < count); ++isock) {
+		socket_set_reuse_port(sockets[isock], true);
+		success = socket_bind(sockets[isock], bind_address);
+		if (success && !isock) {
+			//Remaining sockets join the port assigned to the first one if ephemeral
+			const network_address_t* local = socket_address_local(sockets[isock]);
+			if (local && ((local->family == NETWORK_ADDRESSFAMILY_IPV4) ||
+			              (local->family == NETWORK_ADDRESSFAMILY_IPV6)))
+				network_address_ip_set_port(bind_address, network_address_ip_port(local));
+		}
+	}
+
+	//A partial group would keep the shared port and take a share of its traffic
+	if (!success) {
+		while (isock--)
+			socket_close(sockets[isock]);
+	}
+
+	memory_deallocate(bind_address);
+	return success;
+}
+
+bool
+_socket_attach_reuseport_cpu(socket_t* sock, size_t count) {
+#if NETWORK_HAVE_REUSEPORT_CBPF
+	//Select group member by receiving CPU modulo group size
+	struct sock_filter code[] = {
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)count },
+		{ BPF_RET | BPF_A, 0, 0, 0 }
+	};
+	struct sock_fprog prog;
+	socket_base_t* sockbase;
+
+	if ((sock->base < 0) || (count < 2))
+		return false;
+
+	sockbase = _socket_base + sock->base;
+	prog.len = (unsigned short)(sizeof(code) / sizeof(code[0]));
+	prog.filter = code;
+	if (setsockopt(sockbase->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+		const int sockerr = NETWORK_SOCKET_ERROR;
+		const string_const_t errmsg = system_error_message(sockerr);
+		log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+		          STRING_CONST("Unable to attach reuse port CPU steering on socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
+		          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr);
+		return false;
+	}
+	return true;
+#else
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(count);
+	return false;
+#endif
+}
+
+bool
+socket_zerocopy(const socket_t* sock) {
+	bool zerocopy = false;
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		zerocopy = ((sockbase->flags & SOCKETFLAG_ZEROCOPY) != 0);
+	}
+	return zerocopy;
+}
+
+bool
+socket_set_zerocopy(socket_t* sock, bool enable) {
+	socket_base_t* sockbase;
+
+	if (_socket_allocate_base(sock) < 0)
+		return false;
+
+	sockbase = _socket_base + sock->base;
+#if NETWORK_HAVE_ZEROCOPY
+	if (sockbase->fd != SOCKET_INVALID) {
+		int optval = enable ? 1 : 0;
+		int ret = setsockopt(sockbase->fd, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval));
+		if (ret < 0) {
+			const int sockerr = NETWORK_SOCKET_ERROR;
+			const string_const_t errmsg = system_error_message(sockerr);
+			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+			          STRING_CONST("Unable to set zero-copy option on socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
+			          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr);
+			sockbase->flags &= ~SOCKETFLAG_ZEROCOPY;
+			return !enable;
+		}
+	}
+	sockbase->flags = (enable ? sockbase->flags | SOCKETFLAG_ZEROCOPY : sockbase->flags &
+	                   ~SOCKETFLAG_ZEROCOPY);
+	return true;
+#else
+	sockbase->flags &= ~SOCKETFLAG_ZEROCOPY;
+	return !enable;
+#endif
+}
+
 bool
 socket_set_multicast_group(socket_t* sock, network_address_t* address, bool allow_loopback) {
 	socket_base_t* sockbase;
@@ -542,50 +970,8 @@ socket_available_read(const socket_t* sock) {
 	return 0;
 }
 
-size_t
-socket_read(socket_t* sock, void* buffer, size_t size) {
-	socket_base_t* sockbase;
-	size_t read;
-	long ret;
-
-	if (sock->base < 0)
-		return 0;
-
-	sockbase = _socket_base + sock->base;
-	ret = recv(sockbase->fd, (char*)buffer, (int)size, 0);
-	if (ret > 0) {
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		const unsigned char* src = (const unsigned char*)buffer;
-		char dump_buffer[66];
-#endif
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
-		log_debugf(HASH_NETWORK,
-		           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) read %d of %" PRIsize " bytes"),
-		           sock, sockbase->fd, ret, size);
-#endif
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		for (long row = 0; row <= (ret / 8); ++row) {
-			long ofs = 0, col = 0, cols = 8;
-			if ((row + 1) * 8 > ret)
-				cols = ret - (row * 8);
-			for (; col < cols; ++col, ofs += 3) {
-				string_format(dump_buffer + ofs, 66 - (unsigned int)ofs, STRING_CONST("%02x"),
-				              *(src + (row * 8) + col));
-				*(dump_buffer + ofs + 2) = ' ';
-			}
-			if (ofs) {
-				*(dump_buffer + ofs - 1) = 0;
-				log_debug(HASH_NETWORK, dump_buffer, ofs - 1);
-			}
-		}
-#endif
-
-		read = (size_t)ret;
-		sock->bytes_read += read;
-
-		return read;
-	}
-
+static void
+_socket_read_failed(socket_t* sock, socket_base_t* sockbase, long ret) {
 	if (ret == 0) {
 #if BUILD_ENABLE_DEBUG_LOG
 		char buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
@@ -609,6 +995,7 @@ socket_read(socket_t* sock, void* buffer, size_t size) {
 			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
 			          STRING_CONST("Socket recv() failed on socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
 			          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr);
+			NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, sockerr, 0);
 		}
 
 #if FOUNDATION_PLATFORM_WINDOWS
@@ -623,103 +1010,958 @@ socket_read(socket_t* sock, void* buffer, size_t size) {
 
 		_socket_poll_state(sockbase);
 	}
-
-	return 0;
 }
 
 size_t
-socket_write(socket_t* sock, const void* buffer, size_t size) {
+socket_read(socket_t* sock, void* buffer, size_t size) {
 	socket_base_t* sockbase;
-	size_t total_write = 0;
+	size_t read;
+	long ret;
 
 	if (sock->base < 0)
 		return 0;
 
 	sockbase = _socket_base + sock->base;
-	while (total_write < size) {
-		const char* current = (const char*)pointer_offset_const(buffer, total_write);
-		int remain = (int)(size - total_write);
-
-		long res = send(sockbase->fd, current, remain, 0);
-		if (res > 0) {
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-			const unsigned char* src = (const unsigned char*)current;
-			char buffer[34];
-#endif
+	ret = recv(sockbase->fd, (char*)buffer, (int)size, 0);
+	if (ret > 0) {
 #if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
-			log_debugf(HASH_NETWORK,
-			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) wrote %d of %d bytes (offset %" PRIsize ")"),
-			           sock, sockbase->fd, res, remain, total_write);
-#endif
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-			for (long row = 0; row <= (res / 8); ++row) {
-				long ofs = 0, col = 0, cols = 8;
-				if ((row + 1) * 8 > res)
-					cols = res - (row * 8);
-				for (; col < cols; ++col, ofs += 3) {
-					string_format(buffer + ofs, 34 - (unsigned int)ofs, STRING_CONST("%02x"), *(src + (row * 8) + col));
-					*(buffer + ofs + 2) = ' ';
-				}
-				if (ofs) {
-					*(buffer + ofs - 1) = 0;
-					log_debug(HASH_NETWORK, buffer, ofs - 1);
-				}
-			}
+		log_debugf(HASH_NETWORK,
+		           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) read %d of %" PRIsize " bytes"),
+		           sock, sockbase->fd, ret, size);
 #endif
-			total_write += res;
-		}
-		else if (res <= 0) {
-			int sockerr = NETWORK_SOCKET_ERROR;
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture_buffer(sock, false, sock->bytes_read, buffer, (size_t)ret, sock->address_remote);
 
-#if FOUNDATION_PLATFORM_WINDOWS
-			int serr = 0;
-			int slen = sizeof(int);
-			getsockopt(sockbase->fd, SOL_SOCKET, SO_ERROR, (char*)&serr, &slen);
-#else
-			int serr = 0;
-			socklen_t slen = sizeof(int);
-			getsockopt(sockbase->fd, SOL_SOCKET, SO_ERROR, (void*)&serr, &slen);
-#endif
+		read = (size_t)ret;
+		sock->bytes_read += read;
+		NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, 0, read);
 
-#if FOUNDATION_PLATFORM_WINDOWS
-			if (sockerr == WSAEWOULDBLOCK)
-#else
-			if (sockerr == EAGAIN)
-#endif
-			{
-				log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
-				          STRING_CONST("Partial socket send() on (0x%" PRIfixPTR
-				                       " : %d): %" PRIsize" of %" PRIsize " bytes written to socket (SO_ERROR %d)"),
-				          sock, sockbase->fd, total_write, size, serr);
-			}
-			else {
-				log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
-				          STRING_CONST("Socket send() failed on socket (0x%" PRIfixPTR " : %d): %s (%d) (SO_ERROR %d)"),
-				          sock, sockbase->fd, system_error_message(sockerr), sockerr, serr);
-			}
+		return read;
+	}
+
+	_socket_read_failed(sock, sockbase, ret);
+
+	return 0;
+}
+
+size_t
+socket_readv(socket_t* sock, const socket_iovec_t* iov, size_t count) {
+	socket_base_t* sockbase;
+	size_t read;
+	long ret;
+
+	if ((sock->base < 0) || !count)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	if (count > SOCKET_IOVEC_MAX)
+		count = SOCKET_IOVEC_MAX;
+
+#if FOUNDATION_PLATFORM_WINDOWS
+	{
+		DWORD received = 0;
+		DWORD flags = 0;
+		ret = (WSARecv(sockbase->fd, (LPWSABUF)iov, (DWORD)count, &received, &flags, 0, 0) == 0) ?
+		      (long)received : -1;
+	}
+#else
+	{
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = (struct iovec*)iov;
+		msg.msg_iovlen = count;
+		ret = (long)recvmsg(sockbase->fd, &msg, 0);
+	}
+#endif
+	if (ret > 0) {
+#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
+		log_debugf(HASH_NETWORK,
+		           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) read %d bytes into %" PRIsize " buffers"),
+		           sock, sockbase->fd, ret, count);
+#endif
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture(sock, false, sock->bytes_read, iov, count, (size_t)ret, sock->address_remote);
+		read = (size_t)ret;
+		sock->bytes_read += read;
+		NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, 0, read);
+
+		return read;
+	}
+
+	_socket_read_failed(sock, sockbase, ret);
+
+	return 0;
+}
+
+static void
+_socket_write_failed(socket_t* sock, socket_base_t* sockbase, size_t written, size_t size,
+                     bool queued) {
+	int sockerr = NETWORK_SOCKET_ERROR;
+
+#if FOUNDATION_PLATFORM_WINDOWS
+	int serr = 0;
+	int slen = sizeof(int);
+	getsockopt(sockbase->fd, SOL_SOCKET, SO_ERROR, (char*)&serr, &slen);
+#else
+	int serr = 0;
+	socklen_t slen = sizeof(int);
+	getsockopt(sockbase->fd, SOL_SOCKET, SO_ERROR, (void*)&serr, &slen);
+#endif
+
+#if FOUNDATION_PLATFORM_WINDOWS
+	if (sockerr == WSAEWOULDBLOCK)
+#else
+	if (sockerr == EAGAIN)
+#endif
+	{
+		if (!queued)
+			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+			          STRING_CONST("Partial socket send() on (0x%" PRIfixPTR
+			                       " : %d): %" PRIsize" of %" PRIsize " bytes written to socket (SO_ERROR %d)"),
+			          sock, sockbase->fd, written, size, serr);
+	}
+	else {
+		string_const_t errmsg = system_error_message(sockerr);
+		log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+		          STRING_CONST("Socket send() failed on socket (0x%" PRIfixPTR " : %d): %.*s (%d) (SO_ERROR %d)"),
+		          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr, serr);
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, sockerr, written);
+	}
+
+#if FOUNDATION_PLATFORM_WINDOWS
+	if ((sockerr == WSAENETDOWN) || (sockerr == WSAENETRESET) || (sockerr == WSAENOTCONN) ||
+	        (sockerr == WSAECONNABORTED) || (sockerr == WSAECONNRESET) || (sockerr == WSAETIMEDOUT))
+#else
+	if ((sockerr == ECONNRESET) || (sockerr == EPIPE) || (sockerr == ETIMEDOUT))
+#endif
+	{
+		socket_close(sock);
+	}
+
+	if (sockbase->state != SOCKETSTATE_NOTCONNECTED)
+		_socket_poll_state(sockbase);
+}
+
+static size_t
+_socket_write_fd(socket_t* sock, socket_base_t* sockbase, const void* buffer, size_t size,
+                 bool queued) {
+	size_t total_write = 0;
+
+	while (total_write < size) {
+		const char* current = (const char*)pointer_offset_const(buffer, total_write);
+		int remain = (int)(size - total_write);
+
+		long res = send(sockbase->fd, current, remain, 0);
+		if (res > 0) {
+#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
+			log_debugf(HASH_NETWORK,
+			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) wrote %d of %d bytes (offset %" PRIsize ")"),
+			           sock, sockbase->fd, res, remain, total_write);
+#endif
+			if (SOCKET_CAPTURE(sockbase))
+				_network_capture_buffer(sock, true, sock->bytes_written + total_write, current, (size_t)res,
+				                        sock->address_remote);
+			total_write += res;
+		}
+		else {
+			_socket_write_failed(sock, sockbase, total_write, size, queued);
+			break;
+		}
+	}
+
+	sock->bytes_written += total_write;
+	if (total_write)
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, total_write);
+
+	return total_write;
+}
+
+static size_t
+_socket_write_zerocopy_fd(socket_t* sock, socket_base_t* sockbase, const void* buffer, size_t size,
+                          bool queued) {
+#if NETWORK_HAVE_ZEROCOPY
+	size_t total_write = 0;
+
+	while (total_write < size) {
+		const void* current = pointer_offset_const(buffer, total_write);
+		size_t remain = size - total_write;
+
+		long res = (long)send(sockbase->fd, current, remain, MSG_ZEROCOPY);
+		if (res > 0) {
+#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
+			log_debugf(HASH_NETWORK,
+			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) wrote %d of %" PRIsize " bytes zero-copy (offset %" PRIsize ")"),
+			           sock, sockbase->fd, res, remain, total_write);
+#endif
+			if (SOCKET_CAPTURE(sockbase))
+				_network_capture_buffer(sock, true, sock->bytes_written + total_write, current, (size_t)res,
+				                        sock->address_remote);
+			++sock->zerocopy_sent;
+			total_write += (size_t)res;
+		}
+		else if (errno == ENOBUFS) {
+			//Out of socket option memory for pinned pages, copy the remainder
+			sock->bytes_written += total_write;
+			return total_write + _socket_write_fd(sock, sockbase, current, remain, queued);
+		}
+		else {
+			_socket_write_failed(sock, sockbase, total_write, size, queued);
+			break;
+		}
+	}
+
+	sock->bytes_written += total_write;
+	if (total_write)
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, total_write);
+
+	return total_write;
+#else
+	return _socket_write_fd(sock, sockbase, buffer, size, queued);
+#endif
+}
+
+static size_t
+_socket_writev_fd(socket_t* sock, socket_base_t* sockbase, const socket_iovec_t* iov, size_t count,
+                  bool queued) {
+	socket_iovec_t vec[SOCKET_IOVEC_MAX];
+	size_t total_write = 0;
+	size_t size = 0;
+	size_t ivec = 0;
+	size_t offset = 0;
+	size_t iiov;
+
+	for (iiov = 0; iiov < count; ++iiov)
+		size += iov[iiov].length;
+
+	while (total_write < size) {
+		size_t num = 0;
+		long res;
+
+		while (!(iov[ivec].length - offset)) {
+			++ivec;
+			offset = 0;
+		}
+
+		for (iiov = ivec; (iiov < count) && (num < SOCKET_IOVEC_MAX); ++iiov, ++num) {
+			vec[num].buffer = pointer_offset(iov[iiov].buffer, (iiov == ivec) ? (ssize_t)offset : 0);
+			vec[num].length = iov[iiov].length - ((iiov == ivec) ? offset : 0);
+		}
+
+#if FOUNDATION_PLATFORM_WINDOWS
+		{
+			DWORD sent = 0;
+			res = (WSASend(sockbase->fd, (LPWSABUF)vec, (DWORD)num, &sent, 0, 0, 0) == 0) ? (long)sent : -1;
+		}
+#else
+		{
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = (struct iovec*)vec;
+			msg.msg_iovlen = num;
+			res = (long)sendmsg(sockbase->fd, &msg, 0);
+		}
+#endif
+		if (res > 0) {
+			size_t advance = (size_t)res;
+#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
+			log_debugf(HASH_NETWORK,
+			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d) wrote %d bytes from %" PRIsize
+			                        " buffers (offset %" PRIsize ")"),
+			           sock, sockbase->fd, res, num, total_write);
+#endif
+			if (SOCKET_CAPTURE(sockbase))
+				_network_capture(sock, true, sock->bytes_written + total_write, vec, num, advance,
+				                 sock->address_remote);
+			total_write += advance;
+			while (advance) {
+				size_t remain = iov[ivec].length - offset;
+				if (advance < remain) {
+					offset += advance;
+					break;
+				}
+				advance -= remain;
+				++ivec;
+				offset = 0;
+			}
+		}
+		else {
+			_socket_write_failed(sock, sockbase, total_write, size, queued);
+			break;
+		}
+	}
+
+	sock->bytes_written += total_write;
+	if (total_write)
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, total_write);
+
+	return total_write;
+}
+
+static size_t
+_socket_send_file_copy(socket_t* sock, socket_base_t* sockbase, int fd, size_t offset,
+                       size_t length, bool queued) {
+	char buffer[SOCKET_SENDFILE_BUFFER_SIZE];
+	size_t total_write = 0;
+
+	while (total_write < length) {
+		size_t chunk = length - total_write;
+		size_t written;
+		long res;
+
+		if (chunk > sizeof(buffer))
+			chunk = sizeof(buffer);
+#if FOUNDATION_PLATFORM_WINDOWS
+		if (_lseeki64(fd, (__int64)(offset + total_write), SEEK_SET) < 0)
+			res = -1;
+		else
+			res = _read(fd, buffer, (unsigned int)chunk);
+#else
+		res = (long)pread(fd, buffer, chunk, (off_t)(offset + total_write));
+#endif
+		if (res <= 0) {
+			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+			          STRING_CONST("Unable to read file %d at offset %" PRIsize " for socket (0x%" PRIfixPTR
+			                       " : %d): %" PRIsize " of %" PRIsize " bytes sent"),
+			          fd, offset + total_write, sock, sockbase->fd, total_write, length);
+			break;
+		}
+
+		written = _socket_write_fd(sock, sockbase, buffer, (size_t)res, queued);
+		total_write += written;
+		if (written < (size_t)res)
+			break;
+	}
+
+	return total_write;
+}
+
+static size_t
+_socket_send_file_fd(socket_t* sock, socket_base_t* sockbase, int fd, size_t offset,
+                     size_t length, bool queued) {
+	size_t total_write = 0;
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	while (total_write < length) {
+		off_t position = (off_t)(offset + total_write);
+		ssize_t res = sendfile(sockbase->fd, fd, &position, length - total_write);
+		if (res > 0) {
+			if (SOCKET_CAPTURE(sockbase))
+				_network_capture(sock, true, sock->bytes_written + total_write, 0, 0, (size_t)res,
+				                 sock->address_remote);
+			total_write += (size_t)res;
+			continue;
+		}
+		if (res == 0) {
+			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+			          STRING_CONST("Unexpected end of file %d at offset %" PRIsize " for socket (0x%" PRIfixPTR
+			                       " : %d): %" PRIsize " of %" PRIsize " bytes sent"),
+			          fd, offset + total_write, sock, sockbase->fd, total_write, length);
+			break;
+		}
+		if ((errno == EINVAL) || (errno == ENOSYS) || (errno == EOVERFLOW)) {
+			//File type not supported by sendfile, copy through user space
+			sock->bytes_written += total_write;
+			return total_write + _socket_send_file_copy(sock, sockbase, fd, offset + total_write,
+			                                            length - total_write, queued);
+		}
+		_socket_write_failed(sock, sockbase, total_write, length, queued);
+		break;
+	}
+#elif FOUNDATION_PLATFORM_APPLE
+	while (total_write < length) {
+		off_t sent = (off_t)(length - total_write);
+		int res = sendfile(fd, sockbase->fd, (off_t)(offset + total_write), &sent, 0, 0);
+		if (sent && SOCKET_CAPTURE(sockbase))
+			_network_capture(sock, true, sock->bytes_written + total_write, 0, 0, (size_t)sent,
+			                 sock->address_remote);
+		total_write += (size_t)sent;
+		if (res == 0) {
+			if (!sent) {
+				log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+				          STRING_CONST("Unexpected end of file %d at offset %" PRIsize " for socket (0x%" PRIfixPTR
+				                       " : %d): %" PRIsize " of %" PRIsize " bytes sent"),
+				          fd, offset + total_write, sock, sockbase->fd, total_write, length);
+				break;
+			}
+			continue;
+		}
+		if (sent && ((errno == EAGAIN) || (errno == EINTR)))
+			continue;
+		if ((errno == ENOTSUP) || (errno == ENOTSOCK) || (errno == EINVAL)) {
+			//File type not supported by sendfile, copy through user space
+			sock->bytes_written += total_write;
+			return total_write + _socket_send_file_copy(sock, sockbase, fd, offset + total_write,
+			                                            length - total_write, queued);
+		}
+		_socket_write_failed(sock, sockbase, total_write, length, queued);
+		break;
+	}
+#else
+	return _socket_send_file_copy(sock, sockbase, fd, offset, length, queued);
+#endif
+
+	sock->bytes_written += total_write;
+	if (total_write)
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, total_write);
+
+	return total_write;
+}
+
+static bool
+_socket_queue_push_file(socket_queue_t* queue, int fd, size_t offset, size_t length) {
+	socket_buffer_t* block;
+	//The queue owns a duplicate so the caller may close the file as soon as the call returns
+#if FOUNDATION_PLATFORM_WINDOWS
+	int owned = _dup(fd);
+#else
+	int owned = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+#endif
+	if (owned < 0)
+		return false;
+
+	block = memory_allocate(HASH_NETWORK, sizeof(socket_buffer_t), 0, MEMORY_PERSISTENT);
+	block->next = nullptr;
+	block->fd = owned;
+	block->offset = offset;
+	block->size = offset + length;
+	block->capacity = 0;
+	if (queue->tail)
+		queue->tail->next = block;
+	else
+		queue->head = block;
+	queue->tail = block;
+	queue->queued += length;
+	return true;
+}
+
+static void
+_socket_queue_release(socket_buffer_t* block) {
+	if (block->fd >= 0) {
+#if FOUNDATION_PLATFORM_WINDOWS
+		_close(block->fd);
+#else
+		close(block->fd);
+#endif
+	}
+	memory_deallocate(block);
+}
+
+static void
+_socket_queue_push(socket_queue_t* queue, const void* buffer, size_t size) {
+	socket_buffer_t* tail = queue->tail;
+	size_t copy;
+
+	queue->queued += size;
+
+	if (tail && (tail->size < tail->capacity)) {
+		copy = tail->capacity - tail->size;
+		if (copy > size)
+			copy = size;
+		memcpy(tail->data + tail->size, buffer, copy);
+		tail->size += copy;
+		buffer = pointer_offset_const(buffer, copy);
+		size -= copy;
+	}
+
+	if (size) {
+		size_t capacity = (size > SOCKET_QUEUE_BLOCK_SIZE) ? size : SOCKET_QUEUE_BLOCK_SIZE;
+		socket_buffer_t* block = memory_allocate(HASH_NETWORK, sizeof(socket_buffer_t) + capacity, 0,
+		                                         MEMORY_PERSISTENT);
+		block->next = nullptr;
+		block->fd = -1;
+		block->offset = 0;
+		block->size = size;
+		block->capacity = capacity;
+		memcpy(block->data, buffer, size);
+		if (tail)
+			tail->next = block;
+		else
+			queue->head = block;
+		queue->tail = block;
+	}
+}
+
+static void
+_socket_queue_clear(socket_queue_t* queue) {
+	socket_buffer_t* block = queue->head;
+	while (block) {
+		socket_buffer_t* next = block->next;
+		_socket_queue_release(block);
+		block = next;
+	}
+	queue->head = nullptr;
+	queue->tail = nullptr;
+	queue->queued = 0;
+	queue->above_high_watermark = false;
+}
+
+static size_t
+_socket_queue_write(socket_t* sock, socket_base_t* sockbase, const void* buffer, size_t size,
+                    bool zerocopy) {
+	socket_queue_t* queue = sock->queue;
+	size_t written = 0;
+	size_t queued;
+	bool notify = false;
+	bool armed = false;
+
+	mutex_lock(queue->lock);
+
+	if (!queue->head && (sockbase->state == SOCKETSTATE_CONNECTED))
+		written = zerocopy ? _socket_write_zerocopy_fd(sock, sockbase, buffer, size, true) :
+		          _socket_write_fd(sock, sockbase, buffer, size, true);
+
+	if ((written < size) && (sockbase->fd != SOCKET_INVALID)) {
+		armed = !queue->head;
+		_socket_queue_push(queue, pointer_offset_const(buffer, written), size - written);
+		written = size;
+		if (!queue->above_high_watermark && (queue->queued >= queue->high_watermark)) {
+			queue->above_high_watermark = true;
+			notify = true;
+		}
+	}
+	queued = queue->queued;
+
+	mutex_unlock(queue->lock);
+
+	//Watch for writable only while data is queued
+	if (armed)
+		_network_poll_update_socket(sock);
+	if (notify && queue->callback)
+		queue->callback(sock, SOCKETQUEUE_HIGH_WATERMARK, queued);
+
+	return written;
+}
+
+void
+_socket_batch_arm(socket_t* sock) {
+	socket_base_t* sockbase = _socket_base + sock->base;
+	if ((sockbase->flags & SOCKETFLAG_BATCH) && sock->batch_timeout && !sock->batch_flush) {
+		sock->batch_flush = time_current() + ((time_ticks_per_second() * sock->batch_timeout) / 1000);
+		_network_poll_batch_arm(sock);
+	}
+}
+
+size_t
+socket_write(socket_t* sock, const void* buffer, size_t size) {
+	socket_base_t* sockbase;
+
+	if (sock->base < 0)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	_socket_batch_arm(sock);
+	if (sock->queue)
+		return _socket_queue_write(sock, sockbase, buffer, size, false);
+
+	return _socket_write_fd(sock, sockbase, buffer, size, false);
+}
+
+size_t
+socket_write_zerocopy(socket_t* sock, const void* buffer, size_t size, uint32_t* sequence) {
+	socket_base_t* sockbase;
+	size_t written;
+
+	if (sequence)
+		*sequence = (uint32_t)atomic_load32(&sock->zerocopy_completed);
+
+	if (sock->base < 0)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	if (!(sockbase->flags & SOCKETFLAG_ZEROCOPY) || (size < SOCKET_ZEROCOPY_THRESHOLD))
+		return socket_write(sock, buffer, size);
+
+	_socket_batch_arm(sock);
+	if (sock->queue)
+		written = _socket_queue_write(sock, sockbase, buffer, size, true);
+	else
+		written = _socket_write_zerocopy_fd(sock, sockbase, buffer, size, false);
+
+	//Any zero-copy send issued for this buffer pins it until the last one completes
+	if (sequence && (sock->zerocopy_sent != (uint32_t)atomic_load32(&sock->zerocopy_completed)))
+		*sequence = sock->zerocopy_sent;
+
+	return written;
+}
+
+#if NETWORK_HAVE_ERRQUEUE
+
+static void
+_socket_timestamp_push(socket_t* sock, uint32_t id, uint64_t time) {
+	int32_t tail = atomic_load32(&sock->timestamp_tail);
+	socket_timestamp_t* timestamp;
+
+	//Drop the timestamp when the application is not keeping up, the error queue must still be drained
+	if (!sock->timestamp_queue || ((tail - atomic_load32(&sock->timestamp_head)) >= SOCKET_TIMESTAMP_QUEUE_SIZE))
+		return;
+
+	timestamp = sock->timestamp_queue + (tail & (SOCKET_TIMESTAMP_QUEUE_SIZE - 1));
+	timestamp->id = id;
+	timestamp->time = time;
+	atomic_thread_fence_release();
+	atomic_store32(&sock->timestamp_tail, tail + 1);
+}
 
-#if FOUNDATION_PLATFORM_WINDOWS
-			if ((sockerr == WSAENETDOWN) || (sockerr == WSAENETRESET) || (sockerr == WSAENOTCONN) ||
-			        (sockerr == WSAECONNABORTED) || (sockerr == WSAECONNRESET) || (sockerr == WSAETIMEDOUT))
+#endif
+
+unsigned int
+_socket_read_error_queue(socket_t* sock, socket_timestamp_t* timestamps, size_t capacity, size_t* count) {
+	unsigned int found = 0;
+#if NETWORK_HAVE_ERRQUEUE
+	socket_base_t* sockbase;
+	char control[256];
+	struct msghdr msg;
+	struct cmsghdr* cmsg;
+
+	if (sock->base < 0)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	if (sockbase->fd == SOCKET_INVALID)
+		return 0;
+
+	//Without a timestamp array the queue is drained completely, timestamps go to the socket buffer
+	while (!timestamps || (*count < capacity)) {
+		const struct scm_timestamping* stamp = nullptr;
+		const struct sock_extended_err* serr = nullptr;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(sockbase->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+				stamp = (const struct scm_timestamping*)CMSG_DATA(cmsg);
+			else if (((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) ||
+			         ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR)))
+				serr = (const struct sock_extended_err*)CMSG_DATA(cmsg);
+		}
+		if (!serr)
+			continue;
+
+		if ((serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY) && !serr->ee_errno) {
+			//Notification covers the inclusive range [ee_info, ee_data]
+			uint32_t completed = serr->ee_data + 1;
+			if ((int32_t)(completed - (uint32_t)atomic_load32(&sock->zerocopy_completed)) > 0)
+				atomic_store32(&sock->zerocopy_completed, (int32_t)completed);
+			found |= SOCKETERRQUEUE_ZEROCOPY;
+		}
+		else if ((serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING) && (serr->ee_errno == ENOMSG) && stamp) {
+			uint64_t time = ((uint64_t)stamp->ts[0].tv_sec * 1000000000ULL) + (uint64_t)stamp->ts[0].tv_nsec;
+			if (timestamps) {
+				timestamps[*count].id = serr->ee_data;
+				timestamps[*count].time = time;
+				++(*count);
+			}
+			else {
+				_socket_timestamp_push(sock, serr->ee_data, time);
+			}
+			found |= SOCKETERRQUEUE_TIMESTAMP;
+		}
+	}
 #else
-			if ((sockerr == ECONNRESET) || (sockerr == EPIPE) || (sockerr == ETIMEDOUT))
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(timestamps);
+	FOUNDATION_UNUSED(capacity);
+	FOUNDATION_UNUSED(count);
 #endif
-			{
-				socket_close(sock);
+	return found;
+}
+
+bool
+socket_zerocopy_released(socket_t* sock, uint32_t sequence) {
+	//A poll object is the only reader of the error queue for registered sockets, so the
+	//counter has a single writer even when poll runs on another thread
+	if (!sock->poll && ((int32_t)(sequence - (uint32_t)atomic_load32(&sock->zerocopy_completed)) > 0))
+		_socket_read_error_queue(sock, nullptr, 0, nullptr);
+	return ((int32_t)(sequence - (uint32_t)atomic_load32(&sock->zerocopy_completed)) <= 0);
+}
+
+static size_t
+_socket_queue_writev(socket_t* sock, socket_base_t* sockbase, const socket_iovec_t* iov,
+                     size_t count) {
+	socket_queue_t* queue = sock->queue;
+	size_t written = 0;
+	size_t size = 0;
+	size_t queued;
+	size_t iiov;
+	bool notify = false;
+	bool armed = false;
+
+	for (iiov = 0; iiov < count; ++iiov)
+		size += iov[iiov].length;
+
+	mutex_lock(queue->lock);
+
+	if (!queue->head && (sockbase->state == SOCKETSTATE_CONNECTED))
+		written = _socket_writev_fd(sock, sockbase, iov, count, true);
+
+	if ((written < size) && (sockbase->fd != SOCKET_INVALID)) {
+		armed = !queue->head;
+		size_t skip = written;
+		for (iiov = 0; iiov < count; ++iiov) {
+			size_t length = iov[iiov].length;
+			if (skip >= length) {
+				skip -= length;
+				continue;
 			}
+			_socket_queue_push(queue, pointer_offset(iov[iiov].buffer, (ssize_t)skip), length - skip);
+			skip = 0;
+		}
+		written = size;
+		if (!queue->above_high_watermark && (queue->queued >= queue->high_watermark)) {
+			queue->above_high_watermark = true;
+			notify = true;
+		}
+	}
+	queued = queue->queued;
 
-			if (sockbase->state != SOCKETSTATE_NOTCONNECTED)
-				_socket_poll_state(sockbase);
+	mutex_unlock(queue->lock);
 
-			break;
+	//Watch for writable only while data is queued
+	if (armed)
+		_network_poll_update_socket(sock);
+	if (notify && queue->callback)
+		queue->callback(sock, SOCKETQUEUE_HIGH_WATERMARK, queued);
+
+	return written;
+}
+
+size_t
+socket_writev(socket_t* sock, const socket_iovec_t* iov, size_t count) {
+	socket_base_t* sockbase;
+
+	if ((sock->base < 0) || !count)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	_socket_batch_arm(sock);
+	if (sock->queue)
+		return _socket_queue_writev(sock, sockbase, iov, count);
+
+	return _socket_writev_fd(sock, sockbase, iov, count, false);
+}
+
+static size_t
+_socket_queue_send_file(socket_t* sock, socket_base_t* sockbase, int fd, size_t offset,
+                        size_t length) {
+	socket_queue_t* queue = sock->queue;
+	size_t written = 0;
+	size_t queued;
+	bool notify = false;
+	bool armed = false;
+
+	mutex_lock(queue->lock);
+
+	if (!queue->head && (sockbase->state == SOCKETSTATE_CONNECTED))
+		written = _socket_send_file_fd(sock, sockbase, fd, offset, length, true);
+
+	if ((written < length) && (sockbase->fd != SOCKET_INVALID)) {
+		armed = !queue->head;
+		if (!_socket_queue_push_file(queue, fd, offset + written, length - written)) {
+			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+			          STRING_CONST("Unable to duplicate file %d to queue for socket (0x%" PRIfixPTR
+			                       " : %d): %" PRIsize " of %" PRIsize " bytes sent"),
+			          fd, sock, sockbase->fd, written, length);
+			armed = false;
+		}
+		else {
+			written = length;
+		}
+		if (!queue->above_high_watermark && (queue->queued >= queue->high_watermark)) {
+			queue->above_high_watermark = true;
+			notify = true;
 		}
 	}
+	queued = queue->queued;
 
-	sock->bytes_written += total_write;
+	mutex_unlock(queue->lock);
+
+	//Watch for writable only while data is queued
+	if (armed)
+		_network_poll_update_socket(sock);
+	if (notify && queue->callback)
+		queue->callback(sock, SOCKETQUEUE_HIGH_WATERMARK, queued);
+
+	return written;
+}
+
+size_t
+socket_send_file(socket_t* sock, int fd, size_t offset, size_t length) {
+	socket_base_t* sockbase;
+
+	if ((sock->base < 0) || (fd < 0) || !length)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+	_socket_batch_arm(sock);
+	if (sock->queue)
+		return _socket_queue_send_file(sock, sockbase, fd, offset, length);
+
+	return _socket_send_file_fd(sock, sockbase, fd, offset, length, false);
+}
+
+size_t
+socket_send_stream(socket_t* sock, stream_t* stream, size_t length) {
+	char buffer[SOCKET_SENDFILE_BUFFER_SIZE];
+	size_t total_write = 0;
+
+	while ((total_write < length) && !stream_eos(stream)) {
+		size_t chunk = length - total_write;
+		size_t read;
+		size_t written;
+
+		if (chunk > sizeof(buffer))
+			chunk = sizeof(buffer);
+		read = stream_read(stream, buffer, chunk);
+		if (!read)
+			break;
+
+		written = socket_write(sock, buffer, read);
+		total_write += written;
+		if (written < read) {
+			//Rewind unsent data so the caller can resume the transfer
+			stream_seek(stream, -(ssize_t)(read - written), STREAM_SEEK_CURRENT);
+			break;
+		}
+	}
 
 	return total_write;
 }
 
+void
+socket_set_send_queue(socket_t* sock, size_t high_watermark, size_t low_watermark,
+                      socket_queue_fn callback) {
+	socket_queue_t* queue = sock->queue;
+
+	if (!high_watermark) {
+		if (queue) {
+			sock->queue = nullptr;
+			_socket_queue_clear(queue);
+			mutex_deallocate(queue->lock);
+			memory_deallocate(queue);
+			_network_poll_update_socket(sock);
+		}
+		return;
+	}
+
+	if (!queue) {
+		queue = memory_allocate(HASH_NETWORK, sizeof(socket_queue_t), 0,
+		                        MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		queue->lock = mutex_allocate(STRING_CONST("socket_queue"));
+	}
+
+	mutex_lock(queue->lock);
+	queue->high_watermark = high_watermark;
+	queue->low_watermark = (low_watermark < high_watermark) ? low_watermark : high_watermark;
+	queue->callback = callback;
+	queue->release_drained = false;
+	mutex_unlock(queue->lock);
+
+	sock->queue = queue;
+}
+
+size_t
+socket_send_queue_size(const socket_t* sock) {
+	return sock->queue ? sock->queue->queued : 0;
+}
+
+size_t
+socket_send_queue_flush(socket_t* sock) {
+	socket_queue_t* queue = sock->queue;
+	socket_base_t* sockbase;
+	size_t queued;
+	bool notify = false;
+	bool pending, drained, release;
+
+	if (!queue)
+		return 0;
+	if (sock->base < 0)
+		return queue->queued;
+
+	sockbase = _socket_base + sock->base;
+
+	mutex_lock(queue->lock);
+
+	pending = (queue->head != nullptr);
+	while (queue->head && (sockbase->state == SOCKETSTATE_CONNECTED)) {
+		socket_iovec_t iov[SOCKET_IOVEC_MAX];
+		socket_buffer_t* block = queue->head;
+		size_t size = 0;
+		size_t num = 0;
+		size_t written;
+		size_t consume;
+
+		if (block->fd >= 0) {
+			size = block->size - block->offset;
+			written = _socket_send_file_fd(sock, sockbase, block->fd, block->offset, size, true);
+			queue->queued -= written;
+			if (written < size) {
+				block->offset += written;
+				break;
+			}
+			queue->head = block->next;
+			if (!queue->head)
+				queue->tail = nullptr;
+			_socket_queue_release(block);
+			continue;
+		}
+
+		for (; block && (block->fd < 0) && (num < SOCKET_IOVEC_MAX); block = block->next, ++num) {
+			iov[num].buffer = (void*)(block->data + block->offset);
+			iov[num].length = block->size - block->offset;
+			size += block->size - block->offset;
+		}
+
+		written = _socket_writev_fd(sock, sockbase, iov, num, true);
+		queue->queued -= written;
+
+		for (consume = written; consume;) {
+			size_t remain;
+			block = queue->head;
+			remain = block->size - block->offset;
+			if (consume < remain) {
+				block->offset += consume;
+				break;
+			}
+			consume -= remain;
+			queue->head = block->next;
+			if (!queue->head)
+				queue->tail = nullptr;
+			memory_deallocate(block);
+		}
+
+		if (written < size)
+			break;
+	}
+
+	if (sockbase->fd == SOCKET_INVALID)
+		_socket_queue_clear(queue);
+
+	if (queue->above_high_watermark && (queue->queued <= queue->low_watermark)) {
+		queue->above_high_watermark = false;
+		notify = true;
+	}
+	queued = queue->queued;
+	drained = (pending && !queue->head);
+	release = (queue->release_drained && !queue->head);
+
+	mutex_unlock(queue->lock);
+
+	if (release) {
+		socket_set_send_queue(sock, 0, 0, 0);
+		return 0;
+	}
+	if (drained)
+		_network_poll_update_socket(sock);
+	if (notify && queue->callback)
+		queue->callback(sock, SOCKETQUEUE_LOW_WATERMARK, queued);
+
+	return queued;
+}
+
 stream_t*
 socket_stream(socket_t* sock) {
 	socket_stream_t* stream = 0;
@@ -769,6 +2011,7 @@ socket_close(socket_t* sock) {
 	int fd = SOCKET_INVALID;
 	network_address_t* local_address = sock->address_local;
 	network_address_t* remote_address = sock->address_remote;
+	network_address_t* batch_address = sock->address_batch;
 
 	if (sock->base >= 0) {
 		socket_base_t* sockbase = _socket_base + sock->base;
@@ -778,11 +2021,15 @@ socket_close(socket_t* sock) {
 		sockbase->state = SOCKETSTATE_NOTCONNECTED;
 	}
 
+	if (fd != SOCKET_INVALID)
+		NETWORK_TRACE(NETWORKTRACE_CLOSE, sock, fd, 0, sock->bytes_read + sock->bytes_written);
+
 	log_debugf(HASH_NETWORK, STRING_CONST("Closing socket (0x%" PRIfixPTR " : %d)"),
 	           sock, fd);
 
 	sock->address_local  = nullptr;
 	sock->address_remote = nullptr;
+	sock->address_batch  = nullptr;
 
 	if (fd != SOCKET_INVALID) {
 		_socket_set_blocking_fd(fd, false);
@@ -793,6 +2040,13 @@ socket_close(socket_t* sock) {
 		memory_deallocate(local_address);
 	if (remote_address)
 		memory_deallocate(remote_address);
+	if (batch_address)
+		memory_deallocate(batch_address);
+
+	memory_deallocate(sock->coalesce_buffer);
+	sock->coalesce_buffer = nullptr;
+	sock->coalesce_offset = 0;
+	sock->coalesce_size = 0;
 }
 
 void
@@ -874,110 +2128,515 @@ _socket_poll_state(socket_base_t* sockbase) {
 		else
 			break;
 
-	case SOCKETSTATE_DISCONNECTED:
-		if (!socket_available_read(sock)) {
-			log_debugf(HASH_NETWORK,
-			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d): all data read in DISCONNECTED"),
-			           sock, sockbase->fd);
-			socket_close(sock);
-		}
-		break;
+	case SOCKETSTATE_DISCONNECTED:
+		if (!socket_available_read(sock)) {
+			log_debugf(HASH_NETWORK,
+			           STRING_CONST("Socket (0x%" PRIfixPTR " : %d): all data read in DISCONNECTED"),
+			           sock, sockbase->fd);
+			socket_close(sock);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return sockbase->state;
+}
+
+void
+_socket_store_address_local(socket_t* sock, int family) {
+	socket_base_t* sockbase;
+	network_address_ip_t* address_local = 0;
+
+	FOUNDATION_ASSERT(sock);
+	if (sock->base < 0)
+		return;
+
+	sockbase = _socket_base + sock->base;
+	if (family == NETWORK_ADDRESSFAMILY_IPV4) {
+		address_local = memory_allocate(HASH_NETWORK, sizeof(network_address_ipv4_t), 0,
+		                                MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		address_local->family = NETWORK_ADDRESSFAMILY_IPV4;
+		address_local->address_size = sizeof(struct sockaddr_in);
+	}
+	else if (family == NETWORK_ADDRESSFAMILY_IPV6) {
+		address_local = memory_allocate(HASH_NETWORK, sizeof(network_address_ipv6_t), 0,
+		                                MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		address_local->family = NETWORK_ADDRESSFAMILY_IPV6;
+		address_local->address_size = sizeof(struct sockaddr_in6);
+	}
+	else {
+		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
+		                                 "Unable to get local address for socket (0x%" PRIfixPTR
+		                                 " : %d): Unsupported address family %u", sock, sockbase->fd, family);
+		return;
+	}
+	getsockname(sockbase->fd, &address_local->saddr, (socklen_t*)&address_local->address_size);
+	memory_deallocate(sock->address_local);
+	sock->address_local = (network_address_t*)address_local;
+}
+
+static socket_stream_t*
+_socket_stream_allocate(socket_t* sock) {
+	socket_stream_t* sockstream = memory_allocate(HASH_NETWORK, sizeof(socket_stream_t), 0,
+	                                              MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	stream_t* stream = (stream_t*)sockstream;
+
+	//Network streams are always little endian by default
+	stream_initialize(stream, BYTEORDER_LITTLEENDIAN);
+
+	stream->type = STREAMTYPE_SOCKET;
+	stream->sequential = 1;
+	stream->mode = STREAM_OUT | STREAM_IN | STREAM_BINARY;
+	stream->vtable = &_socket_stream_vtable;
+	sockstream->size_in = sock->stream_read_buffer_size;
+	sockstream->size_out = sock->stream_write_buffer_size;
+	sockstream->last_full = time_current();
+	sockstream->socket = sock;
+
+	return sockstream;
+}
+
+static void
+_socket_stream_finalize(stream_t* stream) {
+	socket_stream_t* sockstream;
+	socket_t* sock;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	sock = sockstream->socket;
+
+	FOUNDATION_ASSERT_MSGFORMAT(sock->stream == sockstream,
+	                            "Socket (0x%" PRIfixPTR " : %d): Deallocating stream mismatch, stream is 0x%" PRIfixPTR
+	                            ", socket stream is 0x%" PRIfixPTR, sock,
+	                            (sock->base >= 0) ? _socket_base[ sock->base ].fd : SOCKET_INVALID, sockstream, sock->stream);
+	sock->stream = 0;
+	sockstream->socket = 0;
+
+	//A queue installed by the stream goes with it, once any data still queued is sent
+	if (sockstream->write_queue && (sock->queue == sockstream->write_queue)) {
+		socket_queue_t* queue = sock->queue;
+		bool release;
+		mutex_lock(queue->lock);
+		queue->release_drained = true;
+		release = !queue->head;
+		mutex_unlock(queue->lock);
+		if (release)
+			socket_set_send_queue(sock, 0, 0, 0);
+	}
+
+	_network_buffer_release(sockstream->buffer_in, sockstream->size_in);
+	_network_buffer_release(sockstream->buffer_out, sockstream->size_out);
+	memory_deallocate(sockstream->chunk_out);
+	memory_deallocate(sockstream->chunk_in);
+	memory_deallocate(sockstream->chunk_scratch);
+}
+
+static size_t
+_socket_stream_available_nonblock_read(const socket_stream_t* stream) {
+	return (stream->chunk_in_size - stream->chunk_in_offset) + stream->used_in +
+	       socket_available_read(stream->socket);
+}
+
+static size_t
+_socket_stream_ring_iovec(uint8_t* ring, size_t capacity, size_t offset, size_t size,
+                          socket_iovec_t* iov) {
+	size_t first = capacity - offset;
+	if (offset >= capacity) {
+		offset -= capacity;
+		first = capacity - offset;
+	}
+	iov[0].buffer = ring + offset;
+	if (size <= first) {
+		iov[0].length = size;
+		return 1;
+	}
+	iov[0].length = first;
+	iov[1].buffer = ring;
+	iov[1].length = size - first;
+	return 2;
+}
+
+static size_t
+_socket_stream_ring_transfer(socket_t* sock, socket_iovec_t* iov, size_t count, bool write) {
+	if (count > 1)
+		return write ? socket_writev(sock, iov, count) : socket_readv(sock, iov, count);
+	return write ? socket_write(sock, iov[0].buffer, iov[0].length) :
+	       socket_read(sock, iov[0].buffer, iov[0].length);
+}
+
+static void
+_socket_stream_resize(uint8_t** buffer, size_t* size, size_t* offset, size_t used, size_t new_size) {
+	socket_iovec_t iov[2];
+	uint8_t* resized;
+	size_t count;
+
+	//Never drop buffered data when shrinking
+	if (new_size < used)
+		new_size = used;
+	if (new_size == *size)
+		return;
+
+	//Detached buffers are borrowed with the new size on next use
+	if (*buffer) {
+		resized = _network_buffer_acquire(new_size);
+		if (used) {
+			count = _socket_stream_ring_iovec(*buffer, *size, *offset, used, iov);
+			memcpy(resized, iov[0].buffer, iov[0].length);
+			if (count > 1)
+				memcpy(resized + iov[0].length, iov[1].buffer, iov[1].length);
+		}
+		_network_buffer_release(*buffer, *size);
+		*buffer = resized;
+	}
+
+	*size = new_size;
+	*offset = 0;
+}
+
+static void
+_socket_stream_detach_in(socket_stream_t* stream) {
+	//Return empty buffers to the shared pool so idle streams hold no buffer memory
+	if (stream->buffer_in && !stream->used_in) {
+		_network_buffer_release(stream->buffer_in, stream->size_in);
+		stream->buffer_in = 0;
+		stream->offset_in = 0;
+	}
+}
+
+static void
+_socket_stream_detach_out(socket_stream_t* stream) {
+	if (stream->buffer_out && !stream->used_out) {
+		_network_buffer_release(stream->buffer_out, stream->size_out);
+		stream->buffer_out = 0;
+		stream->offset_out = 0;
+	}
+}
+
+static void
+_socket_stream_autotune(socket_stream_t* stream, bool full) {
+	socket_t* sock = stream->socket;
+	size_t size;
+
+	if (!sock->stream_read_buffer_max)
+		return;
+
+	if (full) {
+		stream->last_full = time_current();
+		if (stream->size_in >= sock->stream_read_buffer_max)
+			return;
+		size = stream->size_in * 2;
+		if (size > sock->stream_read_buffer_max)
+			size = sock->stream_read_buffer_max;
+	}
+	else {
+		if ((stream->size_in <= sock->stream_read_buffer_size) ||
+		        (time_elapsed(stream->last_full) < REAL_C(SOCKET_STREAM_IDLE_TIMEOUT)))
+			return;
+		size = sock->stream_read_buffer_size;
+		stream->last_full = time_current();
+	}
+
+	_socket_stream_resize(&stream->buffer_in, &stream->size_in, &stream->offset_in, stream->used_in, size);
+}
+
+static size_t
+_socket_stream_fill(socket_stream_t* stream) {
+	socket_iovec_t iov[2];
+	size_t count, read, space;
+
+	if (!stream->used_in)
+		_socket_stream_autotune(stream, false);
+
+	if (stream->used_in == stream->size_in)
+		return 0;
+
+	//Restart at the beginning of the ring when drained to read in a single segment
+	if (!stream->used_in)
+		stream->offset_in = 0;
+	if (!stream->buffer_in)
+		stream->buffer_in = _network_buffer_acquire(stream->size_in);
+
+	space = stream->size_in - stream->used_in;
+	count = _socket_stream_ring_iovec(stream->buffer_in, stream->size_in,
+	                                  stream->offset_in + stream->used_in, space, iov);
+	read = _socket_stream_ring_transfer(stream->socket, iov, count, false);
+	stream->used_in += read;
+	if (!read)
+		_socket_stream_detach_in(stream);
+
+	//More data is likely pending when the read used all available space
+	if (read && (read == space))
+		_socket_stream_autotune(stream, true);
+
+	return read;
+}
+
+static size_t
+_socket_stream_fill_direct(socket_stream_t* stream, void* buffer, size_t size) {
+	socket_iovec_t iov[2];
+	size_t read;
+
+	//Read straight into the caller buffer, with any excess landing in the empty ring
+	FOUNDATION_ASSERT(!stream->used_in);
+	if (!stream->buffer_in)
+		stream->buffer_in = _network_buffer_acquire(stream->size_in);
+	stream->offset_in = 0;
+
+	iov[0].buffer = buffer;
+	iov[0].length = size;
+	iov[1].buffer = stream->buffer_in;
+	iov[1].length = stream->size_in;
+	read = _socket_stream_ring_transfer(stream->socket, iov, 2, false);
+	if (read > size)
+		stream->used_in = read - size;
+	else
+		_socket_stream_detach_in(stream);
+	return read;
+}
+
+static void
+_socket_stream_consume(socket_stream_t* stream, size_t size) {
+	stream->used_in -= size;
+	stream->offset_in += size;
+	if (stream->offset_in >= stream->size_in)
+		stream->offset_in -= stream->size_in;
+	if (!stream->used_in)
+		stream->offset_in = 0;
+}
 
-	default:
-		break;
+static void
+_socket_stream_reverse(uint8_t* begin, uint8_t* end) {
+	while (begin < --end) {
+		uint8_t swap = *begin;
+		*begin++ = *end;
+		*end = swap;
 	}
+}
 
-	return sockbase->state;
+static void
+_socket_stream_rotate(uint8_t* buffer, size_t size, size_t offset) {
+	//Rotate ring in place so that data at the offset starts at the beginning
+	_socket_stream_reverse(buffer, buffer + offset);
+	_socket_stream_reverse(buffer + offset, buffer + size);
+	_socket_stream_reverse(buffer, buffer + size);
 }
 
-void
-_socket_store_address_local(socket_t* sock, int family) {
-	socket_base_t* sockbase;
-	network_address_ip_t* address_local = 0;
+static void
+_socket_stream_linearize(socket_stream_t* stream) {
+	_socket_stream_rotate(stream->buffer_in, stream->size_in, stream->offset_in);
+	stream->offset_in = 0;
+}
 
-	FOUNDATION_ASSERT(sock);
-	if (sock->base < 0)
+static void
+_socket_stream_reserve(uint8_t** buffer, size_t* capacity, size_t size) {
+	if (*capacity >= size)
 		return;
+	memory_deallocate(*buffer);
+	*buffer = memory_allocate(HASH_NETWORK, size, 0, MEMORY_PERSISTENT);
+	*capacity = size;
+}
 
-	sockbase = _socket_base + sock->base;
-	if (family == NETWORK_ADDRESSFAMILY_IPV4) {
-		address_local = memory_allocate(HASH_NETWORK, sizeof(network_address_ipv4_t), 0,
-		                                MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
-		address_local->family = NETWORK_ADDRESSFAMILY_IPV4;
-		address_local->address_size = sizeof(struct sockaddr_in);
+static size_t
+_socket_stream_transform_bound(const socket_stream_t* stream, size_t size) {
+	//Largest intermediate size produced by the encode chain
+	size_t bound = size;
+	unsigned int itrans;
+	for (itrans = 0; itrans < stream->transform_count; ++itrans) {
+		const socket_transform_t* transform = stream->transforms[itrans];
+		size = transform->bound(transform, size);
+		if (size > bound)
+			bound = size;
 	}
-	else if (family == NETWORK_ADDRESSFAMILY_IPV6) {
-		address_local = memory_allocate(HASH_NETWORK, sizeof(network_address_ipv6_t), 0,
-		                                MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
-		address_local->family = NETWORK_ADDRESSFAMILY_IPV6;
-		address_local->address_size = sizeof(struct sockaddr_in6);
+	return bound;
+}
+
+static void
+_socket_stream_chunk_header(uint8_t* header, size_t encoded, size_t plain) {
+	unsigned int ibyte;
+	for (ibyte = 0; ibyte < 4; ++ibyte) {
+		header[ibyte] = (uint8_t)(encoded >> (8 * ibyte));
+		header[4 + ibyte] = (uint8_t)(plain >> (8 * ibyte));
 	}
-	else {
-		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
-		                                 "Unable to get local address for socket (0x%" PRIfixPTR
-		                                 " : %d): Unsupported address family %u", sock, sockbase->fd, family);
-		return;
+}
+
+static bool
+_socket_stream_encode(socket_stream_t* stream) {
+	const uint8_t* input;
+	size_t size, bound;
+	unsigned int itrans;
+
+	if (stream->offset_out + stream->used_out > stream->size_out) {
+		_socket_stream_rotate(stream->buffer_out, stream->size_out, stream->offset_out);
+		stream->offset_out = 0;
 	}
-	getsockname(sockbase->fd, &address_local->saddr, (socklen_t*)&address_local->address_size);
-	memory_deallocate(sock->address_local);
-	sock->address_local = (network_address_t*)address_local;
+
+	bound = _socket_stream_transform_bound(stream, stream->used_out);
+	_socket_stream_reserve(&stream->chunk_out, &stream->chunk_out_capacity, SOCKET_STREAM_CHUNK_HEADER + bound);
+	_socket_stream_reserve(&stream->chunk_scratch, &stream->chunk_scratch_capacity, bound);
+
+	//Alternate between scratch and chunk buffers so the last transform lands in the chunk
+	input = stream->buffer_out + stream->offset_out;
+	size = stream->used_out;
+	for (itrans = 0; itrans < stream->transform_count; ++itrans) {
+		const socket_transform_t* transform = stream->transforms[itrans];
+		uint8_t* output = ((stream->transform_count - itrans) & 1) ?
+		                  stream->chunk_out + SOCKET_STREAM_CHUNK_HEADER : stream->chunk_scratch;
+		size = transform->encode(transform, input, size, output, bound);
+		if (!size)
+			return false;
+		input = output;
+	}
+
+	_socket_stream_chunk_header(stream->chunk_out, size, stream->used_out);
+	stream->chunk_out_size = SOCKET_STREAM_CHUNK_HEADER + size;
+	stream->chunk_out_offset = 0;
+	return true;
 }
 
-static socket_stream_t*
-_socket_stream_allocate(socket_t* sock) {
-	size_t size = sizeof(socket_stream_t) + _network_config.stream_read_buffer_size +
-	              _network_config.stream_write_buffer_size;
+static void
+_socket_stream_doflush_chunk(socket_stream_t* stream) {
+	socket_t* sock = stream->socket;
+
+	if (stream->chunk_out_offset < stream->chunk_out_size) {
+		stream->chunk_out_offset += socket_write(sock, stream->chunk_out + stream->chunk_out_offset,
+		                                         stream->chunk_out_size - stream->chunk_out_offset);
+		if (stream->chunk_out_offset < stream->chunk_out_size)
+			return;
+	}
 
-	socket_stream_t* sockstream = memory_allocate(HASH_NETWORK, size, 0,
-	                                              MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
-	stream_t* stream = (stream_t*)sockstream;
+	if (!stream->used_out)
+		return;
 
-	//Network streams are always little endian by default
-	stream_initialize(stream, BYTEORDER_LITTLEENDIAN);
+	if (!_socket_stream_encode(stream)) {
+		log_errorf(HASH_NETWORK, ERROR_INTERNAL_FAILURE,
+		           STRING_CONST("Socket stream (0x%" PRIfixPTR "): transform failed to encode %" PRIsize " bytes"),
+		           sock, stream->used_out);
+		socket_close(sock);
+		return;
+	}
 
-	stream->type = STREAMTYPE_SOCKET;
-	stream->sequential = 1;
-	stream->mode = STREAM_OUT | STREAM_IN | STREAM_BINARY;
-	stream->vtable = &_socket_stream_vtable;
-	sockstream->buffer_in = sockstream->buffers;
-	sockstream->buffer_out = pointer_offset(sockstream->buffer_in,
-	                                        _network_config.stream_read_buffer_size);
-	sockstream->socket = sock;
+	stream->used_out = 0;
+	stream->offset_out = 0;
+	_socket_stream_detach_out(stream);
 
-	return sockstream;
+	stream->chunk_out_offset = socket_write(sock, stream->chunk_out, stream->chunk_out_size);
 }
 
-static void
-_socket_stream_finalize(stream_t* stream) {
-	socket_stream_t* sockstream;
-	socket_t* sock;
+static bool
+_socket_stream_decode(socket_stream_t* stream) {
+	socket_t* sock = stream->socket;
+	socket_stream_view_t view;
+	const uint8_t* header;
+	const uint8_t* input;
+	uint8_t* target;
+	size_t encoded = 0, plain = 0, size, bound, limit, retained;
+	unsigned int ibyte, itrans;
+
+	view = _socket_stream_peek_raw(stream, SOCKET_STREAM_CHUNK_HEADER);
+	if (view.length < SOCKET_STREAM_CHUNK_HEADER)
+		return false;
 
-	FOUNDATION_ASSERT(stream);
-	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+	header = view.buffer;
+	for (ibyte = 0; ibyte < 4; ++ibyte) {
+		encoded |= (size_t)header[ibyte] << (8 * ibyte);
+		plain |= (size_t)header[4 + ibyte] << (8 * ibyte);
+	}
+	//Validate against the chunk limit before growing any buffer for the peer
+	limit = stream->chunk_limit ? stream->chunk_limit : sock->stream_write_buffer_size;
+	if (!encoded || !plain || (plain > limit) || (encoded > _socket_stream_transform_bound(stream, limit)))
+		goto invalid;
+
+	size = SOCKET_STREAM_CHUNK_HEADER + encoded;
+	if (size > stream->size_in) {
+		if (!stream->chunk_restore_in)
+			stream->chunk_restore_in = stream->size_in;
+		_socket_stream_resize(&stream->buffer_in, &stream->size_in, &stream->offset_in, stream->used_in, size);
+	}
+	view = _socket_stream_peek_raw(stream, size);
+	if (view.length < size)
+		return false;
 
-	sockstream = (socket_stream_t*)stream;
-	sock = sockstream->socket;
+	bound = _socket_stream_transform_bound(stream, plain);
+	if (bound < encoded)
+		bound = encoded;
+	//Decoded data not yet consumed is kept in front of the new chunk for peeking across chunks
+	retained = stream->chunk_in_size - stream->chunk_in_offset;
+	if (stream->chunk_in_capacity < retained + bound) {
+		uint8_t* chunk = memory_allocate(HASH_NETWORK, retained + bound, 0, MEMORY_PERSISTENT);
+		if (retained)
+			memcpy(chunk, stream->chunk_in + stream->chunk_in_offset, retained);
+		memory_deallocate(stream->chunk_in);
+		stream->chunk_in = chunk;
+		stream->chunk_in_capacity = retained + bound;
+	}
+	else if (retained && stream->chunk_in_offset) {
+		memmove(stream->chunk_in, stream->chunk_in + stream->chunk_in_offset, retained);
+	}
+	stream->chunk_in_offset = 0;
+	stream->chunk_in_size = retained;
+	_socket_stream_reserve(&stream->chunk_scratch, &stream->chunk_scratch_capacity, bound);
+
+	//Undo transforms in reverse order, the first transform decodes into the chunk buffer
+	input = pointer_offset_const(view.buffer, SOCKET_STREAM_CHUNK_HEADER);
+	target = stream->chunk_in + retained;
+	size = encoded;
+	for (itrans = stream->transform_count; itrans-- > 0;) {
+		const socket_transform_t* transform = stream->transforms[itrans];
+		uint8_t* output = (itrans & 1) ? stream->chunk_scratch : target;
+		size = transform->decode(transform, input, size, output, bound);
+		if (!size)
+			goto invalid;
+		input = output;
+	}
+	if (size != plain)
+		goto invalid;
+
+	_socket_stream_consume(stream, SOCKET_STREAM_CHUNK_HEADER + encoded);
+	stream->chunk_in_size = retained + plain;
+	if (stream->chunk_restore_in) {
+		_socket_stream_resize(&stream->buffer_in, &stream->size_in, &stream->offset_in, stream->used_in,
+		                      stream->chunk_restore_in);
+		if (stream->size_in == stream->chunk_restore_in)
+			stream->chunk_restore_in = 0;
+	}
+	return true;
 
-	FOUNDATION_ASSERT_MSGFORMAT(sock->stream == sockstream,
-	                            "Socket (0x%" PRIfixPTR " : %d): Deallocating stream mismatch, stream is 0x%" PRIfixPTR
-	                            ", socket stream is 0x%" PRIfixPTR, sock,
-	                            (sock->base >= 0) ? _socket_base[ sock->base ].fd : SOCKET_INVALID, sockstream, sock->stream);
-	sock->stream = 0;
-	sockstream->socket = 0;
+invalid:
+
+	log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+	          STRING_CONST("Socket stream (0x%" PRIfixPTR "): invalid transformed chunk (%" PRIsize " of %" PRIsize
+	                       " bytes), closing socket"), sock, encoded, plain);
+	socket_close(sock);
+	return false;
 }
 
-static size_t
-_socket_stream_available_nonblock_read(const socket_stream_t* stream) {
-	return (stream->write_in - stream->read_in) + socket_available_read(stream->socket);
+static void
+_socket_stream_release_queue(socket_stream_t* stream) {
+	//Queued data must reach the kernel before the queue goes, later writes queue behind it
+	socket_t* sock = stream->socket;
+	if (sock->queue == stream->write_queue) {
+		if (socket_send_queue_size(sock))
+			return;
+		socket_set_send_queue(sock, 0, 0, 0);
+	}
+	stream->write_queue = nullptr;
+	stream->write_queue_release = false;
 }
 
 static void
 _socket_stream_doflush(socket_stream_t* stream) {
 	socket_t* sock;
 	socket_base_t* sockbase;
-	size_t written;
+	socket_iovec_t iov[2];
+	size_t count, written;
 
-	if (!stream->write_out)
+	if (stream->write_queue_release)
+		_socket_stream_release_queue(stream);
+	if (!stream->used_out && (stream->chunk_out_offset >= stream->chunk_out_size))
 		return;
 	sock = stream->socket;
 	if (sock->base < 0)
@@ -987,81 +2646,150 @@ _socket_stream_doflush(socket_stream_t* stream) {
 	if (sockbase->state != SOCKETSTATE_CONNECTED)
 		return;
 
-	written = socket_write(sock, stream->buffer_out, stream->write_out);
+	if (stream->transform_count) {
+		_socket_stream_doflush_chunk(stream);
+		return;
+	}
+
+	//Partial writes only advance the ring offset, pending data is never moved
+	count = _socket_stream_ring_iovec(stream->buffer_out, stream->size_out, stream->offset_out,
+	                                  stream->used_out, iov);
+	written = _socket_stream_ring_transfer(sock, iov, count, true);
 	if (written) {
-		if (written < stream->write_out) {
-			memmove(stream->buffer_out, stream->buffer_out + written, stream->write_out - written);
-			stream->write_out -= written;
-		}
-		else {
-			stream->write_out = 0;
-		}
+		stream->used_out -= written;
+		stream->offset_out += written;
+		if (stream->offset_out >= stream->size_out)
+			stream->offset_out -= stream->size_out;
+		if (!stream->used_out)
+			_socket_stream_detach_out(stream);
 	}
 }
 
 static size_t
-_socket_stream_read(stream_t* stream, void* buffer, size_t size) {
-	socket_stream_t* sockstream;
-	socket_t* sock;
-
-	socket_base_t* sockbase;
+_socket_stream_read_buffered(socket_stream_t* sockstream, void* buffer, size_t size) {
 	size_t was_read = 0;
 	size_t copy;
 	bool try_again;
 	size_t want_read;
 
-	sockstream = (socket_stream_t*)stream;
-	sock = sockstream->socket;
-	if (sock->base < 0)
-		return 0;
-
-	sockbase = _socket_base + sock->base;
-
-	if ((sockbase->state != SOCKETSTATE_CONNECTED) && (sockbase->state != SOCKETSTATE_DISCONNECTED))
-		goto exit;
-
-	if (!size)
-		goto exit;
-
 	do {
 		try_again = false;
 
-		copy = (sockstream->write_in - sockstream->read_in);
+		copy = sockstream->used_in;
 
 		want_read = size - was_read;
 		if (copy > want_read)
 			copy = want_read;
 
 		if (copy > 0) {
-			if (buffer)
-				memcpy(buffer, sockstream->buffer_in + sockstream->read_in, copy);
+			if (buffer) {
+				socket_iovec_t iov[2];
+				size_t count = _socket_stream_ring_iovec(sockstream->buffer_in, sockstream->size_in,
+				                                         sockstream->offset_in, copy, iov);
+				memcpy(pointer_offset(buffer, was_read), iov[0].buffer, iov[0].length);
+				if (count > 1)
+					memcpy(pointer_offset(buffer, was_read + iov[0].length), iov[1].buffer, iov[1].length);
+			}
 
 #if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
 			log_debugf(HASH_NETWORK, STRING_CONST("Socket stream (0x%" PRIfixPTR
 			                                      " : %d) read %" PRIsize" of %" PRIsize " bytes from buffer position %" PRIsize),
-			           sock, sockbase->fd, copy, want_read, sockstream->read_in);
+			           sockstream->socket, _socket_base[ sockstream->socket->base ].fd, copy, want_read,
+			           sockstream->offset_in);
 #endif
 
 			was_read += copy;
-			sockstream->read_in += copy;
-			if (sockstream->read_in == sockstream->write_in) {
-				sockstream->read_in = 0;
-				sockstream->write_in = 0;
-			}
+			_socket_stream_consume(sockstream, copy);
 		}
 
 		if (was_read < size) {
-			FOUNDATION_ASSERT(sockstream->read_in == 0);
-			FOUNDATION_ASSERT(sockstream->write_in == 0);
-			sockstream->read_in = 0;
-			sockstream->write_in = socket_read(sock, sockstream->buffer_in,
-			                                   _network_config.stream_read_buffer_size);
-			if (sockstream->write_in > 0)
+			FOUNDATION_ASSERT(sockstream->used_in == 0);
+			want_read = size - was_read;
+			if (buffer && (want_read >= sockstream->size_in)) {
+				//Large reads bypass the ring, avoiding the extra copy and one syscall per ring size
+				size_t direct = _socket_stream_fill_direct(sockstream, pointer_offset(buffer, was_read),
+				                                           want_read);
+				if (direct > 0) {
+					was_read += (direct < want_read) ? direct : want_read;
+					try_again = true;
+				}
+			}
+			else if (_socket_stream_fill(sockstream) > 0) {
 				try_again = true;
+			}
 		}
 	}
 	while ((was_read < size) && try_again);
 
+	return was_read;
+}
+
+static void
+_socket_stream_shrink_chunk(socket_stream_t* stream) {
+	//Buffers for chunks above the default limit are only held until the chunk is consumed
+	size_t bound = _socket_stream_transform_bound(stream, stream->socket->stream_write_buffer_size);
+	if (stream->chunk_in_capacity > bound) {
+		memory_deallocate(stream->chunk_in);
+		stream->chunk_in = 0;
+		stream->chunk_in_capacity = 0;
+	}
+	if (stream->chunk_scratch_capacity > bound) {
+		memory_deallocate(stream->chunk_scratch);
+		stream->chunk_scratch = 0;
+		stream->chunk_scratch_capacity = 0;
+	}
+}
+
+static size_t
+_socket_stream_read_chunked(socket_stream_t* sockstream, void* buffer, size_t size) {
+	size_t was_read = 0;
+
+	while (was_read < size) {
+		size_t copy = sockstream->chunk_in_size - sockstream->chunk_in_offset;
+		if (!copy) {
+			if (!_socket_stream_decode(sockstream))
+				break;
+			continue;
+		}
+		if (copy > size - was_read)
+			copy = size - was_read;
+		if (buffer)
+			memcpy(pointer_offset(buffer, was_read), sockstream->chunk_in + sockstream->chunk_in_offset, copy);
+		sockstream->chunk_in_offset += copy;
+		was_read += copy;
+		if (sockstream->chunk_in_offset == sockstream->chunk_in_size)
+			_socket_stream_shrink_chunk(sockstream);
+	}
+
+	return was_read;
+}
+
+static size_t
+_socket_stream_read(stream_t* stream, void* buffer, size_t size) {
+	socket_stream_t* sockstream;
+	socket_t* sock;
+
+	socket_base_t* sockbase;
+	size_t was_read = 0;
+
+	sockstream = (socket_stream_t*)stream;
+	sock = sockstream->socket;
+	if (sock->base < 0)
+		return 0;
+
+	sockbase = _socket_base + sock->base;
+
+	if ((sockbase->state != SOCKETSTATE_CONNECTED) && (sockbase->state != SOCKETSTATE_DISCONNECTED))
+		goto exit;
+
+	if (!size)
+		goto exit;
+
+	if (sockstream->transform_count)
+		was_read = _socket_stream_read_chunked(sockstream, buffer, size);
+	else
+		was_read = _socket_stream_read_buffered(sockstream, buffer, size);
+
 	if (was_read < size) {
 		if (was_read)
 			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
@@ -1069,6 +2797,7 @@ _socket_stream_read(stream_t* stream, void* buffer, size_t size) {
 			          sock, sockbase->fd, was_read, size);
 		_socket_poll_state(sockbase);
 	}
+	_socket_stream_detach_in(sockstream);
 
 exit:
 
@@ -1089,7 +2818,7 @@ _socket_stream_write(stream_t* stream, const void* buffer, size_t size) {
 		return 0;
 
 	sockbase = _socket_base + sock->base;
-	remain = _network_config.stream_write_buffer_size - sockstream->write_out;
+	remain = sockstream->size_out - sockstream->used_out;
 
 	if (sockbase->state != SOCKETSTATE_CONNECTED)
 		goto exit;
@@ -1098,27 +2827,37 @@ _socket_stream_write(stream_t* stream, const void* buffer, size_t size) {
 		goto exit;
 
 	do {
-		if (size <= remain) {
-			memcpy(sockstream->buffer_out + sockstream->write_out, buffer, (size_t)size);
-
-			sockstream->write_out += (unsigned int)size;
-			was_written += size;
-			size = 0;
+		socket_iovec_t iov[2];
+		size_t copy = (size < remain) ? size : remain;
+
+		if (copy) {
+			size_t count;
+			if (!sockstream->buffer_out)
+				sockstream->buffer_out = _network_buffer_acquire(sockstream->size_out);
+			count = _socket_stream_ring_iovec(sockstream->buffer_out, sockstream->size_out,
+			                                  sockstream->offset_out + sockstream->used_out, copy, iov);
+			memcpy(iov[0].buffer, buffer, iov[0].length);
+			if (count > 1)
+				memcpy(iov[1].buffer, pointer_offset_const(buffer, iov[0].length), iov[1].length);
+			buffer = pointer_offset_const(buffer, copy);
+
+			size -= copy;
+			was_written += copy;
+			sockstream->used_out += copy;
+		}
 
+		if (!size)
 			break;
-		}
 
-		if (remain) {
-			memcpy(sockstream->buffer_out + sockstream->write_out, buffer, remain);
-			buffer = pointer_offset_const(buffer, remain);
+		_socket_stream_doflush(sockstream);
 
-			size -= remain;
-			was_written += remain;
-			sockstream->write_out += remain;
+		//With a send queue the flush drained the ring, large remainders skip the extra copy
+		if (sockstream->nonblocking_write && sock->queue && !sockstream->used_out &&
+		        !sockstream->transform_count && (size >= sockstream->size_out)) {
+			was_written += socket_write(sock, buffer, size);
+			break;
 		}
 
-		_socket_stream_doflush(sockstream);
-
 		if (sockbase->state != SOCKETSTATE_CONNECTED) {
 			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
 			          STRING_CONST("Socket stream (0x%" PRIfixPTR " : %d): partial write %d of %d bytes"),
@@ -1126,7 +2865,7 @@ _socket_stream_write(stream_t* stream, const void* buffer, size_t size) {
 			break;
 		}
 
-		remain = _network_config.stream_write_buffer_size - sockstream->write_out;
+		remain = sockstream->size_out - sockstream->used_out;
 
 	}
 	while (remain);
@@ -1186,15 +2925,162 @@ _socket_stream_buffer_read(stream_t* stream) {
 	sockbase = _socket_base + sock->base;
 	if ((sockbase->state != SOCKETSTATE_CONNECTED) || (sockbase->fd == SOCKET_INVALID))
 		return;
-	if (sockstream->write_in)
-		return;
 
+	//Top up the ring with whatever fits, unread data remains in place
 	available = _socket_available_fd(sockbase->fd);
-	if (available > 0) {
-		size_t was_read = socket_read(sock, sockstream->buffer_in, _network_config.stream_read_buffer_size);
-		if (was_read > 0)
-			sockstream->write_in += was_read;
+	if (available > 0)
+		_socket_stream_fill(sockstream);
+}
+
+void
+socket_stream_set_nonblocking_write(stream_t* stream, bool nonblocking) {
+	socket_stream_t* sockstream;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	sockstream->nonblocking_write = nonblocking;
+	sockstream->write_queue_release = false;
+	if (nonblocking) {
+		socket_queue_t* queue = sockstream->socket->queue;
+		if (!queue || queue->release_drained) {
+			//Also take over a queue left draining by a previous stream on the socket
+			socket_set_send_queue(sockstream->socket, SOCKET_STREAM_QUEUE_WATERMARK,
+			                      SOCKET_STREAM_QUEUE_WATERMARK / 4, 0);
+			sockstream->write_queue = sockstream->socket->queue;
+		}
+		return;
+	}
+
+	//Only remove a queue installed above, never one set up by the user
+	if (sockstream->write_queue) {
+		socket_send_queue_flush(sockstream->socket);
+		sockstream->write_queue_release = true;
+		_socket_stream_release_queue(sockstream);
+	}
+}
+
+size_t
+socket_stream_pending_write(stream_t* stream) {
+	socket_stream_t* sockstream;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	return sockstream->used_out + (sockstream->chunk_out_size - sockstream->chunk_out_offset) +
+	       socket_send_queue_size(sockstream->socket);
+}
+
+bool
+socket_stream_add_transform(stream_t* stream, const socket_transform_t* transform) {
+	socket_stream_t* sockstream;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	if (!transform || (sockstream->transform_count >= SOCKET_STREAM_TRANSFORM_MAX))
+		return false;
+	sockstream->transforms[sockstream->transform_count++] = transform;
+	return true;
+}
+
+void
+socket_stream_set_chunk_limit(stream_t* stream, size_t limit) {
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	if (limit > SOCKET_STREAM_CHUNK_MAX)
+		limit = SOCKET_STREAM_CHUNK_MAX;
+	((socket_stream_t*)stream)->chunk_limit = limit;
+}
+
+static socket_stream_view_t
+_socket_stream_peek_raw(socket_stream_t* sockstream, size_t min_bytes) {
+	socket_t* sock = sockstream->socket;
+	socket_base_t* sockbase;
+	socket_stream_view_t view;
+	size_t contiguous;
+
+	if (min_bytes > sockstream->size_in)
+		min_bytes = sockstream->size_in;
+
+	if (sock->base >= 0) {
+		sockbase = _socket_base + sock->base;
+		while ((sockstream->used_in < min_bytes) &&
+		        ((sockbase->state == SOCKETSTATE_CONNECTED) || (sockbase->state == SOCKETSTATE_DISCONNECTED))) {
+			if (!_socket_stream_fill(sockstream)) {
+				_socket_poll_state(sockbase);
+				break;
+			}
+		}
+	}
+
+	view.buffer = 0;
+	view.length = 0;
+	if (!sockstream->buffer_in)
+		return view;
+
+	//Only rotate when the wanted bytes straddle the wrap point
+	contiguous = sockstream->size_in - sockstream->offset_in;
+	if ((contiguous < sockstream->used_in) && (contiguous < min_bytes))
+		_socket_stream_linearize(sockstream);
+
+	contiguous = sockstream->size_in - sockstream->offset_in;
+	view.buffer = sockstream->buffer_in + sockstream->offset_in;
+	view.length = (sockstream->used_in < contiguous) ? sockstream->used_in : contiguous;
+	return view;
+}
+
+socket_stream_view_t
+socket_stream_peek(stream_t* stream, size_t min_bytes) {
+	socket_stream_t* sockstream;
+	socket_stream_view_t view;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	if (!sockstream->transform_count)
+		return _socket_stream_peek_raw(sockstream, min_bytes);
+
+	//Transformed streams are viewed through the decoded chunk data
+	if (min_bytes > sockstream->size_in)
+		min_bytes = sockstream->size_in;
+	while ((sockstream->chunk_in_size - sockstream->chunk_in_offset) < min_bytes) {
+		if (!_socket_stream_decode(sockstream))
+			break;
+	}
+	_socket_stream_detach_in(sockstream);
+	view.buffer = sockstream->chunk_in ? sockstream->chunk_in + sockstream->chunk_in_offset : 0;
+	view.length = sockstream->chunk_in_size - sockstream->chunk_in_offset;
+	return view;
+}
+
+size_t
+socket_stream_consume(stream_t* stream, size_t size) {
+	socket_stream_t* sockstream;
+
+	FOUNDATION_ASSERT(stream);
+	FOUNDATION_ASSERT(stream->type == STREAMTYPE_SOCKET);
+
+	sockstream = (socket_stream_t*)stream;
+	if (sockstream->transform_count) {
+		if (size > sockstream->chunk_in_size - sockstream->chunk_in_offset)
+			size = sockstream->chunk_in_size - sockstream->chunk_in_offset;
+		sockstream->chunk_in_offset += size;
+		if (size && (sockstream->chunk_in_offset == sockstream->chunk_in_size))
+			_socket_stream_shrink_chunk(sockstream);
+		return size;
 	}
+	if (size > sockstream->used_in)
+		size = sockstream->used_in;
+	if (size)
+		_socket_stream_consume(sockstream, size);
+	_socket_stream_detach_in(sockstream);
+	return size;
 }
 
 static void
@@ -72,5 +72,285 @@ socket_read(socket_t* sock, void* buffer, size_t size);
 NETWORK_API size_t
 socket_write(socket_t* sock, const void* buffer, size_t size);
 
+/*! Query the kernel send buffer size of the socket
+\param sock Socket
+\return     Effective size as reported by the kernel, or requested size if the socket
+             has no descriptor yet (0 for system default) */
+NETWORK_API size_t
+socket_send_buffer_size(const socket_t* sock);
+
+/*! Set the kernel send buffer size (SO_SNDBUF) of the socket. The size is also applied
+when the socket descriptor is created. The kernel may adjust or clamp the size.
+\param sock Socket
+\param size Requested size in bytes
+\return     Effective size granted by the kernel */
+NETWORK_API size_t
+socket_set_send_buffer_size(socket_t* sock, size_t size);
+
+/*! Query the kernel receive buffer size of the socket
+\param sock Socket
+\return     Effective size as reported by the kernel, or requested size if the socket
+             has no descriptor yet (0 for system default) */
+NETWORK_API size_t
+socket_receive_buffer_size(const socket_t* sock);
+
+/*! Set the kernel receive buffer size (SO_RCVBUF) of the socket. The size is also applied
+when the socket descriptor is created. The kernel may adjust or clamp the size.
+\param sock Socket
+\param size Requested size in bytes
+\return     Effective size granted by the kernel */
+NETWORK_API size_t
+socket_set_receive_buffer_size(socket_t* sock, size_t size);
+
+/*! Enable receive buffer autotuning. The receive buffer is doubled, up to the given
+limit, when datagram reads detect dropped packets (the kernel drop counter on Linux,
+a nearly full receive queue on other platforms).
+\param sock     Socket
+\param max_size Maximum receive buffer size, 0 to disable autotuning */
+NETWORK_API void
+socket_set_receive_buffer_autotune(socket_t* sock, size_t max_size);
+
+/*! Query number of datagrams dropped by the kernel since autotuning was enabled,
+only tracked on Linux
+\param sock Socket
+\return     Number of dropped datagrams */
+NETWORK_API size_t
+socket_receive_dropped(const socket_t* sock);
+
+/*! Set the size of the buffers used by the socket stream. Takes effect immediately if the
+stream is already allocated, buffered data is preserved.
+\param sock       Socket
+\param read_size  Read buffer size in bytes, 0 for configured default
+\param write_size Write buffer size in bytes, 0 for configured default */
+NETWORK_API void
+socket_set_stream_buffer_size(socket_t* sock, size_t read_size, size_t write_size);
+
+/*! Enable stream read buffer autotuning. The read buffer is doubled, up to the given
+limit, when a read fills it completely, and shrinks back to the initial size after
+reads have stopped filling it for a while.
+\param sock     Socket
+\param max_size Maximum read buffer size, 0 to disable autotuning */
+NETWORK_API void
+socket_set_stream_buffer_autotune(socket_t* sock, size_t max_size);
+
+/*! Query the current size of the socket stream read buffer
+\param sock Socket
+\return     Read buffer size in bytes */
+NETWORK_API size_t
+socket_stream_read_buffer_size(const socket_t* sock);
+
+/*! Query the current size of the socket stream write buffer
+\param sock Socket
+\return     Write buffer size in bytes */
+NETWORK_API size_t
+socket_stream_write_buffer_size(const socket_t* sock);
+
+/*! Query the kernel timestamping enabled on the socket
+\param sock Socket
+\return     Combination of socket_timestamp_flag_t flags */
+NETWORK_API unsigned int
+socket_timestamping(const socket_t* sock);
+
+/*! Enable kernel packet timestamps on the socket. Receive timestamps (SO_TIMESTAMPNS,
+SO_TIMESTAMP on BSD/macOS) are returned by #udp_socket_recvfrom_timestamp. Software
+transmit timestamps (SO_TIMESTAMPING, Linux only) are signalled by a NETWORKEVENT_TIMESTAMP
+poll event and read with #socket_transmit_timestamps.
+\param sock  Socket
+\param flags Combination of socket_timestamp_flag_t flags, 0 to disable
+\return      Flags actually enabled */
+NETWORK_API unsigned int
+socket_set_timestamping(socket_t* sock, unsigned int flags);
+
+/*! Read pending software transmit timestamps from the socket. While the socket is registered
+with a poll object the poll drains the kernel error queue and buffers up to
+SOCKET_TIMESTAMP_QUEUE_SIZE timestamps on the socket, later timestamps are dropped until read.
+Otherwise the error queue is read directly, also processing any zero-copy completions.
+\param sock       Socket
+\param timestamps Timestamp array
+\param capacity   Capacity of timestamp array
+\return           Number of timestamps stored */
+NETWORK_API size_t
+socket_transmit_timestamps(socket_t* sock, socket_timestamp_t* timestamps, size_t capacity);
+
+/*! Query if traffic on the socket is recorded by an active capture
+\param sock Socket
+\return     true if capture is enabled for the socket, false if not */
+NETWORK_API bool
+socket_capture(const socket_t* sock);
+
+/*! Mark the socket for traffic capture, see #network_capture_start. Has no cost
+while capture is stopped.
+\param sock    Socket
+\param capture Capture flag */
+NETWORK_API void
+socket_set_capture(socket_t* sock, bool capture);
+
+/*! Query the CPU that last processed an incoming packet for the socket (SO_INCOMING_CPU,
+Linux only). For sockets accepted from a reuse-port group this identifies the core whose
+listener received the connection.
+\param sock Socket
+\return     CPU index, -1 if not available */
+NETWORK_API int
+socket_incoming_cpu(const socket_t* sock);
+
+/*! Query if zero-copy sends are enabled on the socket
+\param sock Socket
+\return     true if enabled, false if not */
+NETWORK_API bool
+socket_zerocopy(const socket_t* sock);
+
+/*! Enable or disable zero-copy sends (SO_ZEROCOPY) on the socket. Only supported on Linux
+\param sock   Socket
+\param enable Enable flag
+\return       true if the requested mode is set, false if not supported */
+NETWORK_API bool
+socket_set_zerocopy(socket_t* sock, bool enable);
+
+/*! Write to the socket without copying the data to the kernel (MSG_ZEROCOPY) if zero-copy
+is enabled and the write is large enough, otherwise identical to #socket_write. The buffer
+must not be modified or released until #socket_zerocopy_released returns true for the
+returned sequence number, which is signalled by a NETWORKEVENT_ZEROCOPY poll event.
+\param sock     Socket
+\param buffer   Data buffer
+\param size     Number of bytes to write
+\param sequence Receives the completion sequence number for the buffer
+\return         Number of bytes written (or queued if the send queue is enabled) */
+NETWORK_API size_t
+socket_write_zerocopy(socket_t* sock, const void* buffer, size_t size, uint32_t* sequence);
+
+/*! Query if the buffer of a zero-copy write has been released by the kernel. While the
+socket is registered with a poll object completions are read by #network_poll, which may run
+on another thread, otherwise pending completion notifications are read from the socket.
+\param sock     Socket
+\param sequence Sequence number from #socket_write_zerocopy
+\return         true if the buffer may be reused, false if still in use */
+NETWORK_API bool
+socket_zerocopy_released(socket_t* sock, uint32_t sequence);
+
+/*! Read from the socket into multiple buffers with a single system call. Buffers
+beyond the first SOCKET_IOVEC_MAX are ignored
+\param sock  Socket
+\param iov   Buffer array
+\param count Number of buffers
+\return      Number of bytes read */
+NETWORK_API size_t
+socket_readv(socket_t* sock, const socket_iovec_t* iov, size_t count);
+
+/*! Write multiple buffers to the socket, gathered in as few system calls as possible.
+Partial writes and errors are handled as in #socket_write
+\param sock  Socket
+\param iov   Buffer array
+\param count Number of buffers
+\return      Number of bytes written (or queued if the send queue is enabled) */
+NETWORK_API size_t
+socket_writev(socket_t* sock, const socket_iovec_t* iov, size_t count);
+
+/*! Send a range of a file to the socket without copying through user space where the
+platform supports it (sendfile), otherwise through a bounded copy buffer. On a non-blocking
+socket the number of bytes actually sent is returned and the caller resumes from that
+offset, unless the send queue is enabled in which case the remainder is queued and sent
+on writable poll events. The queue holds its own duplicate of the file descriptor, so the
+caller may close the file once the call returns.
+\param sock   Socket
+\param fd     File descriptor
+\param offset Offset in file
+\param length Number of bytes to send
+\return       Number of bytes sent (or queued if the send queue is enabled) */
+NETWORK_API size_t
+socket_send_file(socket_t* sock, int fd, size_t offset, size_t length);
+
+/*! Send data read from a stream to the socket. Data read from the stream but not sent
+is rewound so the transfer can be resumed
+\param sock   Socket
+\param stream Source stream
+\param length Maximum number of bytes to send
+\return       Number of bytes sent */
+NETWORK_API size_t
+socket_send_stream(socket_t* sock, stream_t* stream, size_t length);
+
 NETWORK_API stream_t*
 socket_stream(socket_t* sock);
+
+/*! Get a view of buffered input in a socket stream without copying. Refills the
+stream buffer until at least the given number of bytes are buffered, which blocks
+on a blocking socket. The view is contiguous, but may be shorter than requested if
+the socket has no more data or the request exceeds the stream buffer size. On a stream
+with transforms the view covers decoded data. Pass the number of parsed bytes to #socket_stream_consume to release them.
+\param stream    Socket stream
+\param min_bytes Minimum number of bytes wanted in view
+\return          View of buffered input */
+NETWORK_API socket_stream_view_t
+socket_stream_peek(stream_t* stream, size_t min_bytes);
+
+/*! Discard buffered input in a socket stream, typically after parsing data in
+place from a view returned by #socket_stream_peek
+\param stream Socket stream
+\param size   Number of bytes to discard
+\return       Number of bytes discarded */
+NETWORK_API size_t
+socket_stream_consume(stream_t* stream, size_t size);
+
+/*! Make writes to a socket stream never wait for the kernel. Data that does not fit
+the stream buffer when the socket is not writable spills into the socket send queue,
+which is drained when a network poll reports the socket writable. Enables the send
+queue with default watermarks if not already enabled. Disabling removes a queue enabled
+this way once it has drained, as does deallocating the stream. A queue set up with
+#socket_set_send_queue is kept. The
+socket should be in non-blocking mode.
+\param stream      Socket stream
+\param nonblocking Non-blocking write flag */
+NETWORK_API void
+socket_stream_set_nonblocking_write(stream_t* stream, bool nonblocking);
+
+/*! Query number of bytes written to a socket stream but not yet accepted by the kernel,
+buffered in the stream or queued in the socket send queue. Use to apply backpressure
+to producers writing to non-blocking streams.
+\param stream Socket stream
+\return       Number of pending bytes */
+NETWORK_API size_t
+socket_stream_pending_write(stream_t* stream);
+
+/*! Add a transform to the chunk pipeline of a socket stream. Written data is encoded
+through all transforms in order each time the stream is flushed and sent as a single
+chunk, received chunks are decoded in reverse order. Both ends must add the same
+transforms in the same order before any data is transferred. Peek and consume operate
+on the decoded data of a transformed stream.
+\param stream    Socket stream
+\param transform Transform, must remain valid for the lifetime of the stream
+\return          true if added, false if the maximum number of transforms is reached */
+NETWORK_API bool
+socket_stream_add_transform(stream_t* stream, const socket_transform_t* transform);
+
+/*! Set the largest plain chunk size accepted from the peer on a transformed stream.
+Larger chunk headers close the socket before any buffer is grown. The default is the
+write buffer size configured for the socket, which bounds the chunks flushed by a peer
+using the same configuration. Raise it to match a peer with a larger write buffer.
+\param stream Socket stream
+\param limit  Maximum plain chunk size in bytes, 0 for the default */
+NETWORK_API void
+socket_stream_set_chunk_limit(stream_t* stream, size_t limit);
+
+/*! Enable the outbound send queue on the socket. Once enabled, #socket_write never
+blocks or drops data on a full kernel buffer, the unsent tail is queued in chained buffers
+and flushed when a network poll reports the socket writable. The callback is called when
+queued bytes reach the high watermark, and again when the queue drains down to the low
+watermark. A zero high watermark disables the queue and discards any queued data.
+\param sock           Socket
+\param high_watermark High watermark in bytes
+\param low_watermark  Low watermark in bytes
+\param callback       Watermark callback, can be null */
+NETWORK_API void
+socket_set_send_queue(socket_t* sock, size_t high_watermark, size_t low_watermark,
+                      socket_queue_fn callback);
+
+/*! Query number of bytes in the socket send queue
+\param sock Socket
+\return     Number of queued bytes not yet sent */
+NETWORK_API size_t
+socket_send_queue_size(const socket_t* sock);
+
+/*! Send as much of the queued data as the socket will accept without blocking
+\param sock Socket
+\return     Number of bytes remaining in the queue */
+NETWORK_API size_t
+socket_send_queue_flush(socket_t* sock);
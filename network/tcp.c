@@ -71,23 +71,57 @@ tcp_socket_listen(socket_t* sock) {
 		          sock, sockbase->fd, STRING_FORMAT(address));
 #endif
 		sockbase->state = SOCKETSTATE_LISTENING;
+		NETWORK_TRACE(NETWORKTRACE_LISTEN, sock, sockbase->fd, 0, 0);
 		return true;
 	}
 
-#if BUILD_ENABLE_LOG
 	{
-		string_t address = network_address_to_string(buffer, sizeof(buffer), sock->address_local, true);
 		int sockerr = NETWORK_SOCKET_ERROR;
+#if BUILD_ENABLE_LOG
+		string_t address = network_address_to_string(buffer, sizeof(buffer), sock->address_local, true);
 		string_const_t errmsg = system_error_message(sockerr);
 		log_errorf(HASH_NETWORK, ERROR_SYSTEM_CALL_FAIL,
 		           STRING_CONST("Unable to listen on TCP/IP socket (0x%" PRIfixPTR " : %d) %.*s: %.*s (%d)"),
 		           sock, sockbase->fd, STRING_FORMAT(address), STRING_FORMAT(errmsg), sockerr);
-	}
 #endif
+		NETWORK_TRACE(NETWORKTRACE_LISTEN, sock, sockbase->fd, sockerr, 0);
+		FOUNDATION_UNUSED(sockerr);
+	}
 
 	return false;
 }
 
+bool
+tcp_socket_listen_group(socket_t** sockets, size_t count, const network_address_t* address) {
+	size_t isock;
+
+	if (!count || !_socket_bind_group(sockets, count, address))
+		return false;
+
+	//Listeners join the reuse port group in listen order
+	for (isock = 0; isock < count; ++isock) {
+		if (!tcp_socket_listen(sockets[isock])) {
+			for (isock = 0; isock < count; ++isock)
+				socket_close(sockets[isock]);
+			return false;
+		}
+	}
+
+	if (count > 1)
+		_socket_attach_reuseport_cpu(sockets[0], count);
+	return true;
+}
+
+static int
+_tcp_socket_accept_fd(int fd, network_address_ip_t* address_ip, socklen_t* address_len) {
+#if NETWORK_HAVE_SOCKET_TYPE_FLAGS
+	//Accepted sockets start out non-blocking like any newly allocated socket
+	return accept4(fd, &address_ip->saddr, address_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	return (int)accept(fd, &address_ip->saddr, address_len);
+#endif
+}
+
 socket_t*
 tcp_socket_accept(socket_t* sock, unsigned int timeoutms) {
 	socket_base_t* sockbase;
@@ -123,7 +157,7 @@ tcp_socket_accept(socket_t* sock, unsigned int timeoutms) {
 	address_ip = (network_address_ip_t*)address_remote;
 	address_len = address_remote->address_size;
 
-	fd = (int)accept(sockbase->fd, &address_ip->saddr, &address_len);
+	fd = _tcp_socket_accept_fd(sockbase->fd, address_ip, &address_len);
 	if (fd < 0) {
 		err = NETWORK_SOCKET_ERROR;
 		if (timeoutms > 0) {
@@ -148,7 +182,7 @@ tcp_socket_accept(socket_t* sock, unsigned int timeoutms) {
 				ret = select(sockbase->fd + 1, &fdread, 0, &fderr, &tval);
 				if (ret > 0) {
 					address_len = address_remote->address_size;
-					fd = (int)accept(sockbase->fd, &address_ip->saddr, &address_len);
+					fd = _tcp_socket_accept_fd(sockbase->fd, address_ip, &address_len);
 				}
 			}
 		}
@@ -179,9 +213,14 @@ tcp_socket_accept(socket_t* sock, unsigned int timeoutms) {
 	acceptbase = _socket_base + accepted->base;
 	acceptbase->fd = fd;
 	acceptbase->state = SOCKETSTATE_CONNECTED;
+#if !NETWORK_HAVE_SOCKET_TYPE_FLAGS
+	//Match the non-blocking default of the new socket flags
+	socket_set_blocking(accepted, false);
+#endif
 	accepted->address_remote = (network_address_t*)address_remote;
 
 	_socket_store_address_local(accepted, address_ip->family);
+	NETWORK_TRACE(NETWORKTRACE_ACCEPT, accepted, fd, 0, 0);
 
 #if BUILD_ENABLE_LOG
 	{
@@ -229,6 +268,79 @@ tcp_socket_set_delay(socket_t* sock, bool delay) {
 		setsockopt(sockbase->fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(int));
 }
 
+static void
+_tcp_socket_set_cork(socket_base_t* sockbase, bool cork) {
+	int flag;
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	flag = (cork ? 1 : 0);
+	setsockopt(sockbase->fd, IPPROTO_TCP, TCP_CORK, (const char*)&flag, sizeof(int));
+#elif FOUNDATION_PLATFORM_APPLE
+	flag = (cork ? 1 : 0);
+	setsockopt(sockbase->fd, IPPROTO_TCP, TCP_NOPUSH, (const char*)&flag, sizeof(int));
+#else
+	//No cork option, rely on Nagle while batching
+	flag = ((cork || (sockbase->flags & SOCKETFLAG_TCPDELAY)) ? 0 : 1);
+	setsockopt(sockbase->fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(int));
+#endif
+}
+
+bool
+tcp_socket_in_batch(const socket_t* sock) {
+	bool batch = false;
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		batch = ((sockbase->flags & SOCKETFLAG_BATCH) != 0);
+	}
+	return batch;
+}
+
+void
+tcp_socket_begin_batch(socket_t* sock, unsigned int deadline_ms) {
+	socket_base_t* sockbase;
+	if (_socket_allocate_base(sock) < 0)
+		return;
+	sockbase = _socket_base + sock->base;
+	sock->batch_timeout = deadline_ms;
+	if (sockbase->flags & SOCKETFLAG_BATCH)
+		return;
+	sockbase->flags |= SOCKETFLAG_BATCH;
+	sock->batch_flush = 0;
+	_network_poll_batch_disarm(sock);
+	if (sockbase->fd != SOCKET_INVALID)
+		_tcp_socket_set_cork(sockbase, true);
+}
+
+void
+tcp_socket_end_batch(socket_t* sock) {
+	socket_base_t* sockbase;
+	if (sock->base < 0)
+		return;
+	sockbase = _socket_base + sock->base;
+	if (!(sockbase->flags & SOCKETFLAG_BATCH))
+		return;
+	sockbase->flags &= ~SOCKETFLAG_BATCH;
+	sock->batch_flush = 0;
+	_network_poll_batch_disarm(sock);
+	if (sockbase->fd != SOCKET_INVALID)
+		_tcp_socket_set_cork(sockbase, false);
+}
+
+void
+tcp_socket_flush_batch(socket_t* sock) {
+	socket_base_t* sockbase;
+	if (sock->base < 0)
+		return;
+	sockbase = _socket_base + sock->base;
+	if (!(sockbase->flags & SOCKETFLAG_BATCH))
+		return;
+	sock->batch_flush = 0;
+	_network_poll_batch_disarm(sock);
+	if (sockbase->fd != SOCKET_INVALID) {
+		_tcp_socket_set_cork(sockbase, false);
+		_tcp_socket_set_cork(sockbase, true);
+	}
+}
+
 static void
 _tcp_socket_open(socket_t* sock, unsigned int family) {
 	socket_base_t* sockbase;
@@ -238,9 +350,9 @@ _tcp_socket_open(socket_t* sock, unsigned int family) {
 
 	sockbase = _socket_base + sock->base;
 	if (family == NETWORK_ADDRESSFAMILY_IPV6)
-		sockbase->fd = (int)socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+		sockbase->fd = (int)socket(AF_INET6, SOCK_STREAM | SOCKET_TYPE_FLAGS(sockbase), IPPROTO_TCP);
 	else
-		sockbase->fd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockbase->fd = (int)socket(AF_INET, SOCK_STREAM | SOCKET_TYPE_FLAGS(sockbase), IPPROTO_TCP);
 
 	if (sockbase->fd < 0) {
 		int err = NETWORK_SOCKET_ERROR;
@@ -254,6 +366,8 @@ _tcp_socket_open(socket_t* sock, unsigned int family) {
 		log_debugf(HASH_NETWORK, STRING_CONST("Opened TCP/IP socket (0x%" PRIfixPTR " : %d)"),
 		           sock, sockbase->fd);
 		tcp_socket_set_delay(sock, sockbase->flags & SOCKETFLAG_TCPDELAY);
+		if (sockbase->flags & SOCKETFLAG_BATCH)
+			_tcp_socket_set_cork(sockbase, true);
 	}
 }
 
@@ -31,8 +31,45 @@ tcp_socket_accept(socket_t* sock, unsigned int timeoutms);
 NETWORK_API bool
 tcp_socket_listen(socket_t* sock);
 
+/*! Bind a group of TCP sockets to the same address with SO_REUSEPORT and start listening,
+one socket per reactor or core. On Linux a classic BPF program is attached to the group
+steering each connection to the listener at index (receiving CPU modulo count), so pinning
+the reactor owning sockets[i] to CPU i keeps connections on the core that received them.
+Other platforms fall back to the kernel default distribution.
+\param sockets Allocated TCP sockets
+\param count   Number of sockets
+\param address Local address, port 0 binds all sockets to the same ephemeral port
+\return        true if all sockets are listening, false on error with no socket left bound */
+NETWORK_API bool
+tcp_socket_listen_group(socket_t** sockets, size_t count, const network_address_t* address);
+
 NETWORK_API bool
 tcp_socket_delay(socket_t* sock);
 
 NETWORK_API void
 tcp_socket_set_delay(socket_t* sock, bool delay);
+
+/*! Begin a write batch. Writes until #tcp_socket_end_batch are coalesced into full
+segments (TCP_CORK on Linux, TCP_NOPUSH on BSD/macOS, Nagle on Windows) instead of being
+pushed individually. If a deadline is given, pending data is pushed by #network_poll no
+later than the deadline after the first write following a flush.
+\param sock        Socket
+\param deadline_ms Maximum time in milliseconds to hold back written data, 0 for none */
+NETWORK_API void
+tcp_socket_begin_batch(socket_t* sock, unsigned int deadline_ms);
+
+/*! End a write batch and push any pending data
+\param sock Socket */
+NETWORK_API void
+tcp_socket_end_batch(socket_t* sock);
+
+/*! Push any pending data in the current write batch without ending the batch
+\param sock Socket */
+NETWORK_API void
+tcp_socket_flush_batch(socket_t* sock);
+
+/*! Query if the socket is in a write batch
+\param sock Socket
+\return     true if batching, false if not */
+NETWORK_API bool
+tcp_socket_in_batch(const socket_t* sock);
@@ -0,0 +1,262 @@
+/* trace.c  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <network/trace.h>
+#include <network/internal.h>
+#include <network/hashstrings.h>
+
+#include <foundation/foundation.h>
+
+typedef struct network_trace_ring_t network_trace_ring_t;
+
+struct network_trace_ring_t {
+	uint64_t   thread;
+	atomic64_t head;
+	int64_t    tail;
+	//Set when the owning thread exits, the ring is reused once its records are written
+	atomic32_t retired;
+	network_trace_record_t records[NETWORK_TRACE_RING_SIZE];
+};
+
+atomic32_t _network_trace_enabled;
+static atomic32_t _network_trace_generation;
+static mutex_t* _network_trace_lock;
+static network_trace_ring_t** _network_trace_rings;
+static network_trace_ring_t** _network_trace_free;
+static network_thread_key_t _network_trace_key;
+static bool _network_trace_key_valid;
+static tick_t _network_trace_tick_base;
+static tick_t _network_trace_time_base;
+
+FOUNDATION_DECLARE_THREAD_LOCAL(network_trace_ring_t*, trace_ring, 0)
+FOUNDATION_DECLARE_THREAD_LOCAL(int32_t, trace_generation, 0)
+
+static const char* _network_trace_event_name[] = {
+	"unknown",
+	"open",
+	"bind",
+	"connect",
+	"listen",
+	"accept",
+	"read",
+	"write",
+	"close"
+};
+
+static void NETWORK_THREAD_EXIT_CALL
+_network_trace_thread_exit(void* arg) {
+	network_trace_ring_t* ring = arg;
+	if (_network_trace_key_valid)
+		atomic_store32(&ring->retired, 1);
+}
+
+int
+network_trace_module_initialize(void) {
+	_network_trace_lock = mutex_allocate(STRING_CONST("network_trace"));
+	_network_trace_key_valid = _network_thread_key_allocate(&_network_trace_key, _network_trace_thread_exit);
+	_network_trace_tick_base = time_current();
+	_network_trace_time_base = time_system();
+	//Invalidate rings cached by threads from a previous initialization
+	atomic_incr32(&_network_trace_generation);
+	return 0;
+}
+
+void
+network_trace_module_finalize(void) {
+	size_t iring, rsize;
+
+	atomic_store32(&_network_trace_enabled, 0);
+	if (_network_trace_key_valid) {
+		_network_trace_key_valid = false;
+		_network_thread_key_deallocate(_network_trace_key);
+	}
+	for (iring = 0, rsize = array_size(_network_trace_rings); iring < rsize; ++iring)
+		memory_deallocate(_network_trace_rings[iring]);
+	array_deallocate(_network_trace_rings);
+	for (iring = 0, rsize = array_size(_network_trace_free); iring < rsize; ++iring)
+		memory_deallocate(_network_trace_free[iring]);
+	array_deallocate(_network_trace_free);
+
+	mutex_deallocate(_network_trace_lock);
+	_network_trace_lock = 0;
+}
+
+static network_trace_ring_t*
+_network_trace_thread_ring(void) {
+	network_trace_ring_t* ring = get_thread_trace_ring();
+	int32_t generation = atomic_load32(&_network_trace_generation);
+	if (!ring || (get_thread_trace_generation() != generation)) {
+		//Reuse a ring retired by an exited thread once its records were written
+		ring = 0;
+		mutex_lock(_network_trace_lock);
+		if (array_size(_network_trace_free)) {
+			ring = _network_trace_free[array_size(_network_trace_free) - 1];
+			array_pop(_network_trace_free);
+		}
+		mutex_unlock(_network_trace_lock);
+		if (ring) {
+			atomic_store64(&ring->head, 0);
+			ring->tail = 0;
+			atomic_store32(&ring->retired, 0);
+		}
+		else {
+			ring = memory_allocate(HASH_NETWORK, sizeof(network_trace_ring_t), 0,
+			                       MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		}
+		ring->thread = thread_id();
+		mutex_lock(_network_trace_lock);
+		array_push(_network_trace_rings, ring);
+		mutex_unlock(_network_trace_lock);
+		if (_network_trace_key_valid)
+			_network_thread_key_set(_network_trace_key, ring);
+		set_thread_trace_ring(ring);
+		set_thread_trace_generation(generation);
+	}
+	return ring;
+}
+
+void
+_network_trace(network_trace_event_t event, const socket_t* sock, int fd, int error, size_t bytes) {
+	network_trace_ring_t* ring;
+	network_trace_record_t* record;
+	int64_t head;
+
+	if (!_network_trace_lock)
+		return;
+
+	//Only the owning thread writes to the ring, readers detect overwritten records from the head
+	ring = _network_trace_thread_ring();
+	head = atomic_load64(&ring->head);
+	record = ring->records + (head & (NETWORK_TRACE_RING_SIZE - 1));
+	record->time = time_current();
+	record->sock = (uint64_t)(uintptr_t)sock;
+	record->bytes = bytes;
+	record->event = (uint16_t)event;
+	record->error = (uint16_t)error;
+	record->fd = fd;
+	atomic_thread_fence_release();
+	atomic_store64(&ring->head, head + 1);
+}
+
+void
+network_trace_enable(bool enable) {
+	if (enable && !atomic_load32(&_network_trace_enabled)) {
+		_network_trace_tick_base = time_current();
+		_network_trace_time_base = time_system();
+	}
+	atomic_store32(&_network_trace_enabled, (BUILD_ENABLE_NETWORK_TRACE && enable) ? 1 : 0);
+}
+
+bool
+network_trace_is_enabled(void) {
+	return atomic_load32(&_network_trace_enabled) != 0;
+}
+
+//Move drained rings of exited threads to the free list, called with the lock held
+static void
+_network_trace_recycle(void) {
+	size_t iring = 0;
+	while (iring < array_size(_network_trace_rings)) {
+		network_trace_ring_t* ring = _network_trace_rings[iring];
+		if (atomic_load32(&ring->retired) && (ring->tail == atomic_load64(&ring->head))) {
+			array_push(_network_trace_free, ring);
+			array_erase(_network_trace_rings, iring);
+		}
+		else {
+			++iring;
+		}
+	}
+}
+
+size_t
+network_trace_write(stream_t* stream) {
+	network_trace_header_t header;
+	network_trace_record_t* records;
+	size_t total = 0;
+	size_t iring, rsize;
+
+	if (!_network_trace_lock)
+		return 0;
+
+	records = memory_allocate(HASH_NETWORK, sizeof(network_trace_record_t) * NETWORK_TRACE_RING_SIZE, 0,
+	                          MEMORY_TEMPORARY);
+
+	mutex_lock(_network_trace_lock);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = NETWORK_TRACE_MAGIC;
+	header.version = NETWORK_TRACE_VERSION;
+	header.threads = array_size(_network_trace_rings);
+	header.ticks_per_second = time_ticks_per_second();
+	header.tick_base = _network_trace_tick_base;
+	header.time_base = _network_trace_time_base;
+	stream_write(stream, &header, sizeof(header));
+
+	for (iring = 0, rsize = array_size(_network_trace_rings); iring < rsize; ++iring) {
+		network_trace_ring_t* ring = _network_trace_rings[iring];
+		//A ring retired before its head is read holds the final records of its thread
+		bool retired = atomic_load32(&ring->retired) != 0;
+		int64_t head = atomic_load64(&ring->head);
+		int64_t first = (head > NETWORK_TRACE_RING_SIZE) ? head - NETWORK_TRACE_RING_SIZE : 0;
+		int64_t end, irec;
+		uint64_t block[2];
+
+		if (first < ring->tail)
+			first = ring->tail;
+		atomic_thread_fence_acquire();
+		for (irec = first; irec < head; ++irec)
+			records[irec - first] = ring->records[irec & (NETWORK_TRACE_RING_SIZE - 1)];
+
+		//Skip records the owning thread overwrote or started overwriting during the copy
+		end = atomic_load64(&ring->head) + 1 - NETWORK_TRACE_RING_SIZE;
+		if (end > head)
+			end = head;
+		if (end < first)
+			end = first;
+
+		block[0] = ring->thread;
+		block[1] = (uint64_t)(head - end);
+		stream_write(stream, block, sizeof(block));
+		stream_write(stream, records + (end - first), sizeof(network_trace_record_t) * (size_t)(head - end));
+		total += (size_t)(head - end);
+		if (retired)
+			ring->tail = head;
+	}
+
+	_network_trace_recycle();
+	mutex_unlock(_network_trace_lock);
+
+	memory_deallocate(records);
+
+	return total;
+}
+
+void
+network_trace_clear(void) {
+	size_t iring, rsize;
+
+	if (!_network_trace_lock)
+		return;
+
+	mutex_lock(_network_trace_lock);
+	for (iring = 0, rsize = array_size(_network_trace_rings); iring < rsize; ++iring)
+		_network_trace_rings[iring]->tail = atomic_load64(&_network_trace_rings[iring]->head);
+	_network_trace_recycle();
+	mutex_unlock(_network_trace_lock);
+}
+
+string_const_t
+network_trace_event_name(network_trace_event_t event) {
+	const char* name = _network_trace_event_name[0];
+	if ((event > 0) && (event <= NETWORKTRACE_CLOSE))
+		name = _network_trace_event_name[event];
+	return string_const(name, string_length(name));
+}
@@ -0,0 +1,49 @@
+/* trace.h  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#pragma once
+
+/*! \file trace.h
+    Binary event trace of socket lifecycle and I/O */
+
+#include <foundation/platform.h>
+
+#include <network/types.h>
+
+/*! Enable or disable recording of trace events. Events are stored as fixed size
+binary records in a ring buffer per thread, the oldest records are overwritten
+when a ring is full. Requires BUILD_ENABLE_NETWORK_TRACE.
+\param enable Enable flag */
+NETWORK_API void
+network_trace_enable(bool enable);
+
+/*! Query if trace events are recorded
+\return true if enabled, false if not */
+NETWORK_API bool
+network_trace_is_enabled(void);
+
+/*! Write the contents of all thread trace rings to a stream in the binary trace
+format read by the tracedump tool. Rings of exited threads are written once and then
+reused by new threads
+\param stream Destination stream
+\return       Number of records written */
+NETWORK_API size_t
+network_trace_write(stream_t* stream);
+
+/*! Discard all recorded trace events */
+NETWORK_API void
+network_trace_clear(void);
+
+/*! Get name of a trace event
+\param event Event identifier
+\return      Event name */
+NETWORK_API string_const_t
+network_trace_event_name(network_trace_event_t event);
@@ -0,0 +1,308 @@
+/* transform.c  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <network/transform.h>
+#include <network/internal.h>
+#include <network/hashstrings.h>
+
+#include <foundation/foundation.h>
+
+#if defined(__SSE4_2__)
+#  include <nmmintrin.h>
+#endif
+
+#define NETWORK_LZ_HASH_BITS  12
+#define NETWORK_LZ_MIN_MATCH  4
+#define NETWORK_LZ_MAX_OFFSET 65535
+
+#if !defined(__SSE4_2__)
+
+static const uint32_t _network_crc32c_table[256] = {
+	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+	0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+	0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+	0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+	0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+	0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+	0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+	0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+	0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+	0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+	0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+	0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+	0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+	0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+	0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+	0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+	0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+	0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+	0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+	0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+	0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+	0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+	0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+	0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+	0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+	0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+	0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+	0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+	0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+	0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+	0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+	0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+	0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+	0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+	0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+	0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+	0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+	0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+	0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+	0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+	0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+	0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+#endif
+
+uint32_t
+network_crc32c(uint32_t crc, const void* data, size_t size) {
+	const uint8_t* bytes = data;
+	crc = ~crc;
+#if defined(__SSE4_2__)
+	while (size >= 8) {
+		uint64_t value;
+		memcpy(&value, bytes, sizeof(value));
+		crc = (uint32_t)_mm_crc32_u64(crc, value);
+		bytes += 8;
+		size -= 8;
+	}
+	while (size--)
+		crc = _mm_crc32_u8(crc, *bytes++);
+#else
+	while (size--)
+		crc = _network_crc32c_table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+#endif
+	return ~crc;
+}
+
+static size_t
+_network_crc32c_encode(const socket_transform_t* transform, const void* input, size_t size,
+                       void* output, size_t capacity) {
+	uint32_t crc;
+	uint8_t* trailer;
+	FOUNDATION_UNUSED(transform);
+	if (capacity < size + 4)
+		return 0;
+	crc = network_crc32c(0, input, size);
+	memcpy(output, input, size);
+	trailer = pointer_offset(output, size);
+	trailer[0] = (uint8_t)crc;
+	trailer[1] = (uint8_t)(crc >> 8);
+	trailer[2] = (uint8_t)(crc >> 16);
+	trailer[3] = (uint8_t)(crc >> 24);
+	return size + 4;
+}
+
+static size_t
+_network_crc32c_decode(const socket_transform_t* transform, const void* input, size_t size,
+                       void* output, size_t capacity) {
+	const uint8_t* trailer;
+	uint32_t crc;
+	FOUNDATION_UNUSED(transform);
+	if ((size <= 4) || (capacity < size - 4))
+		return 0;
+	size -= 4;
+	trailer = pointer_offset_const(input, size);
+	crc = (uint32_t)trailer[0] | ((uint32_t)trailer[1] << 8) | ((uint32_t)trailer[2] << 16) |
+	      ((uint32_t)trailer[3] << 24);
+	if (network_crc32c(0, input, size) != crc)
+		return 0;
+	memcpy(output, input, size);
+	return size;
+}
+
+static size_t
+_network_crc32c_bound(const socket_transform_t* transform, size_t size) {
+	FOUNDATION_UNUSED(transform);
+	return size + 4;
+}
+
+static uint8_t*
+_network_lz_length(uint8_t* op, size_t length) {
+	while (length >= 255) {
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+//Emit a sequence of literals followed by a match, match length 0 for the final literals
+static uint8_t*
+_network_lz_sequence(uint8_t* op, const uint8_t* op_end, const uint8_t* literals, size_t literal_length,
+                     size_t offset, size_t match_length) {
+	size_t match = match_length ? match_length - NETWORK_LZ_MIN_MATCH : 0;
+	uint8_t* token = op;
+
+	if ((size_t)(op_end - op) < 1 + (literal_length / 255) + 1 + literal_length + 2 + (match / 255) + 1)
+		return 0;
+
+	*op++ = (uint8_t)(((literal_length < 15) ? literal_length : 15) << 4);
+	if (literal_length >= 15)
+		op = _network_lz_length(op, literal_length - 15);
+	memcpy(op, literals, literal_length);
+	op += literal_length;
+
+	if (match_length) {
+		*token |= (uint8_t)((match < 15) ? match : 15);
+		*op++ = (uint8_t)offset;
+		*op++ = (uint8_t)(offset >> 8);
+		if (match >= 15)
+			op = _network_lz_length(op, match - 15);
+	}
+	return op;
+}
+
+static size_t
+_network_lz_encode(const socket_transform_t* transform, const void* input, size_t size,
+                   void* output, size_t capacity) {
+	uint32_t table[1 << NETWORK_LZ_HASH_BITS];
+	const uint8_t* in = input;
+	const uint8_t* anchor = in;
+	const uint8_t* ip = in;
+	const uint8_t* in_end = in + size;
+	uint8_t* op = output;
+	uint8_t* op_end = op + capacity;
+
+	FOUNDATION_UNUSED(transform);
+	memset(table, 0, sizeof(table));
+
+	//Table holds position + 1 of the last occurrence of each hashed 4 byte sequence
+	while (ip + NETWORK_LZ_MIN_MATCH <= in_end) {
+		uint32_t sequence, candidate;
+		unsigned int hash;
+		const uint8_t* ref = 0;
+
+		memcpy(&sequence, ip, sizeof(sequence));
+		hash = (sequence * 2654435761U) >> (32 - NETWORK_LZ_HASH_BITS);
+		candidate = table[hash];
+		table[hash] = (uint32_t)(ip - in) + 1;
+
+		if (candidate && ((size_t)(ip - in) - (candidate - 1) <= NETWORK_LZ_MAX_OFFSET))
+			ref = in + (candidate - 1);
+		if (ref && !memcmp(ref, ip, NETWORK_LZ_MIN_MATCH)) {
+			size_t length = NETWORK_LZ_MIN_MATCH;
+			while ((ip + length < in_end) && (ref[length] == ip[length]))
+				++length;
+			op = _network_lz_sequence(op, op_end, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), length);
+			if (!op)
+				return 0;
+			ip += length;
+			anchor = ip;
+		}
+		else {
+			//Skip faster through incompressible data
+			ip += 1 + ((size_t)(ip - anchor) >> 6);
+		}
+	}
+
+	op = _network_lz_sequence(op, op_end, anchor, (size_t)(in_end - anchor), 0, 0);
+	return op ? (size_t)(op - (uint8_t*)output) : 0;
+}
+
+static bool
+_network_lz_read_length(const uint8_t** ip, const uint8_t* in_end, size_t* length) {
+	uint8_t byte;
+	do {
+		if (*ip >= in_end)
+			return false;
+		byte = *(*ip)++;
+		*length += byte;
+	}
+	while (byte == 255);
+	return true;
+}
+
+static size_t
+_network_lz_decode(const socket_transform_t* transform, const void* input, size_t size,
+                   void* output, size_t capacity) {
+	const uint8_t* ip = input;
+	const uint8_t* in_end = ip + size;
+	uint8_t* out = output;
+	uint8_t* op = out;
+	uint8_t* op_end = out + capacity;
+
+	FOUNDATION_UNUSED(transform);
+
+	while (ip < in_end) {
+		uint8_t token = *ip++;
+		size_t length = token >> 4;
+		size_t offset;
+		const uint8_t* ref;
+
+		if ((length == 15) && !_network_lz_read_length(&ip, in_end, &length))
+			return 0;
+		if (((size_t)(in_end - ip) < length) || ((size_t)(op_end - op) < length))
+			return 0;
+		memcpy(op, ip, length);
+		ip += length;
+		op += length;
+
+		if (ip == in_end)
+			break;
+
+		if (in_end - ip < 2)
+			return 0;
+		offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (!offset || (offset > (size_t)(op - out)))
+			return 0;
+
+		length = token & 0x0F;
+		if ((length == 15) && !_network_lz_read_length(&ip, in_end, &length))
+			return 0;
+		length += NETWORK_LZ_MIN_MATCH;
+		if ((size_t)(op_end - op) < length)
+			return 0;
+
+		//Byte copy, source may overlap destination for repeating patterns
+		ref = op - offset;
+		while (length--)
+			*op++ = *ref++;
+	}
+
+	return (size_t)(op - out);
+}
+
+static size_t
+_network_lz_bound(const socket_transform_t* transform, size_t size) {
+	FOUNDATION_UNUSED(transform);
+	return size + (size / 255) + 16;
+}
+
+static const socket_transform_t _network_transform_lz = {
+	_network_lz_encode, _network_lz_decode, _network_lz_bound, 0
+};
+
+static const socket_transform_t _network_transform_crc32c = {
+	_network_crc32c_encode, _network_crc32c_decode, _network_crc32c_bound, 0
+};
+
+const socket_transform_t*
+socket_transform_lz(void) {
+	return &_network_transform_lz;
+}
+
+const socket_transform_t*
+socket_transform_crc32c(void) {
+	return &_network_transform_crc32c;
+}
@@ -0,0 +1,38 @@
+/* transform.h  -  Network library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#pragma once
+
+/*! \file transform.h
+    Built-in socket stream transforms */
+
+#include <foundation/platform.h>
+
+#include <network/types.h>
+
+/*! Get the built-in LZ compression transform, a fast byte oriented LZ77 variant
+\return Transform */
+NETWORK_API const socket_transform_t*
+socket_transform_lz(void);
+
+/*! Get the built-in CRC32C checksum transform, appending a checksum to each chunk
+and rejecting chunks that fail verification on receive
+\return Transform */
+NETWORK_API const socket_transform_t*
+socket_transform_crc32c(void);
+
+/*! Compute CRC32C (Castagnoli) checksum, using the SSE4.2 instruction when available
+\param crc  Previous checksum, 0 for first block
+\param data Data
+\param size Size of data
+\return     Updated checksum */
+NETWORK_API uint32_t
+network_crc32c(uint32_t crc, const void* data, size_t size);
@@ -58,9 +58,41 @@ typedef enum {
 	NETWORKEVENT_CONNECTED,
 	NETWORKEVENT_DATAIN,
 	NETWORKEVENT_ERROR,
-	NETWORKEVENT_HANGUP
+	NETWORKEVENT_HANGUP,
+	NETWORKEVENT_ZEROCOPY,
+	NETWORKEVENT_TIMESTAMP
 } network_event_id;
 
+typedef enum {
+	SOCKETQUEUE_HIGH_WATERMARK = 1,
+	SOCKETQUEUE_LOW_WATERMARK
+} socket_queue_event_t;
+
+typedef enum {
+	SOCKETTIMESTAMP_RECEIVE        = 0x01,
+	SOCKETTIMESTAMP_TRANSMIT       = 0x02
+} socket_timestamp_flag_t;
+
+typedef enum {
+	NETWORKCAPTURE_ALL_SOCKETS     = 0x01
+} network_capture_flag_t;
+
+typedef enum {
+	NETWORKTRACE_OPEN = 1,
+	NETWORKTRACE_BIND,
+	NETWORKTRACE_CONNECT,
+	NETWORKTRACE_LISTEN,
+	NETWORKTRACE_ACCEPT,
+	NETWORKTRACE_READ,
+	NETWORKTRACE_WRITE,
+	NETWORKTRACE_CLOSE
+} network_trace_event_t;
+
+typedef enum {
+	SOCKETFRAME_PREFIX_FIXED32 = 0,
+	SOCKETFRAME_PREFIX_VARINT
+} socket_frame_prefix_t;
+
 #if FOUNDATION_PLATFORM_POSIX
 typedef socklen_t network_address_size_t;
 #else
@@ -74,9 +106,25 @@ typedef struct network_poll_event_t  network_poll_event_t;
 typedef struct network_poll_t        network_poll_t;
 typedef struct socket_t              socket_t;
 typedef struct socket_stream_t       socket_stream_t;
+typedef struct socket_buffer_t       socket_buffer_t;
+typedef struct socket_queue_t        socket_queue_t;
+typedef struct socket_iovec_t        socket_iovec_t;
+typedef struct socket_stream_view_t  socket_stream_view_t;
+typedef struct socket_frame_t        socket_frame_t;
+typedef struct socket_framer_t       socket_framer_t;
+typedef struct socket_transform_t    socket_transform_t;
+typedef struct udp_datagram_t        udp_datagram_t;
+typedef struct network_address_storage_t network_address_storage_t;
+typedef struct socket_timestamp_t    socket_timestamp_t;
+typedef struct network_trace_record_t network_trace_record_t;
+typedef struct network_trace_header_t network_trace_header_t;
+typedef struct network_buffer_pool_usage_t network_buffer_pool_usage_t;
 
 typedef void (*socket_open_fn)(socket_t*, unsigned int);
 typedef void (*socket_stream_initialize_fn)(socket_t*, stream_t*);
+typedef void (*socket_queue_fn)(socket_t*, socket_queue_event_t, size_t);
+typedef size_t (*socket_transform_fn)(const socket_transform_t*, const void*, size_t, void*, size_t);
+typedef size_t (*socket_transform_bound_fn)(const socket_transform_t*, size_t);
 
 struct network_config_t {
 	size_t max_sockets;
@@ -84,6 +132,14 @@ struct network_config_t {
 	size_t max_udp_packet_size;
 	size_t stream_write_buffer_size;
 	size_t stream_read_buffer_size;
+	/*! Default maximum size of autotuned stream read buffers, 0 to disable autotuning */
+	size_t stream_read_buffer_max;
+	/*! Maximum number of bytes of idle stream buffers cached in the shared pool, 0 for default */
+	size_t stream_buffer_pool_size;
+	/*! Default kernel send buffer size for new sockets, 0 for system default */
+	size_t socket_send_buffer_size;
+	/*! Default kernel receive buffer size for new sockets, 0 for system default */
+	size_t socket_receive_buffer_size;
 };
 
 #define NETWORK_DECLARE_NETWORK_ADDRESS    \
@@ -94,23 +150,219 @@ struct network_address_t {
 	NETWORK_DECLARE_NETWORK_ADDRESS;
 };
 
+/*! Caller owned storage large enough for an address of any supported family. A filled
+storage can be passed as a network_address_t pointer to all address functions */
+struct network_address_storage_t {
+	NETWORK_DECLARE_NETWORK_ADDRESS;
+	uint64_t storage[4];
+};
+
+/*! Maximum number of transforms stacked on a socket stream */
+#define SOCKET_STREAM_TRANSFORM_MAX 4
+
+/*! Maximum number of buffers passed to a single scatter/gather call */
+#define SOCKET_IOVEC_MAX 64
+
+/*! Scatter/gather buffer, layout compatible with WSABUF on Windows and
+struct iovec on POSIX platforms */
+struct socket_iovec_t {
+#if FOUNDATION_PLATFORM_WINDOWS
+	unsigned long length;
+	void*         buffer;
+#else
+	void*         buffer;
+	size_t        length;
+#endif
+};
+
+/*! Maximum number of datagrams transferred by a single batched UDP call */
+#define UDP_DATAGRAM_BATCH_MAX 64
+
+/*! Datagram in a batched UDP receive or send */
+struct udp_datagram_t {
+	//Datagram buffer
+	void* buffer;
+	//Capacity of buffer, receive only
+	size_t capacity;
+	//Size of received datagram, or size of datagram to send
+	size_t size;
+	//Source address of received datagram, or destination address of datagram to send
+	const network_address_t* address;
+};
+
+/*! Chunk transform applied to socket stream data. Encode and decode take an input
+buffer and size and an output buffer and capacity, and return the output size or
+0 on failure. Bound returns the maximum encoded size of an input of the given size. */
+struct socket_transform_t {
+	socket_transform_fn       encode;
+	socket_transform_fn       decode;
+	socket_transform_bound_fn bound;
+	void*                     data;
+};
+
+/*! Complete message delivered by a socket framer */
+struct socket_frame_t {
+	const void* data;
+	size_t      size;
+};
+
+/*! Length prefixed message framing over a socket stream */
+struct socket_framer_t {
+	socket_t* sock;
+	stream_t* stream;
+	socket_frame_prefix_t prefix;
+	size_t max_size;
+	//Bytes of the previously delivered frame to release from the stream
+	size_t consume;
+	//Frames larger than the stream buffer are assembled in scratch memory
+	size_t assemble_size;
+	size_t assembled;
+	size_t scratch_size;
+	uint8_t* scratch;
+	//Rest of a started frame the socket and stream buffer could not take yet
+	size_t tail_size;
+	size_t tail_capacity;
+	uint8_t* tail;
+};
+
+/*! Memory usage of the shared stream buffer pool */
+struct network_buffer_pool_usage_t {
+	/*! Total bytes allocated by the pool, in use and cached */
+	size_t allocated;
+	/*! Bytes currently borrowed by socket streams */
+	size_t in_use;
+	/*! Bytes of idle buffers cached for reuse */
+	size_t cached;
+	/*! Number of buffers currently borrowed by socket streams */
+	size_t buffers;
+};
+
+/*! View of buffered data in a socket stream, valid until the stream is
+read, consumed or refilled */
+struct socket_stream_view_t {
+	const void* buffer;
+	size_t      length;
+};
+
+/*! Binary trace record */
+struct network_trace_record_t {
+	/*! Timestamp in ticks */
+	tick_t   time;
+	/*! Socket handle */
+	uint64_t sock;
+	/*! Number of bytes transferred */
+	uint64_t bytes;
+	/*! Event identifier, network_trace_event_t */
+	uint16_t event;
+	/*! System error code, 0 if successful */
+	uint16_t error;
+	/*! Socket file descriptor */
+	int32_t  fd;
+};
+
+/*! Binary trace file header, followed by a block per thread of a 64-bit thread id,
+a 64-bit record count and the records */
+struct network_trace_header_t {
+	/*! Magic identifier, NETWORK_TRACE_MAGIC in writer byte order */
+	uint32_t magic;
+	/*! Format version */
+	uint32_t version;
+	/*! Number of thread blocks */
+	uint64_t threads;
+	/*! Tick frequency */
+	tick_t   ticks_per_second;
+	/*! Tick at which tracing was enabled */
+	tick_t   tick_base;
+	/*! System time in milliseconds at which tracing was enabled */
+	tick_t   time_base;
+};
+
+/*! Binary trace file magic identifier */
+#define NETWORK_TRACE_MAGIC 0x4352544e
+
+/*! Binary trace file format version */
+#define NETWORK_TRACE_VERSION 1
+
+/*! Kernel packet timestamp */
+struct socket_timestamp_t {
+	/*! Send identifier, datagram counter for UDP and byte offset for TCP */
+	uint32_t id;
+	/*! Time in nanoseconds since the Unix epoch (system realtime clock) */
+	uint64_t time;
+};
+
 struct network_poll_slot_t {
 	socket_t*  sock;
 	int        base;
 	int        fd;
+	uint32_t   events;
 };
 
 FOUNDATION_ALIGNED_STRUCT(socket_stream_t, 8) {
 	FOUNDATION_DECLARE_STREAM;
 	socket_t* socket;
 
-	size_t read_in;
-	size_t write_in;
-	size_t write_out;
+	//Both buffers are rings, offset is position of first pending byte and used is pending size
+	size_t offset_in;
+	size_t used_in;
+	size_t size_in;
+	size_t offset_out;
+	size_t used_out;
+	size_t size_out;
+
+	//Last time a read filled the input ring, used to shrink autotuned buffers when idle
+	tick_t last_full;
+
+	//Overflowing writes go to the socket send queue instead of waiting on the kernel
+	bool nonblocking_write;
+	//Send queue installed for non-blocking writes, removed once drained after they are disabled
+	socket_queue_t* write_queue;
+	bool write_queue_release;
+
+	//Transforms applied in order to each flushed chunk, and in reverse on receive
+	const socket_transform_t* transforms[SOCKET_STREAM_TRANSFORM_MAX];
+	unsigned int transform_count;
+	//Encoded chunk not yet accepted by the socket
+	uint8_t* chunk_out;
+	size_t chunk_out_capacity;
+	size_t chunk_out_offset;
+	size_t chunk_out_size;
+	//Decoded chunk not yet read
+	uint8_t* chunk_in;
+	size_t chunk_in_capacity;
+	size_t chunk_in_offset;
+	size_t chunk_in_size;
+	uint8_t* chunk_scratch;
+	size_t chunk_scratch_capacity;
+	//Largest plain chunk accepted from the peer, 0 for the socket write buffer size
+	size_t chunk_limit;
+	//Read buffer size to restore once a chunk larger than the read buffer is consumed
+	size_t chunk_restore_in;
 
 	uint8_t* buffer_in;
 	uint8_t* buffer_out;
-	uint8_t  buffers[FOUNDATION_FLEXIBLE_ARRAY];
+};
+
+struct socket_buffer_t {
+	socket_buffer_t* next;
+	int fd;
+	size_t offset;
+	size_t size;
+	size_t capacity;
+	uint8_t data[FOUNDATION_FLEXIBLE_ARRAY];
+};
+
+struct socket_queue_t {
+	mutex_t* lock;
+	socket_buffer_t* head;
+	socket_buffer_t* tail;
+	size_t queued;
+	size_t high_watermark;
+	size_t low_watermark;
+	bool above_high_watermark;
+	//Remove the queue from the socket once drained, set when the owning stream goes away
+	bool release_drained;
+	socket_queue_fn callback;
 };
 
 struct socket_t {
@@ -119,15 +371,53 @@ struct socket_t {
 
 	network_address_t* address_local;
 	network_address_t* address_remote;
+	//Source address slots for batched datagram receive
+	network_address_t* address_batch;
+	//Coalesced datagrams from receive offload not yet delivered
+	uint8_t* coalesce_buffer;
+	size_t coalesce_offset;
+	size_t coalesce_size;
+	size_t coalesce_segment;
+	network_address_storage_t coalesce_address;
+	uint64_t coalesce_timestamp;
 
 	size_t bytes_read;
 	size_t bytes_written;
 
+	uint32_t zerocopy_sent;
+	//Written by the error queue reader, read by the sending thread
+	atomic32_t zerocopy_completed;
+
+	//Transmit timestamps drained from the error queue, single producer ring read by
+	//socket_transmit_timestamps
+	socket_timestamp_t* timestamp_queue;
+	atomic32_t timestamp_head;
+	atomic32_t timestamp_tail;
+
+	unsigned int batch_timeout;
+	tick_t batch_flush;
+
+	size_t send_buffer_size;
+	size_t receive_buffer_size;
+	size_t receive_buffer_max;
+	uint32_t receive_dropped;
+
+	size_t stream_read_buffer_size;
+	size_t stream_write_buffer_size;
+	size_t stream_read_buffer_max;
+
 	socket_open_fn open_fn;
 	socket_stream_initialize_fn stream_initialize_fn;
 
 	socket_stream_t* stream;
+	socket_queue_t* queue;
 	void* client;
+
+	//Poll object and slot the socket is registered in, for interest updates on queue changes
+	network_poll_t* poll;
+	size_t poll_slot;
+	//Index in the poll list of armed batch deadlines, -1 if not armed
+	int poll_batch;
 };
 
 struct network_poll_t {
@@ -140,6 +430,11 @@ struct network_poll_t {
 #elif FOUNDATION_PLATFORM_APPLE
 	struct pollfd* pollfds;
 #endif
+	//Guards slot interest and slot layout against updates from threads writing to sockets
+	mutex_t* lock;
+	//Sockets with an armed batch flush deadline
+	socket_t** batch;
+	size_t num_batch;
 	network_poll_slot_t slots[FOUNDATION_FLEXIBLE_ARRAY];
 };
 
@@ -24,6 +24,19 @@ _udp_socket_connect(socket_t*, const network_address_t*, unsigned int);
 static void
 _udp_stream_initialize(socket_t*, stream_t*);
 
+static size_t
+_udp_socket_recvfrom(socket_t*, void*, size_t, network_address_t const**, uint64_t*,
+                     network_address_storage_t*);
+
+static size_t
+_udp_socket_recvfrom_batch(socket_t*, udp_datagram_t*, network_address_storage_t*, size_t);
+
+static void
+_udp_socket_recvfrom_failed(socket_t*, socket_base_t*);
+
+static network_address_ip_t*
+_udp_socket_source_address(socket_t*, network_address_storage_t*, size_t);
+
 socket_t*
 udp_socket_allocate(void) {
 	socket_t* sock = memory_allocate(HASH_NETWORK, sizeof(socket_t), 0,
@@ -40,6 +53,57 @@ udp_socket_initialize(socket_t* sock) {
 	sock->stream_initialize_fn = _udp_stream_initialize;
 }
 
+bool
+udp_socket_bind_group(socket_t** sockets, size_t count, const network_address_t* address) {
+	if (!count || !_socket_bind_group(sockets, count, address))
+		return false;
+
+	if (count > 1)
+		_socket_attach_reuseport_cpu(sockets[0], count);
+	return true;
+}
+
+bool
+udp_socket_receive_offload(const socket_t* sock) {
+	bool offload = false;
+	if (sock->base >= 0) {
+		socket_base_t* sockbase = _socket_base + sock->base;
+		offload = ((sockbase->flags & SOCKETFLAG_RECEIVE_OFFLOAD) != 0);
+	}
+	return offload;
+}
+
+bool
+udp_socket_set_receive_offload(socket_t* sock, bool enable) {
+	socket_base_t* sockbase;
+
+	if (_socket_allocate_base(sock) < 0)
+		return false;
+
+	sockbase = _socket_base + sock->base;
+#if NETWORK_HAVE_UDP_SEGMENT
+	if (sockbase->fd != SOCKET_INVALID) {
+		int optval = enable ? 1 : 0;
+		int ret = setsockopt(sockbase->fd, IPPROTO_UDP, UDP_GRO, &optval, sizeof(optval));
+		if (ret < 0) {
+			const int sockerr = NETWORK_SOCKET_ERROR;
+			const string_const_t errmsg = system_error_message(sockerr);
+			log_warnf(HASH_NETWORK, WARNING_SYSTEM_CALL_FAIL,
+			          STRING_CONST("Unable to set receive offload on UDP socket (0x%" PRIfixPTR " : %d): %.*s (%d)"),
+			          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr);
+			sockbase->flags &= ~SOCKETFLAG_RECEIVE_OFFLOAD;
+			return !enable;
+		}
+	}
+	sockbase->flags = (enable ? sockbase->flags | SOCKETFLAG_RECEIVE_OFFLOAD : sockbase->flags &
+	                   ~SOCKETFLAG_RECEIVE_OFFLOAD);
+	return true;
+#else
+	sockbase->flags &= ~SOCKETFLAG_RECEIVE_OFFLOAD;
+	return !enable;
+#endif
+}
+
 static void
 _udp_socket_open(socket_t* sock, unsigned int family) {
 	socket_base_t* sockbase;
@@ -48,10 +112,11 @@ _udp_socket_open(socket_t* sock, unsigned int family) {
 		return;
 
 	sockbase = _socket_base + sock->base;
+	sockbase->flags |= SOCKETFLAG_DATAGRAM;
 	if (family == NETWORK_ADDRESSFAMILY_IPV6)
-		sockbase->fd = (int)socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+		sockbase->fd = (int)socket(AF_INET6, SOCK_DGRAM | SOCKET_TYPE_FLAGS(sockbase), IPPROTO_UDP);
 	else
-		sockbase->fd = (int)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		sockbase->fd = (int)socket(AF_INET, SOCK_DGRAM | SOCKET_TYPE_FLAGS(sockbase), IPPROTO_UDP);
 
 	if (sockbase->fd < 0) {
 		int err = NETWORK_SOCKET_ERROR;
@@ -64,6 +129,8 @@ _udp_socket_open(socket_t* sock, unsigned int family) {
 	else {
 		log_debugf(HASH_NETWORK, STRING_CONST("Opened UDP socket (0x%" PRIfixPTR " : %d)"),
 		           sock, sockbase->fd);
+		if (sockbase->flags & SOCKETFLAG_RECEIVE_OFFLOAD)
+			udp_socket_set_receive_offload(sock, true);
 	}
 }
 
@@ -76,12 +143,182 @@ _udp_stream_initialize(socket_t* sock, stream_t* stream) {
 
 size_t
 udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_address_t const** address) {
+	return _udp_socket_recvfrom(sock, buffer, capacity, address, nullptr, nullptr);
+}
+
+size_t
+udp_socket_recvfrom_timestamp(socket_t* sock, void* buffer, size_t capacity,
+                              network_address_t const** address, uint64_t* timestamp) {
+	return _udp_socket_recvfrom(sock, buffer, capacity, address, timestamp, nullptr);
+}
+
+size_t
+udp_socket_recvfrom_storage(socket_t* sock, void* buffer, size_t capacity,
+                            network_address_storage_t* address) {
+	return _udp_socket_recvfrom(sock, buffer, capacity, nullptr, nullptr, address);
+}
+
+size_t
+udp_socket_recvfrom_batch(socket_t* sock, udp_datagram_t* datagrams, size_t count) {
+	return _udp_socket_recvfrom_batch(sock, datagrams, nullptr, count);
+}
+
+size_t
+udp_socket_recvfrom_batch_storage(socket_t* sock, udp_datagram_t* datagrams,
+                                  network_address_storage_t* addresses, size_t count) {
+	return _udp_socket_recvfrom_batch(sock, datagrams, addresses, count);
+}
+
+static network_address_size_t
+_udp_socket_address_size(const socket_t* sock) {
+	return (sock->address_local->family == NETWORK_ADDRESSFAMILY_IPV6) ?
+	       (network_address_size_t)sizeof(struct sockaddr_in6) : (network_address_size_t)sizeof(struct sockaddr_in);
+}
+
+static void
+_udp_socket_copy_address(network_address_ip_t* target, const network_address_ip_t* source) {
+	memcpy(&target->saddr, &source->saddr, (size_t)source->address_size);
+	target->family = source->family;
+	target->address_size = source->address_size;
+}
+
+static network_address_ip_t*
+_udp_socket_remote_address(socket_t* sock) {
+	if (!sock->address_remote || (sock->address_remote->family != sock->address_local->family)) {
+		if (sock->address_remote)
+			memory_deallocate(sock->address_remote);
+		sock->address_remote = network_address_clone(sock->address_local);
+	}
+	return (network_address_ip_t*)sock->address_remote;
+}
+
+#if NETWORK_HAVE_UDP_SEGMENT
+
+//Receives straight into the caller address slot, later segments of the same receive
+//are delivered from the copy of the source kept in the socket
+static bool
+_udp_socket_receive_coalesced(socket_t* sock, socket_base_t* sockbase, int flags, network_address_ip_t* addr_ip) {
+	char control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec))];
+	network_address_ip_t* source = (network_address_ip_t*)&sock->coalesce_address;
+	struct cmsghdr* cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	long ret;
+
+	if (!sock->coalesce_buffer)
+		sock->coalesce_buffer = memory_allocate(HASH_NETWORK, UDP_COALESCE_BUFFER_SIZE, 0, MEMORY_PERSISTENT);
+
+	addr_ip->family = sock->address_local->family;
+	addr_ip->address_size = _udp_socket_address_size(sock);
+	iov.iov_base = sock->coalesce_buffer;
+	iov.iov_len = UDP_COALESCE_BUFFER_SIZE;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = &addr_ip->saddr;
+	msg.msg_namelen = addr_ip->address_size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	ret = (long)recvmsg(sockbase->fd, &msg, flags);
+	if (ret < 0) {
+		if (!(flags & MSG_DONTWAIT))
+			_udp_socket_recvfrom_failed(sock, sockbase);
+		return false;
+	}
+
+	addr_ip->address_size = msg.msg_namelen;
+	sock->coalesce_offset = 0;
+	sock->coalesce_size = (size_t)ret;
+	sock->coalesce_timestamp = 0;
+	//Without a segment size cmsg the receive holds a single datagram
+	sock->coalesce_segment = (size_t)ret;
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if ((cmsg->cmsg_level == IPPROTO_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+			int segment;
+			memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+			if (segment > 0)
+				sock->coalesce_segment = (size_t)segment;
+		}
+		else if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL)) {
+			uint32_t dropped;
+			memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+			_socket_autotune_receive_buffer(sock, dropped != sock->receive_dropped);
+			sock->receive_dropped = dropped;
+		}
+		else if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS)) {
+			struct timespec ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			sock->coalesce_timestamp = ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+		}
+	}
+	if ((addr_ip != source) && (sock->coalesce_size > sock->coalesce_segment))
+		_udp_socket_copy_address(source, addr_ip);
+
+	NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, 0, ret);
+	return true;
+}
+
+static bool
+_udp_socket_next_segment(socket_t* sock, socket_base_t* sockbase, int flags, void* buffer, size_t capacity,
+                         network_address_ip_t* addr_ip, size_t* received) {
+	const void* segment;
+	size_t size;
+
+	if (sock->coalesce_offset >= sock->coalesce_size) {
+		if (!_udp_socket_receive_coalesced(sock, sockbase, flags, addr_ip))
+			return false;
+	}
+	else if (addr_ip != (network_address_ip_t*)&sock->coalesce_address) {
+		_udp_socket_copy_address(addr_ip, (const network_address_ip_t*)&sock->coalesce_address);
+	}
+
+	segment = sock->coalesce_buffer + sock->coalesce_offset;
+	size = sock->coalesce_size - sock->coalesce_offset;
+	if (size > sock->coalesce_segment)
+		size = sock->coalesce_segment;
+	sock->coalesce_offset += size;
+
+	if (SOCKET_CAPTURE(sockbase))
+		_network_capture_buffer(sock, false, 0, segment, size, (const network_address_t*)addr_ip);
+
+	//Truncate like the kernel does for datagrams larger than the buffer
+	if (size > capacity)
+		size = capacity;
+	memcpy(buffer, segment, size);
+	*received = size;
+	return true;
+}
+
+static size_t
+_udp_socket_recvfrom_coalesced(socket_t* sock, socket_base_t* sockbase, udp_datagram_t* datagrams,
+                               network_address_storage_t* storage, size_t count) {
+	size_t received = 0;
+
+	for (; received < count; ++received) {
+		network_address_ip_t* addr_ip = _udp_socket_source_address(sock, storage, received);
+		//Only the first receive may block
+		if (!_udp_socket_next_segment(sock, sockbase, received ? MSG_DONTWAIT : 0, datagrams[received].buffer,
+		                              datagrams[received].capacity, addr_ip, &datagrams[received].size))
+			break;
+		datagrams[received].address = (const network_address_t*)addr_ip;
+	}
+
+	return received;
+}
+
+#endif
+
+static size_t
+_udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_address_t const** address,
+                     uint64_t* timestamp, network_address_storage_t* storage) {
 	socket_base_t* sockbase;
 	network_address_ip_t* addr_ip;
 	long ret;
 
 	if (address)
 		*address = 0;
+	if (timestamp)
+		*timestamp = 0;
 
 	if (sock->base < 0)
 		return 0;
@@ -89,27 +326,96 @@ udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_addre
 	sockbase = _socket_base + sock->base;
 	if ((sockbase->fd == SOCKET_INVALID) || !sock->address_local)
 		return 0;
-	if (sockbase->state != SOCKETSTATE_NOTCONNECTED) {
+	//A connected socket only receives datagrams from its peer, the kernel drops all other sources
+	if ((sockbase->state != SOCKETSTATE_NOTCONNECTED) && (sockbase->state != SOCKETSTATE_CONNECTED)) {
 		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
-		                                 "Trying to datagram read from a connected UDP socket (0x%" PRIfixPTR " : %d) in state %u",
+		                                 "Trying to datagram read from a UDP socket (0x%" PRIfixPTR " : %d) in state %u",
 		                                 sock, sockbase->fd, sockbase->state);
 		return 0;
 	}
 
-	if (!sock->address_remote || (sock->address_remote->family != sock->address_local->family)) {
-		if (sock->address_remote)
-			memory_deallocate(sock->address_remote);
-		sock->address_remote = network_address_clone(sock->address_local);
+#if NETWORK_HAVE_UDP_SEGMENT
+	if ((sockbase->flags & SOCKETFLAG_RECEIVE_OFFLOAD) || (sock->coalesce_offset < sock->coalesce_size)) {
+		size_t size;
+		addr_ip = storage ? _udp_socket_source_address(sock, storage, 0) :
+		          (network_address_ip_t*)&sock->coalesce_address;
+		if (!_udp_socket_next_segment(sock, sockbase, 0, buffer, capacity, addr_ip, &size))
+			return 0;
+		if (address)
+			*address = (const network_address_t*)addr_ip;
+		if (timestamp)
+			*timestamp = sock->coalesce_timestamp;
+		return size;
 	}
-	addr_ip = (network_address_ip_t*)sock->address_remote;
+#endif
 
+	//Caller storage keeps the receive path free of heap operations
+	if (storage) {
+		addr_ip = _udp_socket_source_address(sock, storage, 0);
+		addr_ip->family = sock->address_local->family;
+		addr_ip->address_size = _udp_socket_address_size(sock);
+	}
+	else {
+		addr_ip = _udp_socket_remote_address(sock);
+	}
+
+#if FOUNDATION_PLATFORM_POSIX
+	if (sock->receive_buffer_max || (timestamp && (sockbase->flags & SOCKETFLAG_TIMESTAMP_RECEIVE))) {
+		//Read with ancillary data to get the kernel drop counter and receive timestamp
+		char control[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec) * 3)];
+		struct cmsghdr* cmsg;
+		struct msghdr msg;
+		struct iovec iov;
+		iov.iov_base = buffer;
+		iov.iov_len = capacity;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &addr_ip->saddr;
+		msg.msg_namelen = addr_ip->address_size;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		ret = (long)recvmsg(sockbase->fd, &msg, 0);
+		if (ret >= 0) {
+			addr_ip->address_size = msg.msg_namelen;
+			for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+				if (cmsg->cmsg_level != SOL_SOCKET)
+					continue;
+#  if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+				if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+					uint32_t dropped;
+					memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+					_socket_autotune_receive_buffer(sock, dropped != sock->receive_dropped);
+					sock->receive_dropped = dropped;
+				}
+				else if ((cmsg->cmsg_type == SCM_TIMESTAMPNS) && timestamp) {
+					struct timespec ts;
+					memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+					*timestamp = ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+				}
+#  else
+				if ((cmsg->cmsg_type == SCM_TIMESTAMP) && timestamp) {
+					struct timeval tv;
+					memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+					*timestamp = ((uint64_t)tv.tv_sec * 1000000000ULL) + ((uint64_t)tv.tv_usec * 1000ULL);
+				}
+#  endif
+			}
+		}
+	}
+	else
+#endif
 	ret = recvfrom(sockbase->fd, (char*)buffer, (int)capacity, 0, &addr_ip->saddr,
 	               &addr_ip->address_size);
-	if (ret > 0) {
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		const unsigned char* src = (const unsigned char*)buffer;
-		char dump_buffer[66];
+#if !FOUNDATION_PLATFORM_LINUX && !FOUNDATION_PLATFORM_ANDROID
+	if ((ret > 0) && sock->receive_buffer_max) {
+		//No drop counter, grow when the receive queue is nearly full
+		int available = _socket_available_fd(sockbase->fd);
+		size_t size = socket_receive_buffer_size(sock);
+		_socket_autotune_receive_buffer(sock, (available > 0) && ((size_t)available * 4 > size * 3));
+	}
 #endif
+	if (ret > 0) {
 #if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
 		{
 			char addr_buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
@@ -119,21 +425,10 @@ udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_addre
 			           sock, sockbase->fd, ret, capacity, STRING_FORMAT(address_str));
 		}
 #endif
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		for (long row = 0; row <= (ret / 8); ++row) {
-			long ofs = 0, col = 0, cols = 8;
-			if ((row + 1) * 8 > ret)
-				cols = ret - (row * 8);
-			for (; col < cols; ++col, ofs += 3) {
-				string_format(dump_buffer + ofs, 66 - (unsigned int)ofs, "%02x", *(src + (row * 8) + col));
-				*(dump_buffer + ofs + 2) = ' ';
-			}
-			if (ofs) {
-				*(dump_buffer + ofs - 1) = 0;
-				log_debug(HASH_NETWORK, dump_buffer, ofs - 1);
-			}
-		}
-#endif
+
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture_buffer(sock, false, 0, buffer, (size_t)ret, (const network_address_t*)addr_ip);
+		NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, 0, ret);
 
 		if (address)
 			*address = sock->address_remote;
@@ -141,6 +436,13 @@ udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_addre
 		return (size_t)ret;
 	}
 
+	_udp_socket_recvfrom_failed(sock, sockbase);
+
+	return 0;
+}
+
+static void
+_udp_socket_recvfrom_failed(socket_t* sock, socket_base_t* sockbase) {
 	int sockerr = NETWORK_SOCKET_ERROR;
 
 #if FOUNDATION_PLATFORM_WINDOWS
@@ -164,83 +466,145 @@ udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity, network_addre
 		          STRING_CONST("Socket recvfrom() failed on UDP socket (0x%" PRIfixPTR
 		                       " : %d): %.*s (%d) (SO_ERROR %d)"),
 		          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr, serr);
+		NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, sockerr, 0);
 	}
+}
 
-	return 0;
+static network_address_ip_t*
+_udp_socket_source_address(socket_t* sock, network_address_storage_t* storage, size_t index) {
+	FOUNDATION_ASSERT(sizeof(network_address_storage_t) >= sizeof(network_address_ipv6_t));
+	if (storage)
+		return (network_address_ip_t*)(storage + index);
+	//Slots are sized for the largest address family
+	return pointer_offset(sock->address_batch, sizeof(network_address_ipv6_t) * index);
 }
 
-size_t
-udp_socket_sendto(socket_t* sock, const void* buffer, size_t size,
-                  const network_address_t* address) {
+static size_t
+_udp_socket_recvfrom_batch(socket_t* sock, udp_datagram_t* datagrams, network_address_storage_t* storage,
+                           size_t count) {
 	socket_base_t* sockbase;
-	const network_address_ip_t* addr_ip;
+	network_address_size_t address_size;
+	size_t received = 0;
+	size_t total = 0;
+	size_t idgram;
 	long ret = 0;
 
-	if (!address)
-		return 0;
-	if (_socket_create_fd(sock, address->family) == SOCKET_INVALID)
+	if ((sock->base < 0) || !count)
 		return 0;
 
 	sockbase = _socket_base + sock->base;
-	if (sockbase->state != SOCKETSTATE_NOTCONNECTED) {
-		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
-		                                 "Trying to datagram send from a connected UDP socket (0x%" PRIfixPTR " : %d) in state %u",
-		                                 sock, sockbase->fd, sockbase->state);
+	if ((sockbase->fd == SOCKET_INVALID) || !sock->address_local)
 		return 0;
-	}
-	if (_socket_create_fd(sock, address->family) == SOCKET_INVALID) {
+	if ((sockbase->state != SOCKETSTATE_NOTCONNECTED) && (sockbase->state != SOCKETSTATE_CONNECTED)) {
 		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
-		                                 "Trying to datagram send from an invalid UDP socket (0x%" PRIfixPTR " : %d) in state %u",
+		                                 "Trying to datagram read from a UDP socket (0x%" PRIfixPTR " : %d) in state %u",
 		                                 sock, sockbase->fd, sockbase->state);
 		return 0;
 	}
-	addr_ip = (const network_address_ip_t*)address;
 
-	ret = sendto(sockbase->fd, buffer, (int)size, 0, &addr_ip->saddr,
-	             addr_ip->address_size);
-	if (ret > 0) {
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		const unsigned char* src = (const unsigned char*)buffer;
-		char buffer[34];
-#endif
-#if BUILD_ENABLE_LOG
-		char addr_buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
-		string_t address_str = network_address_to_string(addr_buffer, sizeof(addr_buffer), address, true);
-		if ((size_t)ret != size) {
-			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
-			          STRING_CONST("Socket (0x%" PRIfixPTR " : %d): partial UDP datagram write %d of %" PRIsize " bytes to %.*s"),
-			          sock, sockbase->fd, ret, size, STRING_FORMAT(address_str));
-		}
-		else {
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
-			log_debugf(HASH_NETWORK, STRING_CONST("Socket (0x%" PRIfixPTR
-			                                      " : %d) wrote %d of %" PRIsize " bytes to %.*s"),
-			           sock, sockbase->fd, ret, size, STRING_FORMAT(address_str));
+	if (count > UDP_DATAGRAM_BATCH_MAX)
+		count = UDP_DATAGRAM_BATCH_MAX;
+	if (!storage && !sock->address_batch)
+		sock->address_batch = memory_allocate(HASH_NETWORK, sizeof(network_address_ipv6_t) * UDP_DATAGRAM_BATCH_MAX,
+		                                      0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+
+	address_size = _udp_socket_address_size(sock);
+	for (idgram = 0; idgram < count; ++idgram) {
+		network_address_ip_t* addr_ip = _udp_socket_source_address(sock, storage, idgram);
+		addr_ip->family = sock->address_local->family;
+		addr_ip->address_size = address_size;
+		datagrams[idgram].size = 0;
+		datagrams[idgram].address = 0;
+	}
+
+#if NETWORK_HAVE_UDP_SEGMENT
+	if ((sockbase->flags & SOCKETFLAG_RECEIVE_OFFLOAD) || (sock->coalesce_offset < sock->coalesce_size))
+		return _udp_socket_recvfrom_coalesced(sock, sockbase, datagrams, storage, count);
 #endif
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	{
+		struct mmsghdr msgs[UDP_DATAGRAM_BATCH_MAX];
+		struct iovec iovs[UDP_DATAGRAM_BATCH_MAX];
+		char control[UDP_DATAGRAM_BATCH_MAX][CMSG_SPACE(sizeof(uint32_t))];
+		memset(msgs, 0, sizeof(struct mmsghdr) * count);
+		for (idgram = 0; idgram < count; ++idgram) {
+			network_address_ip_t* addr_ip = _udp_socket_source_address(sock, storage, idgram);
+			iovs[idgram].iov_base = datagrams[idgram].buffer;
+			iovs[idgram].iov_len = datagrams[idgram].capacity;
+			msgs[idgram].msg_hdr.msg_name = &addr_ip->saddr;
+			msgs[idgram].msg_hdr.msg_namelen = address_size;
+			msgs[idgram].msg_hdr.msg_iov = iovs + idgram;
+			msgs[idgram].msg_hdr.msg_iovlen = 1;
+			if (sock->receive_buffer_max) {
+				msgs[idgram].msg_hdr.msg_control = control[idgram];
+				msgs[idgram].msg_hdr.msg_controllen = sizeof(control[idgram]);
+			}
 		}
-#endif
-#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 1
-		for (long row = 0; row <= (ret / 8); ++row) {
-			long ofs = 0, col = 0, cols = 8;
-			if ((row + 1) * 8 > ret)
-				cols = ret - (row * 8);
-			for (; col < cols; ++col, ofs += 3) {
-				string_format(buffer + ofs, 34 - (unsigned int)ofs, "%02x", *(src + (row * 8) + col));
-				*(buffer + ofs + 2) = ' ';
+
+		//Block for the first datagram only, then take whatever else is already queued
+		ret = (long)recvmmsg(sockbase->fd, msgs, (unsigned int)count, MSG_WAITFORONE, 0);
+		if (ret > 0) {
+			received = (size_t)ret;
+			for (idgram = 0; idgram < received; ++idgram) {
+				datagrams[idgram].size = msgs[idgram].msg_len;
+				_udp_socket_source_address(sock, storage, idgram)->address_size = msgs[idgram].msg_hdr.msg_namelen;
 			}
-			if (ofs) {
-				*(buffer + ofs - 1) = 0;
-				log_debug(HASH_NETWORK, buffer, ofs - 1);
+			if (sock->receive_buffer_max) {
+				//Drop counter is cumulative, the last datagram carries the current value
+				struct msghdr* msg = &msgs[received - 1].msg_hdr;
+				struct cmsghdr* cmsg;
+				for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+					if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL)) {
+						uint32_t dropped;
+						memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+						_socket_autotune_receive_buffer(sock, dropped != sock->receive_dropped);
+						sock->receive_dropped = dropped;
+					}
+				}
 			}
 		}
+	}
+#else
+	for (idgram = 0; idgram < count; ++idgram) {
+		network_address_ip_t* addr_ip = _udp_socket_source_address(sock, storage, idgram);
+		//Only the first receive may block, stop once the receive queue is empty
+		if (idgram && (_socket_available_fd(sockbase->fd) <= 0))
+			break;
+		ret = recvfrom(sockbase->fd, (char*)datagrams[idgram].buffer, (int)datagrams[idgram].capacity, 0,
+		               &addr_ip->saddr, &addr_ip->address_size);
+		if (ret < 0)
+			break;
+		datagrams[idgram].size = (size_t)ret;
+		++received;
+	}
+	if (received && sock->receive_buffer_max) {
+		int available = _socket_available_fd(sockbase->fd);
+		size_t size = socket_receive_buffer_size(sock);
+		_socket_autotune_receive_buffer(sock, (available > 0) && ((size_t)available * 4 > size * 3));
+	}
 #endif
 
-		if (!sock->address_local)
-			_socket_store_address_local(sock, address->family);
+	if (!received) {
+		if (ret < 0)
+			_udp_socket_recvfrom_failed(sock, sockbase);
+		return 0;
+	}
 
-		return (size_t)ret;
+	for (idgram = 0; idgram < received; ++idgram) {
+		datagrams[idgram].address = (const network_address_t*)_udp_socket_source_address(sock, storage, idgram);
+		total += datagrams[idgram].size;
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture_buffer(sock, false, 0, datagrams[idgram].buffer, datagrams[idgram].size,
+			                        datagrams[idgram].address);
 	}
+	NETWORK_TRACE(NETWORKTRACE_READ, sock, sockbase->fd, 0, total);
 
+	return received;
+}
+
+static void
+_udp_socket_sendto_failed(socket_t* sock, socket_base_t* sockbase) {
 	int sockerr = NETWORK_SOCKET_ERROR;
 
 #if FOUNDATION_PLATFORM_WINDOWS
@@ -264,7 +628,364 @@ udp_socket_sendto(socket_t* sock, const void* buffer, size_t size,
 		          STRING_CONST("Socket sendto() failed on UDP socket (0x%" PRIfixPTR
 		                       " : %d): %.*s (%d) (SO_ERROR %d)"),
 		          sock, sockbase->fd, STRING_FORMAT(errmsg), sockerr, serr);
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, sockerr, 0);
 	}
+}
+
+static socket_base_t*
+_udp_socket_send_base(socket_t* sock, const network_address_t* address) {
+	socket_base_t* sockbase;
+
+	if (address) {
+		if (_socket_create_fd(sock, address->family) == SOCKET_INVALID)
+			return 0;
+	}
+	else if ((sock->base < 0) || (_socket_base[sock->base].fd == SOCKET_INVALID)) {
+		return 0;
+	}
+
+	sockbase = _socket_base + sock->base;
+	if (sockbase->state == SOCKETSTATE_CONNECTED)
+		return sockbase;
+	if (sockbase->state != SOCKETSTATE_NOTCONNECTED) {
+		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
+		                                 "Trying to datagram send from a UDP socket (0x%" PRIfixPTR " : %d) in state %u",
+		                                 sock, sockbase->fd, sockbase->state);
+		return 0;
+	}
+	//Only a connected socket can send without a destination
+	return address ? sockbase : 0;
+}
+
+//Datagrams to the connected peer are sent without a destination, the kernel then reuses the
+//route and source address resolved at connect instead of looking them up for every datagram
+static const network_address_ip_t*
+_udp_socket_destination(const socket_t* sock, const socket_base_t* sockbase, const network_address_t* address) {
+	if ((sockbase->state == SOCKETSTATE_CONNECTED) &&
+	        (!address || network_address_equal(address, sock->address_remote)))
+		return 0;
+	return (const network_address_ip_t*)address;
+}
+
+size_t
+udp_socket_sendto(socket_t* sock, const void* buffer, size_t size,
+                  const network_address_t* address) {
+	socket_base_t* sockbase;
+	const network_address_ip_t* addr_ip;
+	long ret = 0;
+
+	sockbase = _udp_socket_send_base(sock, address);
+	if (!sockbase)
+		return 0;
+	addr_ip = _udp_socket_destination(sock, sockbase, address);
+	if (!address)
+		address = sock->address_remote;
+
+	ret = sendto(sockbase->fd, buffer, (int)size, 0, addr_ip ? &addr_ip->saddr : 0,
+	             addr_ip ? addr_ip->address_size : 0);
+	if (ret > 0) {
+#if BUILD_ENABLE_LOG
+		//Only format the address when something is logged, this is the per-packet path
+		if ((size_t)ret != size) {
+			char addr_buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
+			string_t address_str = network_address_to_string(addr_buffer, sizeof(addr_buffer), address, true);
+			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+			          STRING_CONST("Socket (0x%" PRIfixPTR " : %d): partial UDP datagram write %d of %" PRIsize " bytes to %.*s"),
+			          sock, sockbase->fd, ret, size, STRING_FORMAT(address_str));
+		}
+#if BUILD_ENABLE_NETWORK_DUMP_TRAFFIC > 0
+		else {
+			char addr_buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
+			string_t address_str = network_address_to_string(addr_buffer, sizeof(addr_buffer), address, true);
+			log_debugf(HASH_NETWORK, STRING_CONST("Socket (0x%" PRIfixPTR
+			                                      " : %d) wrote %d of %" PRIsize " bytes to %.*s"),
+			           sock, sockbase->fd, ret, size, STRING_FORMAT(address_str));
+		}
+#endif
+#endif
+
+		if (!sock->address_local)
+			_socket_store_address_local(sock, address->family);
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture_buffer(sock, true, 0, buffer, (size_t)ret, address);
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, ret);
+
+		return (size_t)ret;
+	}
+
+	_udp_socket_sendto_failed(sock, sockbase);
+
+	return 0;
+}
+
+size_t
+udp_socket_sendto_batch(socket_t* sock, const udp_datagram_t* datagrams, size_t count) {
+	socket_base_t* sockbase;
+	size_t sent = 0;
+	size_t total = 0;
+	size_t idgram;
+	long ret = 0;
+
+	if (!count)
+		return 0;
+	sockbase = _udp_socket_send_base(sock, datagrams[0].address);
+	if (!sockbase)
+		return 0;
+
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	while (sent < count) {
+		struct mmsghdr msgs[UDP_DATAGRAM_BATCH_MAX];
+		struct iovec iovs[UDP_DATAGRAM_BATCH_MAX];
+		size_t batch = count - sent;
+		if (batch > UDP_DATAGRAM_BATCH_MAX)
+			batch = UDP_DATAGRAM_BATCH_MAX;
+
+		memset(msgs, 0, sizeof(struct mmsghdr) * batch);
+		for (idgram = 0; idgram < batch; ++idgram) {
+			const udp_datagram_t* datagram = datagrams + sent + idgram;
+			const network_address_ip_t* addr_ip = _udp_socket_destination(sock, sockbase, datagram->address);
+			iovs[idgram].iov_base = datagram->buffer;
+			iovs[idgram].iov_len = datagram->size;
+			if (addr_ip) {
+				msgs[idgram].msg_hdr.msg_name = (void*)&addr_ip->saddr;
+				msgs[idgram].msg_hdr.msg_namelen = addr_ip->address_size;
+			}
+			msgs[idgram].msg_hdr.msg_iov = iovs + idgram;
+			msgs[idgram].msg_hdr.msg_iovlen = 1;
+		}
+
+		//The kernel stops at the first datagram it cannot send, retry the rest until it refuses
+		ret = (long)sendmmsg(sockbase->fd, msgs, (unsigned int)batch, 0);
+		if (ret <= 0)
+			break;
+		sent += (size_t)ret;
+	}
+#else
+	for (; sent < count; ++sent) {
+		const network_address_ip_t* addr_ip = _udp_socket_destination(sock, sockbase, datagrams[sent].address);
+		ret = sendto(sockbase->fd, (const char*)datagrams[sent].buffer, (int)datagrams[sent].size, 0,
+		             addr_ip ? &addr_ip->saddr : 0, addr_ip ? addr_ip->address_size : 0);
+		if (ret < 0)
+			break;
+	}
+#endif
+
+	if (!sent) {
+		_udp_socket_sendto_failed(sock, sockbase);
+		return 0;
+	}
+
+	if (!sock->address_local)
+		_socket_store_address_local(sock, datagrams[0].address ? datagrams[0].address->family :
+		                            sock->address_remote->family);
+	for (idgram = 0; idgram < sent; ++idgram) {
+		total += datagrams[idgram].size;
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture_buffer(sock, true, 0, datagrams[idgram].buffer, datagrams[idgram].size,
+			                        datagrams[idgram].address ? datagrams[idgram].address : sock->address_remote);
+	}
+	NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, total);
+
+	return sent;
+}
+
+#if NETWORK_HAVE_UDP_SEGMENT
+
+static bool
+_udp_socket_segment_offload(socket_base_t* sockbase) {
+	//Kernels without segmentation offload ignore the control message, probe with the socket option
+	if (!(sockbase->flags & SOCKETFLAG_SEGMENT_PROBED)) {
+		int segment = 0;
+		sockbase->flags |= SOCKETFLAG_SEGMENT_PROBED;
+		if (setsockopt(sockbase->fd, IPPROTO_UDP, UDP_SEGMENT, (const void*)&segment, sizeof(segment)) == 0)
+			sockbase->flags |= SOCKETFLAG_SEGMENT_OFFLOAD;
+	}
+	return (sockbase->flags & SOCKETFLAG_SEGMENT_OFFLOAD) != 0;
+}
+
+static size_t
+_udp_socket_sendto_offload(socket_t* sock, socket_base_t* sockbase, const void* buffer, size_t size,
+                           size_t segment_size, const network_address_t* address, bool* fallback) {
+	const network_address_ip_t* addr_ip = _udp_socket_destination(sock, sockbase, address);
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+	uint16_t gso_size = (uint16_t)segment_size;
+	size_t max_send, sent = 0;
+
+	max_send = (UDP_SEGMENT_MAX_SIZE / segment_size) * segment_size;
+	if (max_send > segment_size * UDP_SEGMENT_MAX_COUNT)
+		max_send = segment_size * UDP_SEGMENT_MAX_COUNT;
+
+	while (sent < size) {
+		struct msghdr msg;
+		struct iovec iov;
+		struct cmsghdr* cmsg;
+		size_t chunk = size - sent;
+		long ret;
+
+		if (chunk > max_send)
+			chunk = max_send;
+		iov.iov_base = (void*)pointer_offset_const(buffer, sent);
+		iov.iov_len = chunk;
+		memset(&msg, 0, sizeof(msg));
+		memset(control, 0, sizeof(control));
+		if (addr_ip) {
+			msg.msg_name = (void*)&addr_ip->saddr;
+			msg.msg_namelen = addr_ip->address_size;
+		}
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = IPPROTO_UDP;
+		cmsg->cmsg_type = UDP_SEGMENT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+		ret = (long)sendmsg(sockbase->fd, &msg, 0);
+		if (ret < 0) {
+			int err = NETWORK_SOCKET_ERROR;
+			//Devices without checksum offload reject segmented sends, stop using offload on this socket.
+			//Segments exceeding the path MTU are rejected as invalid, fall back for this send only
+			if ((err == EIO) || (err == EOPNOTSUPP) || (err == ENOPROTOOPT))
+				sockbase->flags &= ~SOCKETFLAG_SEGMENT_OFFLOAD;
+			if ((err == EIO) || (err == EOPNOTSUPP) || (err == ENOPROTOOPT) || (err == EINVAL))
+				*fallback = true;
+			else if (!sent)
+				_udp_socket_sendto_failed(sock, sockbase);
+			break;
+		}
+		sent += (size_t)ret;
+	}
+
+	if (sent) {
+		if (SOCKET_CAPTURE(sockbase)) {
+			size_t offset;
+			for (offset = 0; offset < sent; offset += segment_size)
+				_network_capture_buffer(sock, true, 0, pointer_offset_const(buffer, offset),
+				                        (sent - offset < segment_size) ? (sent - offset) : segment_size,
+				                        address ? address : sock->address_remote);
+		}
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, sent);
+	}
+
+	return sent;
+}
+
+#endif
+
+size_t
+udp_socket_sendto_segmented(socket_t* sock, const void* buffer, size_t size, size_t segment_size,
+                            const network_address_t* address) {
+	socket_base_t* sockbase;
+	size_t sent = 0;
+
+	if (!size || !segment_size)
+		return 0;
+	if (size <= segment_size)
+		return udp_socket_sendto(sock, buffer, size, address);
+	sockbase = _udp_socket_send_base(sock, address);
+	if (!sockbase)
+		return 0;
+
+#if NETWORK_HAVE_UDP_SEGMENT
+	if ((segment_size <= UDP_SEGMENT_MAX_SIZE / 2) && _udp_socket_segment_offload(sockbase)) {
+		bool fallback = false;
+		sent = _udp_socket_sendto_offload(sock, sockbase, buffer, size, segment_size, address, &fallback);
+		if (sent && !sock->address_local)
+			_socket_store_address_local(sock, address ? address->family : sock->address_remote->family);
+		if (!fallback)
+			return sent;
+	}
+#endif
+
+	while (sent < size) {
+		udp_datagram_t datagrams[UDP_DATAGRAM_BATCH_MAX];
+		size_t count = 0, batch, idgram;
+		size_t offset = sent;
+		for (; (count < UDP_DATAGRAM_BATCH_MAX) && (offset < size); ++count) {
+			datagrams[count].buffer = (void*)pointer_offset_const(buffer, offset);
+			datagrams[count].size = (size - offset < segment_size) ? (size - offset) : segment_size;
+			datagrams[count].address = address;
+			offset += datagrams[count].size;
+		}
+		batch = udp_socket_sendto_batch(sock, datagrams, count);
+		for (idgram = 0; idgram < batch; ++idgram)
+			sent += datagrams[idgram].size;
+		if (batch < count)
+			break;
+	}
+
+	return sent;
+}
+
+size_t
+udp_socket_sendtov(socket_t* sock, const socket_iovec_t* iov, size_t count,
+                   const network_address_t* address) {
+	socket_base_t* sockbase;
+	const network_address_ip_t* addr_ip;
+	size_t size = 0;
+	size_t iiov;
+	long ret = 0;
+
+	if (!count)
+		return 0;
+	if (count > SOCKET_IOVEC_MAX) {
+		FOUNDATION_ASSERT_FAILFORMAT_LOG(HASH_NETWORK,
+		                                 "Too many buffers for datagram send on UDP socket (0x%" PRIfixPTR "): %" PRIsize,
+		                                 sock, count);
+		return 0;
+	}
+	sockbase = _udp_socket_send_base(sock, address);
+	if (!sockbase)
+		return 0;
+	addr_ip = _udp_socket_destination(sock, sockbase, address);
+	if (!address)
+		address = sock->address_remote;
+
+	for (iiov = 0; iiov < count; ++iiov)
+		size += iov[iiov].length;
+
+#if FOUNDATION_PLATFORM_WINDOWS
+	{
+		DWORD sent = 0;
+		ret = (WSASendTo(sockbase->fd, (LPWSABUF)iov, (DWORD)count, &sent, 0, addr_ip ? &addr_ip->saddr : 0,
+		                 addr_ip ? addr_ip->address_size : 0, 0, 0) == 0) ? (long)sent : -1;
+	}
+#else
+	{
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		if (addr_ip) {
+			msg.msg_name = (void*)&addr_ip->saddr;
+			msg.msg_namelen = addr_ip->address_size;
+		}
+		msg.msg_iov = (struct iovec*)iov;
+		msg.msg_iovlen = count;
+		ret = (long)sendmsg(sockbase->fd, &msg, 0);
+	}
+#endif
+	if (ret > 0) {
+#if BUILD_ENABLE_LOG
+		if ((size_t)ret != size) {
+			char addr_buffer[NETWORK_ADDRESS_NUMERIC_MAX_LENGTH];
+			string_t address_str = network_address_to_string(addr_buffer, sizeof(addr_buffer), address, true);
+			log_warnf(HASH_NETWORK, WARNING_SUSPICIOUS,
+			          STRING_CONST("Socket (0x%" PRIfixPTR " : %d): partial UDP datagram write %d of %" PRIsize " bytes to %.*s"),
+			          sock, sockbase->fd, ret, size, STRING_FORMAT(address_str));
+		}
+#endif
+
+		if (!sock->address_local)
+			_socket_store_address_local(sock, address->family);
+		if (SOCKET_CAPTURE(sockbase))
+			_network_capture(sock, true, 0, iov, count, (size_t)ret, address);
+		NETWORK_TRACE(NETWORKTRACE_WRITE, sock, sockbase->fd, 0, ret);
+
+		return (size_t)ret;
+	}
+
+	_udp_socket_sendto_failed(sock, sockbase);
 
 	return 0;
 }
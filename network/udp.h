@@ -25,10 +25,132 @@ udp_socket_allocate(void);
 NETWORK_API void
 udp_socket_initialize(socket_t* sock);
 
+/*! Bind a group of UDP sockets to the same address with SO_REUSEPORT, one socket per
+reactor or core. On Linux a classic BPF program is attached to the group steering each
+datagram to the socket at index (receiving CPU modulo count). Other platforms fall back
+to the kernel default distribution.
+\param sockets Allocated UDP sockets
+\param count   Number of sockets
+\param address Local address, port 0 binds all sockets to the same ephemeral port
+\return        true if all sockets are bound, false on error with no socket left bound */
+NETWORK_API bool
+udp_socket_bind_group(socket_t** sockets, size_t count, const network_address_t* address);
+
+/*! Enable or disable receive offload (UDP_GRO). The kernel coalesces consecutive datagrams
+of the same flow and delivers them in a single receive, which the library splits back into
+the original datagrams for all receive calls. Receive timestamps are not reported while
+enabled. Only supported on Linux.
+\param sock   Socket
+\param enable Enable flag
+\return       true if the requested state was set, false if not supported */
+NETWORK_API bool
+udp_socket_set_receive_offload(socket_t* sock, bool enable);
+
+/*! Query if receive offload is enabled
+\param sock Socket
+\return     true if enabled, false if not */
+NETWORK_API bool
+udp_socket_receive_offload(const socket_t* sock);
+
 NETWORK_API size_t
 udp_socket_recvfrom(socket_t* sock, void* buffer, size_t capacity,
                     network_address_t const** address);
 
+/*! Receive a datagram, writing the source address into caller owned storage. Unlike
+#udp_socket_recvfrom the address is not shared with later receive calls and the call
+performs no memory allocation.
+\param sock     Socket
+\param buffer   Destination buffer
+\param capacity Capacity of destination buffer
+\param address  Receives the source address
+\return         Number of bytes received */
+NETWORK_API size_t
+udp_socket_recvfrom_storage(socket_t* sock, void* buffer, size_t capacity,
+                            network_address_storage_t* address);
+
+/*! Receive a datagram along with its kernel receive timestamp. Requires receive
+timestamping enabled with #socket_set_timestamping
+\param sock      Socket
+\param buffer    Destination buffer
+\param capacity  Capacity of destination buffer
+\param address   Receives the source address
+\param timestamp Receives the kernel timestamp in nanoseconds since the Unix epoch,
+                  0 if not available
+\return          Number of bytes received */
+NETWORK_API size_t
+udp_socket_recvfrom_timestamp(socket_t* sock, void* buffer, size_t capacity,
+                              network_address_t const** address, uint64_t* timestamp);
+
+/*! Receive multiple datagrams with a single system call where supported (recvmmsg),
+falling back to a loop over the queued datagrams. Blocks only until the first datagram
+is available on a blocking socket. Source addresses point to storage owned by the
+socket and remain valid until the next batched receive or the socket is closed.
+Receive timestamps are not reported.
+\param sock      Socket
+\param datagrams Datagram array, buffer and capacity set by the caller, size and
+                  address set on return
+\param count     Number of datagrams, at most UDP_DATAGRAM_BATCH_MAX are received
+\return          Number of datagrams received */
+NETWORK_API size_t
+udp_socket_recvfrom_batch(socket_t* sock, udp_datagram_t* datagrams, size_t count);
+
+/*! Receive multiple datagrams like #udp_socket_recvfrom_batch, writing source addresses
+into caller owned storage. The datagram address fields point into the storage array.
+\param sock      Socket
+\param datagrams Datagram array, buffer and capacity set by the caller, size and
+                  address set on return
+\param addresses Address storage array with at least count entries
+\param count     Number of datagrams, at most UDP_DATAGRAM_BATCH_MAX are received
+\return          Number of datagrams received */
+NETWORK_API size_t
+udp_socket_recvfrom_batch_storage(socket_t* sock, udp_datagram_t* datagrams,
+                                  network_address_storage_t* addresses, size_t count);
+
+/*! Send a datagram. A socket connected to a fixed peer with #socket_connect accepts a null
+address (or the peer address) and sends without naming the destination, reusing the route
+resolved at connect. A connected socket also only receives datagrams from the peer, and
+#socket_write sends a single datagram to it.
+\param sock    Socket
+\param buffer  Data buffer
+\param size    Size of data
+\param address Destination address, null to send to the connected peer
+\return        Number of bytes sent */
 NETWORK_API size_t
 udp_socket_sendto(socket_t* sock, const void* buffer, size_t size,
                   const network_address_t* address);
+
+/*! Send multiple datagrams, each with its own destination address, with as few system
+calls as possible (sendmmsg where supported). Stops at the first datagram the socket
+does not accept, for example when the send buffer of a non-blocking socket is full.
+\param sock      Socket
+\param datagrams Datagram array, buffer, size and address set by the caller, the address
+                  may be null on a connected socket
+\param count     Number of datagrams
+\return          Number of datagrams sent, the remaining datagrams can be retried */
+NETWORK_API size_t
+udp_socket_sendto_batch(socket_t* sock, const udp_datagram_t* datagrams, size_t count);
+
+/*! Send a buffer as a sequence of datagrams of a fixed segment size, the last datagram
+carrying any remainder. Uses UDP segmentation offload where supported (UDP_SEGMENT), handing
+the kernel up to 64 segments per system call to split in the stack or the network device,
+and falls back to batched sends otherwise.
+\param sock         Socket
+\param buffer       Data buffer
+\param size         Size of data
+\param segment_size Size of each datagram
+\param address      Destination address, null to send to the connected peer
+\return             Number of bytes sent, always a multiple of the segment size unless
+                     the entire buffer was sent */
+NETWORK_API size_t
+udp_socket_sendto_segmented(socket_t* sock, const void* buffer, size_t size, size_t segment_size,
+                            const network_address_t* address);
+
+/*! Send a single datagram gathered from multiple buffers
+\param sock    Socket
+\param iov     Buffer array
+\param count   Number of buffers, at most SOCKET_IOVEC_MAX
+\param address Destination address, null to send to the connected peer
+\return        Number of bytes sent */
+NETWORK_API size_t
+udp_socket_sendtov(socket_t* sock, const socket_iovec_t* iov, size_t count,
+                   const network_address_t* address);
@@ -14,6 +14,11 @@
 #include <foundation/foundation.h>
 #include <test/test.h>
 
+#if FOUNDATION_PLATFORM_POSIX
+#  include <stdlib.h>
+#  include <unistd.h>
+#endif
+
 application_t
 test_tcp_application(void) {
 	application_t app;
@@ -624,6 +629,1387 @@ DECLARE_TEST(tcp, stream_ipv6) {
 	return 0;
 }
 
+static bool
+tcp_connected_pair(network_address_family_t family, socket_t** server, socket_t** client) {
+	network_address_t* address_bind = 0;
+	network_address_t** address_local = 0;
+	network_address_t* address_connect = 0;
+	socket_t* sock_listen;
+	int iaddr, asize;
+
+	*server = 0;
+	*client = 0;
+
+	sock_listen = tcp_socket_allocate();
+	address_bind = (family == NETWORK_ADDRESSFAMILY_IPV6) ? network_address_ipv6_any() :
+	               network_address_ipv4_any();
+	socket_bind(sock_listen, address_bind);
+	memory_deallocate(address_bind);
+
+	if (!tcp_socket_listen(sock_listen)) {
+		socket_deallocate(sock_listen);
+		return false;
+	}
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == family) {
+			address_connect = address_local[iaddr];
+			break;
+		}
+	}
+	if (address_connect) {
+		*client = tcp_socket_allocate();
+		network_address_ip_set_port(address_connect,
+		                            network_address_ip_port(socket_address_local(sock_listen)));
+		socket_set_blocking(*client, false);
+		socket_connect(*client, address_connect, 0);
+		thread_sleep(100);
+		*server = tcp_socket_accept(sock_listen, 1000);
+	}
+
+	network_address_array_deallocate(address_local);
+	socket_deallocate(sock_listen);
+
+	return *server && (socket_state(*client) == SOCKETSTATE_CONNECTED);
+}
+
+static atomic32_t queue_high_events;
+static atomic32_t queue_low_events;
+
+static void
+send_queue_callback(socket_t* sock, socket_queue_event_t event, size_t queued) {
+	FOUNDATION_UNUSED(sock);
+	FOUNDATION_UNUSED(queued);
+	if (event == SOCKETQUEUE_HIGH_WATERMARK)
+		atomic_incr32(&queue_high_events);
+	else if (event == SOCKETQUEUE_LOW_WATERMARK)
+		atomic_incr32(&queue_low_events);
+}
+
+static void*
+drain_blocking_thread(void* arg) {
+	socket_t* sock = (socket_t*)arg;
+	char buffer[4096];
+	size_t total = 0;
+
+	while (total < 4 * 1024 * 1024) {
+		size_t read = socket_read(sock, buffer, sizeof(buffer));
+		if (!read)
+			break;
+		total += read;
+	}
+
+	EXPECT_SIZEEQ(total, 4 * 1024 * 1024);
+	atomic_incr32(&io_completed);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, accept_nonblocking) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	char buffer[16];
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+
+	//Accepted socket descriptor must match its non-blocking flag
+	EXPECT_FALSE(socket_blocking(sock_server));
+	start = time_current();
+	EXPECT_SIZEEQ(socket_read(sock_server, buffer, sizeof(buffer)), 0);
+	EXPECT_REALLE(time_elapsed(start), REAL_C(0.5));
+	EXPECT_EQ(socket_state(sock_server), SOCKETSTATE_CONNECTED);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, send_queue) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	thread_t thread;
+	char buffer[64 * 1024];
+	int iloop;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+
+	atomic_store32(&queue_high_events, 0);
+	atomic_store32(&queue_low_events, 0);
+	atomic_store32(&io_completed, 0);
+
+	memset(buffer, 0x5a, sizeof(buffer));
+	socket_set_send_queue(sock_client, 256 * 1024, 64 * 1024, send_queue_callback);
+
+	//Poll registered while the queue is empty must start watching for writable once data queues up
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+
+	//Non-blocking writes must be fully accepted even when the peer is not reading
+	for (iloop = 0; iloop < 64; ++iloop)
+		EXPECT_SIZEEQ(socket_write(sock_client, buffer, sizeof(buffer)), sizeof(buffer));
+	EXPECT_SIZEGT(socket_send_queue_size(sock_client), 0);
+	EXPECT_EQ(atomic_load32(&queue_high_events), 1);
+	EXPECT_EQ(atomic_load32(&queue_low_events), 0);
+
+	socket_set_blocking(sock_server, true);
+	thread_initialize(&thread, drain_blocking_thread, sock_server, STRING_CONST("drain_thread"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+
+	start = time_current();
+	while (socket_send_queue_size(sock_client) && (time_elapsed(start) < REAL_C(10.0)))
+		network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+	network_poll_deallocate(poll);
+
+	EXPECT_SIZEEQ(socket_send_queue_size(sock_client), 0);
+	EXPECT_EQ(atomic_load32(&queue_low_events), 1);
+
+	thread_finalize(&thread);
+	EXPECT_EQ(atomic_load32(&io_completed), 1);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, vectored_io) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	socket_iovec_t iov[3];
+	char header[16];
+	char payload[3000];
+	char trailer[5];
+	char recv_header[16];
+	char recv_body[4096];
+	size_t total = 0;
+	size_t expected = sizeof(header) + sizeof(payload) + sizeof(trailer);
+	size_t ibyte;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+
+	memset(header, 'h', sizeof(header));
+	for (ibyte = 0; ibyte < sizeof(payload); ++ibyte)
+		payload[ibyte] = (char)(ibyte & 0x7f);
+	memset(trailer, 't', sizeof(trailer));
+
+	iov[0].buffer = header;  iov[0].length = sizeof(header);
+	iov[1].buffer = payload; iov[1].length = sizeof(payload);
+	iov[2].buffer = trailer; iov[2].length = sizeof(trailer);
+	EXPECT_SIZEEQ(socket_writev(sock_client, iov, 3), expected);
+	EXPECT_SIZEEQ(socket_writev(sock_client, iov, 0), 0);
+
+	socket_set_blocking(sock_server, true);
+	iov[0].buffer = recv_header; iov[0].length = sizeof(recv_header);
+	iov[1].buffer = recv_body;   iov[1].length = sizeof(recv_body);
+	total = socket_readv(sock_server, iov, 2);
+	EXPECT_SIZEGE(total, sizeof(recv_header));
+	while (total < expected) {
+		size_t read = socket_read(sock_server, recv_body + (total - sizeof(recv_header)),
+		                          expected - total);
+		EXPECT_SIZEGT(read, 0);
+		total += read;
+	}
+
+	EXPECT_EQ(memcmp(recv_header, header, sizeof(header)), 0);
+	EXPECT_EQ(memcmp(recv_body, payload, sizeof(payload)), 0);
+	EXPECT_EQ(memcmp(recv_body + sizeof(payload), trailer, sizeof(trailer)), 0);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+#define SEND_FILE_SIZE (3 * 1024 * 1024 + 17)
+#define SEND_FILE_OFFSET 1000
+
+static void*
+send_file_verify_thread(void* arg) {
+	socket_t* sock = (socket_t*)arg;
+	char buffer[4096];
+	size_t total = 0;
+	size_t expected = SEND_FILE_SIZE - SEND_FILE_OFFSET + 3;
+	size_t ibyte;
+	bool match = true;
+
+	while (total < expected) {
+		size_t read = socket_read(sock, buffer, sizeof(buffer));
+		if (!read)
+			break;
+		for (ibyte = 0; ibyte < read; ++ibyte) {
+			size_t pos = total + ibyte;
+			char want = (pos < expected - 3) ? (char)((pos + SEND_FILE_OFFSET) * 7) : 'e';
+			if (buffer[ibyte] != want)
+				match = false;
+		}
+		total += read;
+	}
+
+	EXPECT_SIZEEQ(total, expected);
+	EXPECT_TRUE(match);
+	atomic_incr32(&io_completed);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, send_file) {
+#if FOUNDATION_PLATFORM_POSIX
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	thread_t thread;
+	char filename[] = "/tmp/network_send_file_XXXXXX";
+	char buffer[4096];
+	size_t ibyte;
+	size_t size;
+	tick_t start;
+	int fd;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	fd = mkstemp(filename);
+	EXPECT_GE(fd, 0);
+	unlink(filename);
+	for (size = 0; size < SEND_FILE_SIZE; size += sizeof(buffer)) {
+		size_t chunk = (SEND_FILE_SIZE - size < sizeof(buffer)) ? SEND_FILE_SIZE - size : sizeof(buffer);
+		for (ibyte = 0; ibyte < chunk; ++ibyte)
+			buffer[ibyte] = (char)((size + ibyte) * 7);
+		EXPECT_EQ(write(fd, buffer, chunk), (ssize_t)chunk);
+	}
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+
+	atomic_store32(&io_completed, 0);
+	socket_set_send_queue(sock_client, 1024 * 1024, 0, nullptr);
+
+	//Remainder of the file and the trailing write must be queued in order
+	EXPECT_SIZEEQ(socket_send_file(sock_client, fd, SEND_FILE_OFFSET, SEND_FILE_SIZE - SEND_FILE_OFFSET),
+	              SEND_FILE_SIZE - SEND_FILE_OFFSET);
+	EXPECT_SIZEEQ(socket_write(sock_client, "eee", 3), 3);
+
+	//Queue holds its own reference to the file
+	close(fd);
+
+	socket_set_blocking(sock_server, true);
+	thread_initialize(&thread, send_file_verify_thread, sock_server, STRING_CONST("verify_thread"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+	start = time_current();
+	while (socket_send_queue_size(sock_client) && (time_elapsed(start) < REAL_C(10.0)))
+		network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+	network_poll_deallocate(poll);
+
+	EXPECT_SIZEEQ(socket_send_queue_size(sock_client), 0);
+
+	thread_finalize(&thread);
+	EXPECT_EQ(atomic_load32(&io_completed), 1);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+#endif
+	return 0;
+}
+
+DECLARE_TEST(tcp, zerocopy) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	thread_t thread;
+	char* buffer;
+	uint32_t sequence = 0;
+	size_t written = 0;
+	int ievt, num_events;
+	bool notified = false;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	if (!socket_set_zerocopy(sock_client, true)) {
+		socket_deallocate(sock_server);
+		socket_deallocate(sock_client);
+		return 0;
+	}
+	EXPECT_TRUE(socket_zerocopy(sock_client));
+
+	atomic_store32(&io_completed, 0);
+	socket_set_blocking(sock_server, true);
+	thread_initialize(&thread, drain_blocking_thread, sock_server, STRING_CONST("drain_thread"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+
+	buffer = memory_allocate(0, 4 * 1024 * 1024, 0, MEMORY_PERSISTENT);
+	memset(buffer, 0x17, 4 * 1024 * 1024);
+
+	socket_set_blocking(sock_client, true);
+	written = socket_write_zerocopy(sock_client, buffer, 4 * 1024 * 1024, &sequence);
+	EXPECT_SIZEEQ(written, 4 * 1024 * 1024);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+	start = time_current();
+	while (!(notified && socket_zerocopy_released(sock_client, sequence)) &&
+	        (time_elapsed(start) < REAL_C(10.0))) {
+		num_events = (int)network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+		for (ievt = 0; ievt < num_events; ++ievt) {
+			EXPECT_NE(events[ievt].event, NETWORKEVENT_ERROR);
+			if (events[ievt].event == NETWORKEVENT_ZEROCOPY)
+				notified = true;
+		}
+	}
+	network_poll_deallocate(poll);
+
+	EXPECT_TRUE(notified);
+	EXPECT_TRUE(socket_zerocopy_released(sock_client, sequence));
+
+	thread_finalize(&thread);
+	EXPECT_EQ(atomic_load32(&io_completed), 1);
+
+	memory_deallocate(buffer);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, batch) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	char buffer[1024];
+	size_t total = 0;
+	int iloop;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+
+	tcp_socket_begin_batch(sock_client, 0);
+	EXPECT_TRUE(tcp_socket_in_batch(sock_client));
+	for (iloop = 0; iloop < 100; ++iloop)
+		EXPECT_SIZEEQ(socket_write(sock_client, "0123456789", 10), 10);
+	tcp_socket_end_batch(sock_client);
+	EXPECT_FALSE(tcp_socket_in_batch(sock_client));
+
+	socket_set_blocking(sock_server, true);
+	while (total < 1000) {
+		size_t read = socket_read(sock_server, buffer, sizeof(buffer));
+		EXPECT_SIZEGT(read, 0);
+		total += read;
+	}
+	EXPECT_SIZEEQ(total, 1000);
+
+	//Pending data in an open batch must be pushed by the poll deadline
+	socket_set_blocking(sock_server, false);
+	tcp_socket_begin_batch(sock_client, 20);
+	EXPECT_SIZEEQ(socket_write(sock_client, "batched", 7), 7);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+	start = time_current();
+	network_poll(poll, events, sizeof(events) / sizeof(events[0]), 2000);
+	EXPECT_REALLE(time_elapsed(start), REAL_C(1.0));
+
+	start = time_current();
+	while (!socket_available_read(sock_server) && (time_elapsed(start) < REAL_C(1.0)))
+		thread_yield();
+	EXPECT_SIZEEQ(socket_read(sock_server, buffer, sizeof(buffer)), 7);
+	EXPECT_TRUE(tcp_socket_in_batch(sock_client));
+
+	//Deadline armed while the socket is registered with the poll object
+	EXPECT_SIZEEQ(socket_write(sock_client, "again", 5), 5);
+	start = time_current();
+	network_poll(poll, events, sizeof(events) / sizeof(events[0]), 2000);
+	EXPECT_REALLE(time_elapsed(start), REAL_C(1.0));
+	network_poll_deallocate(poll);
+
+	start = time_current();
+	while (!socket_available_read(sock_server) && (time_elapsed(start) < REAL_C(1.0)))
+		thread_yield();
+	EXPECT_SIZEEQ(socket_read(sock_server, buffer, sizeof(buffer)), 5);
+
+	tcp_socket_end_batch(sock_client);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, reuseport_group) {
+	socket_t* listeners[2];
+	socket_t* clients[4];
+	network_address_t* address_bind;
+	network_address_t** address_local;
+	network_address_t* address_connect = 0;
+	unsigned int port;
+	size_t accepted = 0;
+	int iaddr, asize, iclient;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	listeners[0] = tcp_socket_allocate();
+	listeners[1] = tcp_socket_allocate();
+	address_bind = network_address_ipv4_any();
+	EXPECT_TRUE(tcp_socket_listen_group(listeners, 2, address_bind));
+	memory_deallocate(address_bind);
+
+	port = network_address_ip_port(socket_address_local(listeners[0]));
+	EXPECT_NE(port, 0);
+	EXPECT_UINTEQ(network_address_ip_port(socket_address_local(listeners[1])), port);
+	EXPECT_EQ(socket_state(listeners[1]), SOCKETSTATE_LISTENING);
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address_connect = address_local[iaddr];
+			break;
+		}
+	}
+	EXPECT_NE(address_connect, 0);
+	network_address_ip_set_port(address_connect, port);
+
+	for (iclient = 0; iclient < 4; ++iclient) {
+		clients[iclient] = tcp_socket_allocate();
+		socket_connect(clients[iclient], address_connect, 0);
+	}
+
+	//Every connection must land on exactly one listener of the group
+	start = time_current();
+	while ((accepted < 4) && (time_elapsed(start) < REAL_C(2.0))) {
+		int ilisten;
+		for (ilisten = 0; ilisten < 2; ++ilisten) {
+			socket_t* sock = tcp_socket_accept(listeners[ilisten], 10);
+			if (sock) {
+#if FOUNDATION_PLATFORM_LINUX
+				EXPECT_INTGE(socket_incoming_cpu(sock), 0);
+#endif
+				++accepted;
+				socket_deallocate(sock);
+			}
+		}
+	}
+	EXPECT_SIZEEQ(accepted, 4);
+
+	for (iclient = 0; iclient < 4; ++iclient)
+		socket_deallocate(clients[iclient]);
+	network_address_array_deallocate(address_local);
+	socket_deallocate(listeners[0]);
+	socket_deallocate(listeners[1]);
+
+	//Members bound before a failing one are closed and release the shared port
+	address_bind = network_address_ipv4_any();
+	listeners[0] = tcp_socket_allocate();
+	EXPECT_TRUE(socket_bind(listeners[0], address_bind));
+	port = network_address_ip_port(socket_address_local(listeners[0]));
+	socket_deallocate(listeners[0]);
+	listeners[0] = tcp_socket_allocate();
+	listeners[1] = tcp_socket_allocate();
+	EXPECT_TRUE(socket_bind(listeners[1], address_bind));
+	network_address_ip_set_port(address_bind, port);
+	EXPECT_FALSE(tcp_socket_listen_group(listeners, 2, address_bind));
+	clients[0] = tcp_socket_allocate();
+	EXPECT_TRUE(socket_bind(clients[0], address_bind));
+	socket_deallocate(clients[0]);
+	socket_deallocate(listeners[0]);
+	socket_deallocate(listeners[1]);
+
+	//A member failing to listen closes the whole group, including listening members
+	network_address_ip_set_port(address_bind, 0);
+	listeners[0] = tcp_socket_allocate();
+	listeners[1] = udp_socket_allocate();
+	EXPECT_FALSE(tcp_socket_listen_group(listeners, 2, address_bind));
+	EXPECT_EQ(socket_state(listeners[0]), SOCKETSTATE_NOTCONNECTED);
+	EXPECT_EQ(socket_address_local(listeners[0]), 0);
+	EXPECT_EQ(socket_address_local(listeners[1]), 0);
+	socket_deallocate(listeners[0]);
+	socket_deallocate(listeners[1]);
+	memory_deallocate(address_bind);
+
+	return 0;
+}
+
+#if FOUNDATION_PLATFORM_POSIX
+
+static void*
+trace_thread(void* arg) {
+	socket_t* sock = tcp_socket_allocate();
+	network_address_t* address_bind = network_address_ipv4_any();
+	FOUNDATION_UNUSED(arg);
+	socket_bind(sock, address_bind);
+	memory_deallocate(address_bind);
+	socket_deallocate(sock);
+	return 0;
+}
+
+static uint64_t
+trace_write_threads(const char* filename) {
+	network_trace_header_t header;
+	stream_t* stream = stream_open(filename, string_length(filename), STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+	network_trace_write(stream);
+	stream_deallocate(stream);
+	stream = stream_open(filename, string_length(filename), STREAM_IN | STREAM_BINARY);
+	memset(&header, 0, sizeof(header));
+	stream_read(stream, &header, sizeof(header));
+	stream_deallocate(stream);
+	return header.threads;
+}
+
+static void
+trace_run_thread(void) {
+	thread_t thread;
+	thread_initialize(&thread, trace_thread, 0, STRING_CONST("trace"), THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+	thread_join(&thread);
+	thread_finalize(&thread);
+}
+
+#endif
+
+DECLARE_TEST(tcp, trace_thread_exit) {
+#if FOUNDATION_PLATFORM_POSIX
+	char filename[] = "/tmp/network_trace_XXXXXX";
+	uint64_t threads;
+	int fd;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	fd = mkstemp(filename);
+	EXPECT_GE(fd, 0);
+	close(fd);
+
+	network_trace_clear();
+	network_trace_enable(true);
+
+	//Ring of an exited thread is written once, then reused by the next thread
+	trace_run_thread();
+	threads = trace_write_threads(filename);
+	EXPECT_GE(threads, 1);
+	trace_run_thread();
+	EXPECT_UINTEQ(trace_write_threads(filename), threads);
+	EXPECT_UINTEQ(trace_write_threads(filename), threads - 1);
+
+	network_trace_enable(false);
+	network_trace_clear();
+	unlink(filename);
+#endif
+	return 0;
+}
+
+DECLARE_TEST(tcp, trace) {
+#if FOUNDATION_PLATFORM_POSIX
+	socket_t* sock_listen;
+	socket_t* sock_client;
+	socket_t* sock_server;
+	network_address_t* address_bind;
+	network_address_t** address_local;
+	network_address_t* address_connect = 0;
+	network_trace_header_t header;
+	network_trace_record_t record;
+	stream_t* stream;
+	char filename[] = "/tmp/network_trace_XXXXXX";
+	char buffer[128];
+	unsigned int seen = 0;
+	uint64_t block[2];
+	uint64_t irec;
+	size_t written;
+	int iaddr, asize, fd;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	fd = mkstemp(filename);
+	EXPECT_GE(fd, 0);
+	close(fd);
+
+	network_trace_clear();
+	network_trace_enable(true);
+	EXPECT_TRUE(network_trace_is_enabled());
+
+	sock_listen = tcp_socket_allocate();
+	address_bind = network_address_ipv4_any();
+	EXPECT_TRUE(socket_bind(sock_listen, address_bind));
+	EXPECT_TRUE(tcp_socket_listen(sock_listen));
+	memory_deallocate(address_bind);
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address_connect = address_local[iaddr];
+			break;
+		}
+	}
+	EXPECT_NE(address_connect, 0);
+	network_address_ip_set_port(address_connect,
+	                            network_address_ip_port(socket_address_local(sock_listen)));
+
+	sock_client = tcp_socket_allocate();
+	socket_set_blocking(sock_client, true);
+	EXPECT_TRUE(socket_connect(sock_client, address_connect, 2000));
+	sock_server = tcp_socket_accept(sock_listen, 2000);
+	EXPECT_NE(sock_server, 0);
+	network_address_array_deallocate(address_local);
+
+	memset(buffer, 1, sizeof(buffer));
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(socket_write(sock_client, buffer, sizeof(buffer)), sizeof(buffer));
+	EXPECT_SIZEEQ(socket_read(sock_server, buffer, sizeof(buffer)), sizeof(buffer));
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+	socket_deallocate(sock_listen);
+
+	network_trace_enable(false);
+	EXPECT_FALSE(network_trace_is_enabled());
+
+	stream = stream_open(filename, string_length(filename), STREAM_OUT | STREAM_BINARY | STREAM_TRUNCATE);
+	EXPECT_NE(stream, 0);
+	written = network_trace_write(stream);
+	EXPECT_GE(written, 8);
+	stream_deallocate(stream);
+
+	//Every lifecycle event must have been recorded on the test thread
+	stream = stream_open(filename, string_length(filename), STREAM_IN | STREAM_BINARY);
+	EXPECT_NE(stream, 0);
+	EXPECT_SIZEEQ(stream_read(stream, &header, sizeof(header)), sizeof(header));
+	EXPECT_UINTEQ(header.magic, NETWORK_TRACE_MAGIC);
+	EXPECT_UINTEQ(header.version, NETWORK_TRACE_VERSION);
+	EXPECT_GE(header.threads, 1);
+	while (stream_read(stream, block, sizeof(block)) == sizeof(block)) {
+		for (irec = 0; irec < block[1]; ++irec) {
+			EXPECT_SIZEEQ(stream_read(stream, &record, sizeof(record)), sizeof(record));
+			EXPECT_GE(record.time, header.tick_base);
+			if ((record.event == NETWORKTRACE_WRITE) || (record.event == NETWORKTRACE_READ))
+				EXPECT_UINTEQ(record.bytes, sizeof(buffer));
+			seen |= 1U << record.event;
+		}
+	}
+	stream_deallocate(stream);
+	unlink(filename);
+
+	EXPECT_UINTEQ(seen, (1U << NETWORKTRACE_OPEN) | (1U << NETWORKTRACE_BIND) | (1U << NETWORKTRACE_CONNECT) |
+	              (1U << NETWORKTRACE_LISTEN) | (1U << NETWORKTRACE_ACCEPT) | (1U << NETWORKTRACE_READ) |
+	              (1U << NETWORKTRACE_WRITE) | (1U << NETWORKTRACE_CLOSE));
+	EXPECT_CONSTSTRINGEQ(network_trace_event_name(NETWORKTRACE_ACCEPT), string_const(STRING_CONST("accept")));
+
+	network_trace_clear();
+#endif
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_ring) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	stream_t* stream_client;
+	stream_t* stream_server;
+	uint8_t buffer[333];
+	size_t offset, total, ibyte;
+	int iloop;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	//Odd sized writes and reads make both rings wrap at varying positions
+	stream_client = socket_stream(sock_client);
+	total = 0;
+	for (iloop = 0; iloop < 64; ++iloop) {
+		for (ibyte = 0; ibyte < sizeof(buffer); ++ibyte)
+			buffer[ibyte] = (uint8_t)((total + ibyte) * 7);
+		EXPECT_SIZEEQ(stream_write(stream_client, buffer, sizeof(buffer)), sizeof(buffer));
+		total += sizeof(buffer);
+	}
+	stream_flush(stream_client);
+
+	stream_server = socket_stream(sock_server);
+	for (offset = 0; offset < total;) {
+		size_t want = (total - offset < 250) ? total - offset : 250;
+		stream_buffer_read(stream_server);
+		EXPECT_SIZEEQ(stream_read(stream_server, buffer, want), want);
+		for (ibyte = 0; ibyte < want; ++ibyte)
+			EXPECT_UINTEQ(buffer[ibyte], (uint8_t)((offset + ibyte) * 7));
+		offset += want;
+	}
+
+	stream_deallocate(stream_client);
+	stream_deallocate(stream_server);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_peek) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	stream_t* stream_client;
+	stream_t* stream_server;
+	socket_stream_view_t view;
+	uint8_t buffer[300];
+	uint16_t length;
+	size_t ibyte;
+	int iloop;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	//Length prefixed messages of varying size so frames straddle the ring wrap point
+	stream_client = socket_stream(sock_client);
+	for (iloop = 0; iloop < 64; ++iloop) {
+		length = (uint16_t)(17 + ((iloop * 37) % 250));
+		memset(buffer, iloop, length);
+		EXPECT_SIZEEQ(stream_write(stream_client, &length, sizeof(length)), sizeof(length));
+		EXPECT_SIZEEQ(stream_write(stream_client, buffer, length), length);
+	}
+	stream_flush(stream_client);
+
+	stream_server = socket_stream(sock_server);
+	for (iloop = 0; iloop < 64; ++iloop) {
+		const uint8_t* payload;
+		view = socket_stream_peek(stream_server, sizeof(length));
+		EXPECT_GE(view.length, sizeof(length));
+		memcpy(&length, view.buffer, sizeof(length));
+		EXPECT_UINTEQ(length, 17 + ((iloop * 37) % 250));
+
+		view = socket_stream_peek(stream_server, sizeof(length) + length);
+		EXPECT_GE(view.length, sizeof(length) + length);
+		payload = pointer_offset_const(view.buffer, sizeof(length));
+		for (ibyte = 0; ibyte < length; ++ibyte)
+			EXPECT_UINTEQ(payload[ibyte], (uint8_t)iloop);
+		EXPECT_SIZEEQ(socket_stream_consume(stream_server, sizeof(length) + length), sizeof(length) + length);
+	}
+	EXPECT_SIZEEQ(socket_stream_consume(stream_server, 1), 0);
+
+	stream_deallocate(stream_client);
+	stream_deallocate(stream_server);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_buffer_size) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	stream_t* stream_client;
+	stream_t* stream_server;
+	uint8_t buffer[4096];
+	size_t offset, total;
+	int iloop;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	EXPECT_SIZEEQ(socket_stream_read_buffer_size(sock_client), 1024);
+	socket_set_stream_buffer_size(sock_client, 512, 8192);
+	EXPECT_SIZEEQ(socket_stream_read_buffer_size(sock_client), 512);
+	EXPECT_SIZEEQ(socket_stream_write_buffer_size(sock_client), 8192);
+
+	//Pending output survives a resize of the live stream
+	stream_client = socket_stream(sock_client);
+	memset(buffer, 0x5a, sizeof(buffer));
+	EXPECT_SIZEEQ(stream_write(stream_client, buffer, 3000), 3000);
+	socket_set_stream_buffer_size(sock_client, 512, 1024);
+	EXPECT_SIZEEQ(socket_stream_write_buffer_size(sock_client), 3000);
+
+	total = 3000;
+	for (iloop = 0; iloop < 8; ++iloop) {
+		EXPECT_SIZEEQ(stream_write(stream_client, buffer, sizeof(buffer)), sizeof(buffer));
+		total += sizeof(buffer);
+	}
+	stream_flush(stream_client);
+
+	//Reads filling the buffer grow it toward the autotune limit
+	socket_set_stream_buffer_autotune(sock_server, 16384);
+	stream_server = socket_stream(sock_server);
+	for (offset = 0; offset < total;) {
+		size_t want = (total - offset < 512) ? total - offset : 512;
+		EXPECT_SIZEEQ(stream_read(stream_server, buffer, want), want);
+		EXPECT_UINTEQ(buffer[0], 0x5a);
+		EXPECT_UINTEQ(buffer[want - 1], 0x5a);
+		offset += want;
+	}
+	EXPECT_GT(socket_stream_read_buffer_size(sock_server), 1024);
+	EXPECT_LE(socket_stream_read_buffer_size(sock_server), 16384);
+
+	stream_deallocate(stream_client);
+	stream_deallocate(stream_server);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+static void*
+stream_buffer_thread(void* arg) {
+	stream_t* stream = arg;
+	uint8_t buffer[200];
+	if (stream_read(stream, buffer, sizeof(buffer)) != sizeof(buffer))
+		return (void*)1;
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_buffer_pool) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	stream_t* stream_client;
+	stream_t* stream_server;
+	network_buffer_pool_usage_t usage;
+	uint8_t buffer[200];
+	thread_t thread;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	//Idle streams hold no buffers
+	stream_client = socket_stream(sock_client);
+	stream_server = socket_stream(sock_server);
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.buffers, 0);
+
+	memset(buffer, 0x33, sizeof(buffer));
+	EXPECT_SIZEEQ(stream_write(stream_client, buffer, sizeof(buffer)), sizeof(buffer));
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.buffers, 1);
+	EXPECT_GE(usage.in_use, 1024);
+	stream_flush(stream_client);
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.buffers, 0);
+
+	//Partially consumed input keeps the buffer until drained
+	EXPECT_SIZEEQ(stream_read(stream_server, buffer, 50), 50);
+	EXPECT_SIZEEQ(network_buffer_pool_usage().buffers, 1);
+	EXPECT_SIZEEQ(stream_read(stream_server, buffer, 150), 150);
+	EXPECT_UINTEQ(buffer[149], 0x33);
+
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.buffers, 0);
+	EXPECT_SIZEEQ(usage.in_use, 0);
+	EXPECT_GT(usage.cached, 0);
+	EXPECT_SIZEEQ(usage.allocated, usage.cached);
+
+	EXPECT_SIZEEQ(network_buffer_pool_trim(0), usage.cached);
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.cached, 0);
+	EXPECT_SIZEEQ(usage.allocated, 0);
+
+	//Buffers cached by an exited thread return to the shared pool
+	thread_initialize(&thread, stream_buffer_thread, stream_server, STRING_CONST("stream_buffer"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	EXPECT_SIZEEQ(stream_write(stream_client, buffer, sizeof(buffer)), sizeof(buffer));
+	stream_flush(stream_client);
+	thread_start(&thread);
+	EXPECT_EQ(thread_join(&thread), 0);
+	thread_finalize(&thread);
+	usage = network_buffer_pool_usage();
+	EXPECT_SIZEEQ(usage.buffers, 0);
+	EXPECT_GT(usage.cached, 0);
+	EXPECT_SIZEEQ(network_buffer_pool_trim(0), usage.cached);
+	EXPECT_SIZEEQ(network_buffer_pool_usage().allocated, 0);
+
+	stream_deallocate(stream_client);
+	stream_deallocate(stream_server);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_large_read) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	stream_t* stream_server;
+	uint8_t* buffer;
+	size_t total = 20000;
+	size_t reads[3] = { 5000, 100, 14900 };
+	size_t offset, ibyte, iread;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	buffer = memory_allocate(0, total, 0, MEMORY_TEMPORARY);
+	for (ibyte = 0; ibyte < total; ++ibyte)
+		buffer[ibyte] = (uint8_t)(ibyte * 13);
+	EXPECT_SIZEEQ(socket_write(sock_client, buffer, total), total);
+
+	//Reads larger than the stream buffer go directly into the destination
+	stream_server = socket_stream(sock_server);
+	for (iread = 0, offset = 0; iread < 3; ++iread) {
+		memset(buffer, 0, reads[iread]);
+		EXPECT_SIZEEQ(stream_read(stream_server, buffer, reads[iread]), reads[iread]);
+		for (ibyte = 0; ibyte < reads[iread]; ++ibyte)
+			EXPECT_UINTEQ(buffer[ibyte], (uint8_t)((offset + ibyte) * 13));
+		offset += reads[iread];
+	}
+	EXPECT_SIZEEQ(network_buffer_pool_usage().buffers, 0);
+	EXPECT_SIZEEQ(socket_stream_peek(stream_server, 0).length, 0);
+
+	memory_deallocate(buffer);
+	stream_deallocate(stream_server);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, framer) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	socket_framer_t* framer_client;
+	socket_framer_t* framer_server;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	socket_frame_t frames[40];
+	socket_frame_t frame;
+	uint8_t* buffer;
+	size_t received = 0;
+	size_t iframe, ibyte, offset;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+
+	//Message i has size i * 53, messages larger than the stream buffer are assembled in framer memory
+	buffer = memory_allocate(0, 53 * 40 * 40 / 2, 0, MEMORY_TEMPORARY);
+	for (iframe = 0, offset = 0; iframe < 40; ++iframe) {
+		frames[iframe].data = buffer + offset;
+		frames[iframe].size = iframe * 53;
+		for (ibyte = 0; ibyte < frames[iframe].size; ++ibyte)
+			buffer[offset + ibyte] = (uint8_t)(iframe + ibyte);
+		offset += frames[iframe].size;
+	}
+
+	framer_client = socket_framer_allocate(sock_client, SOCKETFRAME_PREFIX_VARINT, 8192);
+	framer_server = socket_framer_allocate(sock_server, SOCKETFRAME_PREFIX_VARINT, 8192);
+	EXPECT_SIZEEQ(socket_framer_write_batch(framer_client, frames, 20), 20);
+	EXPECT_SIZEEQ(socket_framer_write_batch(framer_client, frames + 20, 20), 20);
+	EXPECT_SIZEEQ(socket_framer_write_batch(framer_client, frames, 0), 0);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_server);
+	start = time_current();
+	while ((received < 40) && (time_elapsed(start) < REAL_C(5.0))) {
+		size_t ievent, num_events = network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+		for (ievent = 0; ievent < num_events; ++ievent) {
+			if (events[ievent].event != NETWORKEVENT_DATAIN)
+				continue;
+			while (socket_framer_read(framer_server, &frame)) {
+				const uint8_t* data = frame.data;
+				EXPECT_SIZEEQ(frame.size, received * 53);
+				for (ibyte = 0; ibyte < frame.size; ++ibyte)
+					EXPECT_UINTEQ(data[ibyte], (uint8_t)(received + ibyte));
+				++received;
+			}
+		}
+	}
+	EXPECT_SIZEEQ(received, 40);
+
+	//Oversized message closes the receiving socket
+	EXPECT_TRUE(socket_framer_write(framer_client, buffer, 131));
+	memset(buffer, 0, 16);
+	EXPECT_TRUE(socket_framer_write(framer_client, buffer, 16));
+	framer_server->max_size = 100;
+	start = time_current();
+	while ((socket_state(sock_server) == SOCKETSTATE_CONNECTED) && (time_elapsed(start) < REAL_C(5.0))) {
+		network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+		EXPECT_FALSE(socket_framer_read(framer_server, &frame));
+	}
+	EXPECT_NE(socket_state(sock_server), SOCKETSTATE_CONNECTED);
+	network_poll_deallocate(poll);
+
+	socket_framer_deallocate(framer_client);
+	socket_framer_deallocate(framer_server);
+	memory_deallocate(buffer);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, framer_transform) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	socket_framer_t* framer_client;
+	socket_framer_t* framer_server;
+	socket_frame_t frames[40];
+	socket_frame_t frame;
+	uint8_t* buffer;
+	size_t received = 0;
+	size_t iframe, ibyte, offset;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, true);
+	socket_set_blocking(sock_server, true);
+
+	buffer = memory_allocate(0, 211 * 40 * 40 / 2, 0, MEMORY_TEMPORARY);
+	for (iframe = 0, offset = 0; iframe < 40; ++iframe) {
+		frames[iframe].data = buffer + offset;
+		frames[iframe].size = iframe * 211;
+		for (ibyte = 0; ibyte < frames[iframe].size; ++ibyte)
+			buffer[offset + ibyte] = (uint8_t)(iframe + (ibyte / 64));
+		offset += frames[iframe].size;
+	}
+
+	//Frames are written through the transforms and parsed from decoded data, also when
+	//a prefix or message straddles chunks
+	EXPECT_TRUE(socket_stream_add_transform(socket_stream(sock_client), socket_transform_lz()));
+	EXPECT_TRUE(socket_stream_add_transform(socket_stream(sock_client), socket_transform_crc32c()));
+	EXPECT_TRUE(socket_stream_add_transform(socket_stream(sock_server), socket_transform_lz()));
+	EXPECT_TRUE(socket_stream_add_transform(socket_stream(sock_server), socket_transform_crc32c()));
+	framer_client = socket_framer_allocate(sock_client, SOCKETFRAME_PREFIX_VARINT, 16384);
+	framer_server = socket_framer_allocate(sock_server, SOCKETFRAME_PREFIX_VARINT, 16384);
+	EXPECT_SIZEEQ(socket_framer_write_batch(framer_client, frames, 20), 20);
+	for (iframe = 20; iframe < 40; ++iframe)
+		EXPECT_TRUE(socket_framer_write(framer_client, frames[iframe].data, frames[iframe].size));
+
+	start = time_current();
+	while ((received < 40) && (time_elapsed(start) < REAL_C(5.0))) {
+		const uint8_t* data;
+		if (!socket_framer_read(framer_server, &frame))
+			break;
+		data = frame.data;
+		EXPECT_SIZEEQ(frame.size, received * 211);
+		for (ibyte = 0; ibyte < frame.size; ++ibyte)
+			EXPECT_UINTEQ(data[ibyte], (uint8_t)(received + (ibyte / 64)));
+		++received;
+	}
+	EXPECT_SIZEEQ(received, 40);
+	EXPECT_SIZELE(sock_client->bytes_written, offset / 2);
+
+	socket_framer_deallocate(framer_client);
+	socket_framer_deallocate(framer_server);
+	memory_deallocate(buffer);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, framer_partial) {
+	socket_t* sock_client;
+	socket_t* sock_server;
+	socket_framer_t* framer_client;
+	socket_framer_t* framer_server;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	socket_frame_t frames[64];
+	socket_frame_t frame;
+	uint8_t* buffer;
+	size_t sent = 0, received = 0, mismatch = 0;
+	size_t iframe, ibyte;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	//Non-blocking client without a send queue, messages far larger than the kernel buffer
+	//are cut short and must still arrive whole and in order
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_client, false);
+
+	buffer = memory_allocate(0, 65536 + 64, 0, MEMORY_TEMPORARY);
+	for (ibyte = 0; ibyte < 65536 + 64; ++ibyte)
+		buffer[ibyte] = (uint8_t)(ibyte * 7);
+	for (iframe = 0; iframe < 64; ++iframe) {
+		frames[iframe].data = buffer + iframe;
+		frames[iframe].size = 65536 - iframe;
+	}
+
+	framer_client = socket_framer_allocate(sock_client, SOCKETFRAME_PREFIX_FIXED32, 65536);
+	framer_server = socket_framer_allocate(sock_server, SOCKETFRAME_PREFIX_FIXED32, 65536);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_server);
+	start = time_current();
+	while ((received < 64) && (time_elapsed(start) < REAL_C(10.0))) {
+		size_t ievent, num_events;
+		sent += socket_framer_write_batch(framer_client, frames + sent, 64 - sent);
+		num_events = network_poll(poll, events, sizeof(events) / sizeof(events[0]), 10);
+		for (ievent = 0; ievent < num_events; ++ievent) {
+			if (events[ievent].event != NETWORKEVENT_DATAIN)
+				continue;
+			while (socket_framer_read(framer_server, &frame)) {
+				const uint8_t* data = frame.data;
+				EXPECT_SIZEEQ(frame.size, 65536 - received);
+				for (ibyte = 0; ibyte < frame.size; ++ibyte) {
+					if (data[ibyte] != (uint8_t)((received + ibyte) * 7))
+						++mismatch;
+				}
+				++received;
+			}
+		}
+	}
+	EXPECT_SIZEEQ(sent, 64);
+	EXPECT_SIZEEQ(received, 64);
+	EXPECT_SIZEEQ(mismatch, 0);
+	EXPECT_EQ(socket_state(sock_server), SOCKETSTATE_CONNECTED);
+
+	network_poll_deallocate(poll);
+	socket_framer_deallocate(framer_client);
+	socket_framer_deallocate(framer_server);
+	memory_deallocate(buffer);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_nonblocking_write) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	stream_t* stream;
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	thread_t thread;
+	char buffer[64 * 1024];
+	int iloop;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	atomic_store32(&io_completed, 0);
+
+	stream = socket_stream(sock_client);
+	socket_stream_set_nonblocking_write(stream, true);
+	EXPECT_SIZEEQ(socket_stream_pending_write(stream), 0);
+
+	//Writes must be accepted without stalling even though the peer is not reading
+	memset(buffer, 0x5a, sizeof(buffer));
+	start = time_current();
+	for (iloop = 0; iloop < 64; ++iloop) {
+		EXPECT_SIZEEQ(stream_write(stream, buffer, 100), 100);
+		EXPECT_SIZEEQ(stream_write(stream, buffer, sizeof(buffer) - 100), sizeof(buffer) - 100);
+	}
+	stream_flush(stream);
+	EXPECT_REALLE(time_elapsed(start), REAL_C(2.0));
+	EXPECT_SIZEGT(socket_stream_pending_write(stream), 0);
+
+	socket_set_blocking(sock_server, true);
+	thread_initialize(&thread, drain_blocking_thread, sock_server, STRING_CONST("drain_thread"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+	start = time_current();
+	while (socket_stream_pending_write(stream) && (time_elapsed(start) < REAL_C(10.0)))
+		network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+	network_poll_deallocate(poll);
+	EXPECT_SIZEEQ(socket_stream_pending_write(stream), 0);
+
+	thread_finalize(&thread);
+	EXPECT_EQ(atomic_load32(&io_completed), 1);
+
+	//Disabling removes the send queue installed for non-blocking writes, but not one set by the user
+	socket_stream_set_nonblocking_write(stream, false);
+	EXPECT_EQ(sock_client->queue, 0);
+	socket_set_send_queue(sock_client, 4096, 1024, 0);
+	socket_stream_set_nonblocking_write(stream, true);
+	socket_stream_set_nonblocking_write(stream, false);
+	EXPECT_NE(sock_client->queue, 0);
+	socket_set_send_queue(sock_client, 0, 0, 0);
+
+	//Deallocating the stream removes its queue right away when empty
+	socket_stream_set_nonblocking_write(stream, true);
+	EXPECT_NE(sock_client->queue, 0);
+	stream_deallocate(stream);
+	EXPECT_EQ(sock_client->queue, 0);
+
+	//and once drained when data is still queued, small kernel buffers keep data in the queue
+	socket_set_send_buffer_size(sock_client, 65536);
+	socket_set_receive_buffer_size(sock_server, 65536);
+	stream = socket_stream(sock_client);
+	socket_stream_set_nonblocking_write(stream, true);
+	for (iloop = 0; iloop < 64; ++iloop)
+		EXPECT_SIZEEQ(stream_write(stream, buffer, sizeof(buffer)), sizeof(buffer));
+	stream_flush(stream);
+	EXPECT_SIZEGT(socket_send_queue_size(sock_client), 0);
+	stream_deallocate(stream);
+	EXPECT_NE(sock_client->queue, 0);
+
+	thread_initialize(&thread, drain_blocking_thread, sock_server, STRING_CONST("drain_thread"),
+	                  THREAD_PRIORITY_NORMAL, 0);
+	thread_start(&thread);
+	poll = network_poll_allocate(1);
+	network_poll_add_socket(poll, sock_client);
+	start = time_current();
+	while (sock_client->queue && (time_elapsed(start) < REAL_C(10.0)))
+		network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+	network_poll_deallocate(poll);
+	EXPECT_EQ(sock_client->queue, 0);
+	thread_finalize(&thread);
+	EXPECT_EQ(atomic_load32(&io_completed), 2);
+
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(tcp, stream_transform) {
+	socket_t* sock_server = 0;
+	socket_t* sock_client = 0;
+	stream_t* stream_server;
+	stream_t* stream_client;
+	const socket_transform_t* lz = socket_transform_lz();
+	const socket_transform_t* crc = socket_transform_crc32c();
+	uint8_t* plain;
+	uint8_t* encoded;
+	uint8_t* decoded;
+	size_t size = 256 * 1024;
+	size_t random_size = 32 * 1024;
+	size_t bound, length, ibyte, read_size;
+	uint8_t header[8];
+	uint32_t seed = 0x9e3779b9U;
+
+	plain = memory_allocate(0, size + random_size, 0, MEMORY_PERSISTENT);
+	decoded = memory_allocate(0, size + random_size, 0, MEMORY_PERSISTENT);
+	for (ibyte = 0; ibyte < size; ++ibyte)
+		plain[ibyte] = (uint8_t)("network transform pipeline "[(ibyte / 3) % 27] + (ibyte / 4096));
+	for (; ibyte < size + random_size; ++ibyte) {
+		//Incompressible tail from a xorshift generator
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		plain[ibyte] = (uint8_t)seed;
+	}
+
+	//Direct round trips through the built-in transforms
+	bound = lz->bound(lz, size);
+	encoded = memory_allocate(0, bound, 0, MEMORY_PERSISTENT);
+	length = lz->encode(lz, plain, size, encoded, bound);
+	EXPECT_SIZEGT(length, 0);
+	EXPECT_SIZELE(length, size / 4);
+	EXPECT_SIZEEQ(lz->decode(lz, encoded, length, decoded, size), size);
+	EXPECT_EQ(memcmp(plain, decoded, size), 0);
+	EXPECT_SIZEEQ(lz->decode(lz, encoded, length, decoded, size - 1), 0);
+
+	length = crc->encode(crc, plain, 1000, encoded, bound);
+	EXPECT_SIZEEQ(length, 1004);
+	EXPECT_SIZEEQ(crc->decode(crc, encoded, length, decoded, size), 1000);
+	encoded[500] ^= 0x10;
+	EXPECT_SIZEEQ(crc->decode(crc, encoded, length, decoded, size), 0);
+	EXPECT_UINTEQ(network_crc32c(0, "123456789", 9), 0xE3069283U);
+	memory_deallocate(encoded);
+
+	if (!network_supports_ipv4()) {
+		memory_deallocate(plain);
+		memory_deallocate(decoded);
+		return 0;
+	}
+
+	EXPECT_TRUE(tcp_connected_pair(NETWORK_ADDRESSFAMILY_IPV4, &sock_server, &sock_client));
+	socket_set_blocking(sock_server, true);
+	socket_set_blocking(sock_client, true);
+
+	stream_server = socket_stream(sock_server);
+	stream_client = socket_stream(sock_client);
+	EXPECT_TRUE(socket_stream_add_transform(stream_client, lz));
+	EXPECT_TRUE(socket_stream_add_transform(stream_client, crc));
+	EXPECT_TRUE(socket_stream_add_transform(stream_server, lz));
+	EXPECT_TRUE(socket_stream_add_transform(stream_server, crc));
+
+	EXPECT_SIZEEQ(stream_write(stream_client, plain, size + random_size), size + random_size);
+	stream_flush(stream_client);
+	EXPECT_SIZEEQ(socket_stream_pending_write(stream_client), 0);
+	//Compressed chunks put far fewer bytes on the wire than were written
+	EXPECT_SIZELE(sock_client->bytes_written, (size / 4) + random_size + 4096);
+
+	memset(decoded, 0, size + random_size);
+	EXPECT_SIZEEQ(stream_read(stream_server, decoded, 100), 100);
+	EXPECT_SIZEEQ(stream_read(stream_server, decoded + 100, size + random_size - 100), size + random_size - 100);
+	EXPECT_EQ(memcmp(plain, decoded, size + random_size), 0);
+
+	//Chunks from a peer with a larger write buffer need a raised limit, and their buffers
+	//are released once consumed
+	read_size = socket_stream_read_buffer_size(sock_server);
+	socket_set_stream_buffer_size(sock_client, 0, 65536);
+	socket_stream_set_chunk_limit(stream_server, 65536);
+	EXPECT_SIZEEQ(stream_write(stream_client, plain, 65536), 65536);
+	stream_flush(stream_client);
+	memset(decoded, 0, 65536);
+	EXPECT_SIZEEQ(stream_read(stream_server, decoded, 65536), 65536);
+	EXPECT_EQ(memcmp(plain, decoded, 65536), 0);
+	EXPECT_SIZEEQ(((socket_stream_t*)stream_server)->chunk_in_capacity, 0);
+	EXPECT_SIZEEQ(socket_stream_read_buffer_size(sock_server), read_size);
+
+	//Chunk header above the default limit closes the socket without growing buffers
+	socket_stream_set_chunk_limit(stream_server, 0);
+	memset(header, 0, sizeof(header));
+	header[0] = 0x10;
+	header[6] = 0x10;
+	EXPECT_SIZEEQ(socket_write(sock_client, header, sizeof(header)), sizeof(header));
+	EXPECT_SIZEEQ(stream_read(stream_server, decoded, 100), 0);
+	EXPECT_NE(socket_state(sock_server), SOCKETSTATE_CONNECTED);
+	EXPECT_SIZEEQ(socket_stream_read_buffer_size(sock_server), read_size);
+
+	stream_deallocate(stream_server);
+	stream_deallocate(stream_client);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+	memory_deallocate(plain);
+	memory_deallocate(decoded);
+
+	return 0;
+}
+
 void
 test_tcp_declare(void) {
 	ADD_TEST(tcp, connect_ipv4);
@@ -632,6 +2018,25 @@ test_tcp_declare(void) {
 	ADD_TEST(tcp, io_ipv6);
 	ADD_TEST(tcp, stream_ipv4);
 	ADD_TEST(tcp, stream_ipv6);
+	ADD_TEST(tcp, accept_nonblocking);
+	ADD_TEST(tcp, send_queue);
+	ADD_TEST(tcp, vectored_io);
+	ADD_TEST(tcp, send_file);
+	ADD_TEST(tcp, zerocopy);
+	ADD_TEST(tcp, batch);
+	ADD_TEST(tcp, reuseport_group);
+	ADD_TEST(tcp, trace);
+	ADD_TEST(tcp, trace_thread_exit);
+	ADD_TEST(tcp, stream_ring);
+	ADD_TEST(tcp, stream_peek);
+	ADD_TEST(tcp, stream_buffer_size);
+	ADD_TEST(tcp, stream_buffer_pool);
+	ADD_TEST(tcp, stream_large_read);
+	ADD_TEST(tcp, framer);
+	ADD_TEST(tcp, framer_transform);
+	ADD_TEST(tcp, framer_partial);
+	ADD_TEST(tcp, stream_nonblocking_write);
+	ADD_TEST(tcp, stream_transform);
 }
 
 test_suite_t test_tcp_suite = {
@@ -14,6 +14,11 @@
 #include <foundation/foundation.h>
 #include <test/test.h>
 
+#if FOUNDATION_PLATFORM_POSIX
+#  include <stdlib.h>
+#  include <unistd.h>
+#endif
+
 typedef struct _test_datagram_arg {
 	socket_t*          sock;
 	network_address_t* target;
@@ -509,12 +514,845 @@ DECLARE_TEST(udp, datagram_ipv6) {
 	return 0;
 }
 
+DECLARE_TEST(udp, datagram_vectored) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	const network_address_t* address_from = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	socket_iovec_t iov[3];
+	char header[8] = "datagram";
+	char payload[500];
+	char trailer[4] = "done";
+	char buffer[1024];
+	int iaddr, asize;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	memset(payload, 0x33, sizeof(payload));
+	iov[0].buffer = header;  iov[0].length = sizeof(header);
+	iov[1].buffer = payload; iov[1].length = sizeof(payload);
+	iov[2].buffer = trailer; iov[2].length = sizeof(trailer);
+	EXPECT_SIZEEQ(udp_socket_sendtov(sock_client, iov, 3, address),
+	              sizeof(header) + sizeof(payload) + sizeof(trailer));
+
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer, sizeof(buffer), &address_from),
+	              sizeof(header) + sizeof(payload) + sizeof(trailer));
+	EXPECT_NE(address_from, 0);
+	EXPECT_EQ(memcmp(buffer, header, sizeof(header)), 0);
+	EXPECT_EQ(memcmp(buffer + sizeof(header), payload, sizeof(payload)), 0);
+	EXPECT_EQ(memcmp(buffer + sizeof(header) + sizeof(payload), trailer, sizeof(trailer)), 0);
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, datagram_batch) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	udp_datagram_t datagrams[16];
+	char buffer[16][256];
+	char payload[256];
+	size_t received = 0;
+	size_t count, idgram;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	for (idgram = 0; idgram < 40; ++idgram) {
+		memset(payload, (int)idgram, sizeof(payload));
+		EXPECT_SIZEEQ(udp_socket_sendto(sock_client, payload, 10 + idgram, address), 10 + idgram);
+	}
+
+	for (idgram = 0; idgram < 16; ++idgram) {
+		datagrams[idgram].buffer = buffer[idgram];
+		datagrams[idgram].capacity = sizeof(buffer[idgram]);
+	}
+
+	//Datagrams arrive in order, possibly spread over several batches
+	start = time_current();
+	while ((received < 40) && (time_elapsed(start) < REAL_C(5.0))) {
+		count = udp_socket_recvfrom_batch(sock_server, datagrams, 16);
+		EXPECT_SIZELE(count, 16);
+		for (idgram = 0; idgram < count; ++idgram, ++received) {
+			EXPECT_SIZEEQ(datagrams[idgram].size, 10 + received);
+			EXPECT_EQ(buffer[idgram][0], (char)received);
+			EXPECT_EQ(buffer[idgram][datagrams[idgram].size - 1], (char)received);
+			EXPECT_NE(datagrams[idgram].address, 0);
+			EXPECT_EQ(network_address_ip_port(datagrams[idgram].address),
+			          network_address_ip_port(socket_address_local(sock_client)));
+		}
+		if (!count)
+			thread_yield();
+	}
+	EXPECT_SIZEEQ(received, 40);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_batch(sock_server, datagrams, 16), 0);
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, datagram_send_batch) {
+	network_address_t** address_local = 0;
+	network_address_t* address[2] = {0, 0};
+	socket_t* sock_server[2];
+	socket_t* sock_client;
+	udp_datagram_t datagrams[100];
+	char payload[100][64];
+	char buffer[128];
+	const network_address_t* address_from = 0;
+	size_t idgram, iserver;
+	int iaddr, asize;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server[0] = udp_socket_allocate();
+	sock_server[1] = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address[0] = network_address_clone(address_local[iaddr]);
+			address[1] = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address[0], 0);
+
+	for (iserver = 0; iserver < 2; ++iserver) {
+		network_address_ip_set_port(address[iserver], 0);
+		EXPECT_TRUE(socket_bind(sock_server[iserver], address[iserver]));
+		network_address_ip_set_port(address[iserver],
+		                            network_address_ip_port(socket_address_local(sock_server[iserver])));
+		socket_set_blocking(sock_server[iserver], true);
+	}
+
+	//More datagrams than a single system call takes, alternating destinations
+	for (idgram = 0; idgram < 100; ++idgram) {
+		memset(payload[idgram], (int)idgram, sizeof(payload[idgram]));
+		datagrams[idgram].buffer = payload[idgram];
+		datagrams[idgram].size = 1 + (idgram % sizeof(payload[idgram]));
+		datagrams[idgram].address = address[idgram % 2];
+	}
+	EXPECT_SIZEEQ(udp_socket_sendto_batch(sock_client, datagrams, 100), 100);
+	EXPECT_NE(socket_address_local(sock_client), 0);
+
+	for (idgram = 0; idgram < 100; ++idgram) {
+		EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server[idgram % 2], buffer, sizeof(buffer), &address_from),
+		              datagrams[idgram].size);
+		EXPECT_EQ(buffer[0], (char)idgram);
+		EXPECT_EQ(network_address_ip_port(address_from), network_address_ip_port(socket_address_local(sock_client)));
+	}
+
+	EXPECT_SIZEEQ(udp_socket_sendto_batch(sock_client, datagrams, 0), 0);
+
+	memory_deallocate(address[0]);
+	memory_deallocate(address[1]);
+	socket_deallocate(sock_server[0]);
+	socket_deallocate(sock_server[1]);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, datagram_segmented) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	udp_datagram_t datagrams[16];
+	char buffer[16][2048];
+	char* payload;
+	size_t segment = 1000;
+	size_t size = 200 * 1000 + 300;
+	size_t received = 0;
+	size_t offset = 0;
+	size_t count, idgram, ibyte;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+	socket_set_receive_buffer_size(sock_server, 1024 * 1024);
+
+	payload = memory_allocate(0, size, 0, MEMORY_PERSISTENT);
+	for (ibyte = 0; ibyte < size; ++ibyte)
+		payload[ibyte] = (char)(ibyte / segment);
+
+	//Spans several offload sends, the last datagram carries the remainder
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, payload, size, segment, address), size);
+
+	for (idgram = 0; idgram < 16; ++idgram) {
+		datagrams[idgram].buffer = buffer[idgram];
+		datagrams[idgram].capacity = sizeof(buffer[idgram]);
+	}
+	start = time_current();
+	while ((offset < size) && (time_elapsed(start) < REAL_C(5.0))) {
+		count = udp_socket_recvfrom_batch(sock_server, datagrams, 16);
+		for (idgram = 0; idgram < count; ++idgram, ++received) {
+			EXPECT_SIZEEQ(datagrams[idgram].size, (size - offset < segment) ? (size - offset) : segment);
+			EXPECT_EQ(memcmp(buffer[idgram], payload + offset, datagrams[idgram].size), 0);
+			offset += datagrams[idgram].size;
+		}
+		if (!count)
+			thread_yield();
+	}
+	EXPECT_SIZEEQ(offset, size);
+	EXPECT_SIZEEQ(received, 201);
+
+	//A single segment is a plain datagram
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, payload, 10, segment, address), 10);
+
+	memory_deallocate(payload);
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, receive_offload) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	const network_address_t* address_from = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	udp_datagram_t datagrams[8];
+	char buffer[8][1024];
+	char* payload;
+	size_t segment = 500;
+	size_t size = 64 * 500 + 100;
+	size_t offset = 0;
+	size_t count, idgram, ibyte;
+	network_address_storage_t storage;
+	uint64_t timestamp = 0;
+	bool timestamping;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	//Set before the socket is opened, applied when bound
+	if (!udp_socket_set_receive_offload(sock_server, true)) {
+		socket_deallocate(sock_server);
+		socket_deallocate(sock_client);
+		return 0;
+	}
+	EXPECT_TRUE(udp_socket_receive_offload(sock_server));
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	EXPECT_TRUE(udp_socket_receive_offload(sock_server));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+	timestamping = (socket_set_timestamping(sock_server, SOCKETTIMESTAMP_RECEIVE) & SOCKETTIMESTAMP_RECEIVE) != 0;
+
+	payload = memory_allocate(0, size, 0, MEMORY_PERSISTENT);
+	for (ibyte = 0; ibyte < size; ++ibyte)
+		payload[ibyte] = (char)(ibyte / segment);
+
+	//Segmented sends are coalesced again on receive, callers still see single datagrams
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, payload, size, segment, address), size);
+
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_timestamp(sock_server, buffer[0], sizeof(buffer[0]), &address_from,
+	                                            &timestamp), segment);
+	EXPECT_EQ(memcmp(buffer[0], payload, segment), 0);
+	EXPECT_EQ(network_address_ip_port(address_from), network_address_ip_port(socket_address_local(sock_client)));
+	if (timestamping)
+		EXPECT_NE(timestamp, 0);
+	offset = segment;
+
+	for (idgram = 0; idgram < 8; ++idgram) {
+		datagrams[idgram].buffer = buffer[idgram];
+		datagrams[idgram].capacity = sizeof(buffer[idgram]);
+	}
+	socket_set_blocking(sock_server, false);
+	start = time_current();
+	while ((offset < size) && (time_elapsed(start) < REAL_C(5.0))) {
+		count = udp_socket_recvfrom_batch(sock_server, datagrams, 8);
+		for (idgram = 0; idgram < count; ++idgram) {
+			EXPECT_SIZEEQ(datagrams[idgram].size, (size - offset < segment) ? (size - offset) : segment);
+			EXPECT_EQ(memcmp(buffer[idgram], payload + offset, datagrams[idgram].size), 0);
+			EXPECT_EQ(network_address_ip_port(datagrams[idgram].address),
+			          network_address_ip_port(socket_address_local(sock_client)));
+			offset += datagrams[idgram].size;
+		}
+		if (!count)
+			thread_yield();
+	}
+	EXPECT_SIZEEQ(offset, size);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer[0], sizeof(buffer[0]), &address_from), 0);
+
+	//Coalesced receives go straight to caller storage without touching the heap
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, payload, segment * 3, segment, address), segment * 3);
+	socket_set_blocking(sock_server, true);
+	for (idgram = 0; idgram < 3; ++idgram) {
+		memset(&storage, 0, sizeof(storage));
+		EXPECT_SIZEEQ(udp_socket_recvfrom_storage(sock_server, buffer[0], sizeof(buffer[0]), &storage), segment);
+		EXPECT_EQ(memcmp(buffer[0], payload + (idgram * segment), segment), 0);
+		EXPECT_EQ(network_address_ip_port((const network_address_t*)&storage),
+		          network_address_ip_port(socket_address_local(sock_client)));
+	}
+	EXPECT_EQ(sock_server->address_remote, 0);
+
+	//Plain receives hand out the remaining segments with the source kept on the socket
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, payload, segment * 3, segment, address), segment * 3);
+	for (idgram = 0; idgram < 3; ++idgram) {
+		address_from = 0;
+		EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer[0], sizeof(buffer[0]), &address_from), segment);
+		EXPECT_EQ(memcmp(buffer[0], payload + (idgram * segment), segment), 0);
+		EXPECT_NE(address_from, 0);
+		EXPECT_EQ(network_address_ip_port(address_from), network_address_ip_port(socket_address_local(sock_client)));
+	}
+	socket_set_blocking(sock_server, false);
+
+	EXPECT_TRUE(udp_socket_set_receive_offload(sock_server, false));
+	EXPECT_FALSE(udp_socket_receive_offload(sock_server));
+
+	memory_deallocate(payload);
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, datagram_storage) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	network_address_storage_t storage[4];
+	socket_t* sock_server;
+	socket_t* sock_client[2];
+	udp_datagram_t datagrams[4];
+	char buffer[4][64];
+	size_t count, received;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client[0] = udp_socket_allocate();
+	sock_client[1] = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client[0], "first", 5, address), 5);
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client[1], "second", 6, address), 6);
+
+	//Addresses from separate receives do not alias each other
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_storage(sock_server, buffer[0], sizeof(buffer[0]), &storage[0]), 5);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_storage(sock_server, buffer[1], sizeof(buffer[1]), &storage[1]), 6);
+	EXPECT_EQ(network_address_family((network_address_t*)&storage[0]), NETWORK_ADDRESSFAMILY_IPV4);
+	EXPECT_EQ(network_address_ip_port((network_address_t*)&storage[0]),
+	          network_address_ip_port(socket_address_local(sock_client[0])));
+	EXPECT_EQ(network_address_ip_port((network_address_t*)&storage[1]),
+	          network_address_ip_port(socket_address_local(sock_client[1])));
+	EXPECT_FALSE(network_address_equal((network_address_t*)&storage[0], (network_address_t*)&storage[1]));
+
+	//Reply to a stored source address
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_server, "reply", 5, (network_address_t*)&storage[0]), 5);
+	socket_set_blocking(sock_client[0], true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_storage(sock_client[0], buffer[0], sizeof(buffer[0]), &storage[2]), 5);
+	EXPECT_TRUE(network_address_equal((network_address_t*)&storage[2], socket_address_local(sock_server)));
+
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client[1], "third", 5, address), 5);
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client[0], "fourth", 6, address), 6);
+	for (count = 0; count < 4; ++count) {
+		datagrams[count].buffer = buffer[count];
+		datagrams[count].capacity = sizeof(buffer[count]);
+	}
+	received = 0;
+	start = time_current();
+	while ((received < 2) && (time_elapsed(start) < REAL_C(5.0))) {
+		count = udp_socket_recvfrom_batch_storage(sock_server, datagrams + received, storage + received,
+		                                          2 - received);
+		EXPECT_TRUE(!count || (datagrams[received].address == (network_address_t*)&storage[received]));
+		received += count;
+	}
+	EXPECT_SIZEEQ(received, 2);
+	EXPECT_SIZEEQ(datagrams[0].size, 5);
+	EXPECT_SIZEEQ(datagrams[1].size, 6);
+	EXPECT_EQ(network_address_ip_port(datagrams[0].address),
+	          network_address_ip_port(socket_address_local(sock_client[1])));
+	EXPECT_EQ(network_address_ip_port(datagrams[1].address),
+	          network_address_ip_port(socket_address_local(sock_client[0])));
+
+	//No socket owned address was needed
+	EXPECT_EQ(sock_server->address_remote, 0);
+	EXPECT_EQ(sock_server->address_batch, 0);
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client[0]);
+	socket_deallocate(sock_client[1]);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, datagram_connected) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	network_address_storage_t storage;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	socket_t* sock_stray;
+	udp_datagram_t datagrams[8];
+	socket_iovec_t iov[2];
+	char buffer[8][4096];
+	char data[3000];
+	const network_address_t* source;
+	size_t count, received, total;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+	sock_stray = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	EXPECT_TRUE(socket_bind(sock_client, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	EXPECT_TRUE(socket_connect(sock_client, address, 0));
+	EXPECT_TRUE(socket_connect(sock_server, socket_address_local(sock_client), 0));
+	EXPECT_EQ(socket_state(sock_client), SOCKETSTATE_CONNECTED);
+
+	//Connected server only sees datagrams from the client
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_stray, "stray", 5, address), 5);
+
+	EXPECT_SIZEEQ(socket_write(sock_client, "write", 5), 5);
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client, "sendto", 6, 0), 6);
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client, "peer", 4, socket_address_remote(sock_client)), 4);
+	iov[0].buffer = (void*)"vec";
+	iov[0].length = 3;
+	iov[1].buffer = (void*)"tor";
+	iov[1].length = 3;
+	EXPECT_SIZEEQ(udp_socket_sendtov(sock_client, iov, 2, 0), 6);
+	for (count = 0; count < 2; ++count) {
+		datagrams[count].buffer = (void*)"batch";
+		datagrams[count].size = 5;
+		datagrams[count].address = 0;
+	}
+	EXPECT_SIZEEQ(udp_socket_sendto_batch(sock_client, datagrams, 2), 2);
+
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer[0], sizeof(buffer[0]), &source), 5);
+	EXPECT_EQ(memcmp(buffer[0], "write", 5), 0);
+	EXPECT_TRUE(network_address_equal(source, socket_address_local(sock_client)));
+	EXPECT_SIZEEQ(udp_socket_recvfrom_storage(sock_server, buffer[0], sizeof(buffer[0]), &storage), 6);
+	EXPECT_EQ(memcmp(buffer[0], "sendto", 6), 0);
+	EXPECT_TRUE(network_address_equal((network_address_t*)&storage, socket_address_local(sock_client)));
+	EXPECT_SIZEEQ(socket_read(sock_server, buffer[0], sizeof(buffer[0])), 4);
+	EXPECT_EQ(memcmp(buffer[0], "peer", 4), 0);
+
+	for (count = 0; count < 8; ++count) {
+		datagrams[count].buffer = buffer[count];
+		datagrams[count].capacity = sizeof(buffer[count]);
+	}
+	received = 0;
+	start = time_current();
+	while ((received < 3) && (time_elapsed(start) < REAL_C(5.0)))
+		received += udp_socket_recvfrom_batch(sock_server, datagrams + received, 3 - received);
+	EXPECT_SIZEEQ(received, 3);
+	EXPECT_SIZEEQ(datagrams[0].size, 6);
+	EXPECT_EQ(memcmp(buffer[0], "vector", 6), 0);
+	EXPECT_SIZEEQ(datagrams[1].size, 5);
+	EXPECT_SIZEEQ(datagrams[2].size, 5);
+	EXPECT_TRUE(network_address_equal(datagrams[2].address, socket_address_local(sock_client)));
+
+	//Segmented sends go to the peer as well
+	for (count = 0; count < sizeof(data); ++count)
+		data[count] = (char)count;
+	EXPECT_SIZEEQ(udp_socket_sendto_segmented(sock_client, data, sizeof(data), 1000, 0), sizeof(data));
+	received = 0;
+	total = 0;
+	start = time_current();
+	while ((received < 3) && (time_elapsed(start) < REAL_C(5.0))) {
+		count = udp_socket_recvfrom_batch(sock_server, datagrams + received, 3 - received);
+		for (; count; --count, ++received) {
+			EXPECT_SIZEEQ(datagrams[received].size, 1000);
+			EXPECT_EQ(memcmp(buffer[received], data + total, 1000), 0);
+			total += datagrams[received].size;
+		}
+	}
+	EXPECT_SIZEEQ(total, sizeof(data));
+
+	//The stray datagram was dropped
+	socket_set_blocking(sock_server, false);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer[0], sizeof(buffer[0]), &source), 0);
+
+	//Replies from the connected server reach the client
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_server, "reply", 5, 0), 5);
+	socket_set_blocking(sock_client, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_client, buffer[0], sizeof(buffer[0]), &source), 5);
+	EXPECT_TRUE(network_address_equal(source, socket_address_local(sock_server)));
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+	socket_deallocate(sock_stray);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, buffer_size) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	const network_address_t* address_from = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	char buffer[1024];
+	size_t initial_size;
+	int iaddr, asize, iloop;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	//Requested size is kept until the descriptor is created, then reported by the kernel
+	EXPECT_SIZEEQ(socket_set_receive_buffer_size(sock_server, 4096), 4096);
+	EXPECT_SIZEEQ(socket_receive_buffer_size(sock_server), 4096);
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	initial_size = socket_receive_buffer_size(sock_server);
+	EXPECT_SIZEGE(initial_size, 2048);
+	EXPECT_SIZEGT(socket_set_send_buffer_size(sock_client, 65536), 0);
+	socket_set_receive_buffer_autotune(sock_server, 1024 * 1024);
+
+	memset(buffer, 0x11, sizeof(buffer));
+	for (iloop = 0; iloop < 256; ++iloop)
+		udp_socket_sendto(sock_client, buffer, sizeof(buffer), address);
+
+	while (udp_socket_recvfrom(sock_server, buffer, sizeof(buffer), &address_from))
+		;
+
+	//Drop count is reported with the first datagram queued after the drops
+	udp_socket_sendto(sock_client, buffer, sizeof(buffer), address);
+	thread_sleep(10);
+	EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer, sizeof(buffer), &address_from), sizeof(buffer));
+#if FOUNDATION_PLATFORM_LINUX || FOUNDATION_PLATFORM_ANDROID
+	EXPECT_SIZEGT(socket_receive_dropped(sock_server), 0);
+	EXPECT_SIZEGT(socket_receive_buffer_size(sock_server), initial_size);
+#endif
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, timestamp) {
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	const network_address_t* address_from = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	socket_timestamp_t stamps[4];
+	network_poll_t* poll;
+	network_poll_event_t events[8];
+	char buffer[256];
+	uint64_t timestamp = 0;
+	size_t num_stamps = 0;
+	bool notified = false;
+	unsigned int flags;
+	int iaddr, asize;
+	tick_t start;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	flags = socket_set_timestamping(sock_server, SOCKETTIMESTAMP_RECEIVE);
+	if (!(flags & SOCKETTIMESTAMP_RECEIVE)) {
+		memory_deallocate(address);
+		socket_deallocate(sock_server);
+		socket_deallocate(sock_client);
+		return 0;
+	}
+	EXPECT_EQ(socket_timestamping(sock_server), SOCKETTIMESTAMP_RECEIVE);
+	flags = socket_set_timestamping(sock_client, SOCKETTIMESTAMP_TRANSMIT);
+
+	memset(buffer, 0x42, sizeof(buffer));
+	EXPECT_SIZEEQ(udp_socket_sendto(sock_client, buffer, sizeof(buffer), address), sizeof(buffer));
+
+	socket_set_blocking(sock_server, true);
+	EXPECT_SIZEEQ(udp_socket_recvfrom_timestamp(sock_server, buffer, sizeof(buffer), &address_from,
+	                                            &timestamp), sizeof(buffer));
+	EXPECT_NE(timestamp, 0);
+
+	if (flags & SOCKETTIMESTAMP_TRANSMIT) {
+		poll = network_poll_allocate(1);
+		network_poll_add_socket(poll, sock_client);
+		start = time_current();
+		while (!notified && (time_elapsed(start) < REAL_C(2.0))) {
+			size_t num_events = network_poll(poll, events, sizeof(events) / sizeof(events[0]), 100);
+			notified = (num_events && (events[0].event == NETWORKEVENT_TIMESTAMP));
+		}
+		EXPECT_TRUE(notified);
+
+		//Poll drained the error queue, no repeated notification before the timestamp is read
+		EXPECT_SIZEEQ(network_poll(poll, events, sizeof(events) / sizeof(events[0]), 10), 0);
+		num_stamps = socket_transmit_timestamps(sock_client, stamps, sizeof(stamps) / sizeof(stamps[0]));
+		network_poll_deallocate(poll);
+
+		EXPECT_SIZEEQ(num_stamps, 1);
+		EXPECT_EQ(stamps[0].id, 0);
+		EXPECT_NE(stamps[0].time, 0);
+	}
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+
+	return 0;
+}
+
+DECLARE_TEST(udp, capture) {
+#if FOUNDATION_PLATFORM_POSIX
+	network_address_t** address_local = 0;
+	network_address_t* address = 0;
+	socket_t* sock_server;
+	socket_t* sock_client;
+	stream_t* stream;
+	char filename[] = "/tmp/network_capture_XXXXXX";
+	char buffer[300];
+	uint8_t record[256];
+	uint32_t header[6];
+	uint16_t version[2];
+	uint16_t port;
+	int iaddr, asize, iloop, fd;
+
+	if (!network_supports_ipv4())
+		return 0;
+
+	fd = mkstemp(filename);
+	EXPECT_GE(fd, 0);
+	close(fd);
+
+	sock_server = udp_socket_allocate();
+	sock_client = udp_socket_allocate();
+
+	address_local = network_address_local();
+	for (iaddr = 0, asize = array_size(address_local); iaddr < asize; ++iaddr) {
+		if (network_address_family(address_local[iaddr]) == NETWORK_ADDRESSFAMILY_IPV4) {
+			address = network_address_clone(address_local[iaddr]);
+			break;
+		}
+	}
+	network_address_array_deallocate(address_local);
+	EXPECT_NE(address, 0);
+
+	network_address_ip_set_port(address, 0);
+	EXPECT_TRUE(socket_bind(sock_server, address));
+	network_address_ip_set_port(address, network_address_ip_port(socket_address_local(sock_server)));
+
+	//Only the marked client socket is captured, payload truncated to snap length
+	socket_set_capture(sock_client, true);
+	EXPECT_TRUE(socket_capture(sock_client));
+	EXPECT_TRUE(network_capture_start(filename, string_length(filename), 64, 0));
+	EXPECT_TRUE(network_capture_is_active());
+	EXPECT_FALSE(network_capture_start(filename, string_length(filename), 64, 0));
+
+	for (iloop = 0; iloop < 3; ++iloop) {
+		memset(buffer, iloop + 1, sizeof(buffer));
+		EXPECT_SIZEEQ(udp_socket_sendto(sock_client, buffer, sizeof(buffer), address), sizeof(buffer));
+	}
+	socket_set_blocking(sock_server, true);
+	for (iloop = 0; iloop < 3; ++iloop)
+		EXPECT_SIZEEQ(udp_socket_recvfrom(sock_server, buffer, sizeof(buffer), nullptr), sizeof(buffer));
+
+	network_capture_stop();
+	EXPECT_FALSE(network_capture_is_active());
+	EXPECT_SIZEEQ(network_capture_dropped(), 0);
+
+	stream = stream_open(filename, string_length(filename), STREAM_IN | STREAM_BINARY);
+	EXPECT_NE(stream, 0);
+	EXPECT_SIZEEQ(stream_read(stream, header, sizeof(header)), sizeof(header));
+	EXPECT_UINTEQ(header[0], 0xa1b23c4d);
+	memcpy(version, header + 1, sizeof(version));
+	EXPECT_UINTEQ(version[0], 2);
+	EXPECT_UINTEQ(version[1], 4);
+	EXPECT_UINTEQ(header[5], 101);
+	for (iloop = 0; iloop < 3; ++iloop) {
+		EXPECT_SIZEEQ(stream_read(stream, record, 16 + 20 + 8 + 64), 16 + 20 + 8 + 64);
+		memcpy(header, record, 16);
+		EXPECT_UINTEQ(header[2], 20 + 8 + 64);
+		EXPECT_UINTEQ(header[3], 20 + 8 + sizeof(buffer));
+		EXPECT_EQ(record[16], 0x45);
+		EXPECT_EQ(record[16 + 9], 17);
+		memcpy(&port, record + 16 + 20 + 2, sizeof(port));
+		EXPECT_UINTEQ(byteorder_bigendian16(port), network_address_ip_port(address));
+		EXPECT_EQ(record[16 + 20 + 8], iloop + 1);
+		EXPECT_EQ(record[16 + 20 + 8 + 63], iloop + 1);
+	}
+	EXPECT_SIZEEQ(stream_read(stream, record, sizeof(record)), 0);
+	stream_deallocate(stream);
+	unlink(filename);
+
+	memory_deallocate(address);
+	socket_deallocate(sock_server);
+	socket_deallocate(sock_client);
+#endif
+	return 0;
+}
+
 void
 test_udp_declare(void) {
 	ADD_TEST(udp, stream_ipv4);
 	ADD_TEST(udp, stream_ipv6);
 	ADD_TEST(udp, datagram_ipv4);
 	ADD_TEST(udp, datagram_ipv6);
+	ADD_TEST(udp, datagram_vectored);
+	ADD_TEST(udp, datagram_batch);
+	ADD_TEST(udp, datagram_send_batch);
+	ADD_TEST(udp, datagram_segmented);
+	ADD_TEST(udp, datagram_storage);
+	ADD_TEST(udp, datagram_connected);
+	ADD_TEST(udp, receive_offload);
+	ADD_TEST(udp, buffer_size);
+	ADD_TEST(udp, timestamp);
+	ADD_TEST(udp, capture);
 }
 
 test_suite_t test_udp_suite = {
@@ -13,6 +13,8 @@
 #include "client.h"
 #include "reader.h"
 
+#define BLAST_CLIENT_SEND_BATCH 16
+
 typedef struct blast_pending_t {
 	uint64_t         seq;
 	tick_t           last_send;
@@ -204,9 +206,14 @@ blast_client_handshake(blast_client_t* client) {
 				          blast_timestamp_elapsed_ms(client->begin_send, packet->timestamp));
 
 				if (!client->sock) {
-					client->target = address;
 					client->sock = client->socks[isock];
 					client->socks[isock] = 0;
+					//Lock on to the answering server, the transfer then sends without a destination
+					//and the kernel drops datagrams from other sources
+					if (socket_connect(client->sock, address, 0))
+						client->target = socket_address_remote(client->sock);
+					else
+						client->target = address;
 				}
 
 				if (client->state == BLAST_STATE_HANDSHAKE) {
@@ -272,42 +279,91 @@ blast_client_process_ack(blast_client_t* client, uint32_t* seq, tick_t timestamp
 }
 
 static int
-blast_client_send_data_chunk(blast_client_t* client, uint64_t seq) {
-	packet_payload_t packet;
+blast_client_prepare_data_chunk(blast_client_t* client, uint64_t seq, packet_payload_t* packet) {
 	void* data;
-	uint64_t res;
 
-	packet.type = PACKET_PAYLOAD;
-	packet.token = client->token;
-	packet.timestamp = blast_timestamp(client->begin_send);
-	packet.seq = seq;
+	packet->type = PACKET_PAYLOAD;
+	packet->token = client->token;
+	packet->timestamp = blast_timestamp(client->begin_send);
+	packet->seq = seq;
 
 	data = client->readers[client->current]->map(client->readers[client->current],
-	                                             packet.seq * PACKET_CHUNK_SIZE, PACKET_CHUNK_SIZE);
+	                                             packet->seq * PACKET_CHUNK_SIZE, PACKET_CHUNK_SIZE);
 	if (!data) {
 		log_errorf(HASH_BLAST, ERROR_SYSTEM_CALL_FAIL,
 		           STRING_CONST("Unable to map source segment at offset %lld"),
-		           packet.seq * PACKET_CHUNK_SIZE);
+		           packet->seq * PACKET_CHUNK_SIZE);
 		return BLAST_ERROR_UNABLE_TO_READ_FILE;
 	}
-	memcpy(packet.data, data, PACKET_CHUNK_SIZE);
+	memcpy(packet->data, data, PACKET_CHUNK_SIZE);
 	client->readers[client->current]->unmap(client->readers[client->current], data,
-	                                        packet.seq * PACKET_CHUNK_SIZE, PACKET_CHUNK_SIZE);
+	                                        packet->seq * PACKET_CHUNK_SIZE, PACKET_CHUNK_SIZE);
 
 	/*
 	#if BUILD_ENABLE_LOG
 		char* addr = network_address_to_string( client->target, true );
-		log_infof( HASH_BLAST, "Send payload to %s (seq %lld, timestamp %lld) token %d (file %d/%d)", addr, packet.seq, (tick_t)packet.timestamp, packet.token, client->current + 1, array_size( client->readers ) );
+		log_infof( HASH_BLAST, "Send payload to %s (seq %lld, timestamp %lld) token %d (file %d/%d)", addr, packet->seq, (tick_t)packet->timestamp, packet->token, client->current + 1, array_size( client->readers ) );
 		string_deallocate( addr );
 	#endif
 	*/
 
+	return 0;
+}
+
+static int
+blast_client_send_data_chunk(blast_client_t* client, uint64_t seq) {
+	packet_payload_t packet;
+	uint64_t res;
+	int ret;
+
+	ret = blast_client_prepare_data_chunk(client, seq, &packet);
+	if (ret < 0)
+		return ret;
+
 	size_t payload_size = sizeof(packet_payload_t);
 	res = udp_socket_sendto(client->sock, &packet, payload_size, client->target);
 
 	return (res == payload_size ? 0 : -1);
 }
 
+static int
+blast_client_send_data_batch(blast_client_t* client, int max_send, tick_t timestamp) {
+	packet_payload_t packets[BLAST_CLIENT_SEND_BATCH];
+	blast_pending_t pending;
+	size_t count = 0;
+	size_t sent, isent;
+	int ret = 0;
+
+	while (((int)count < max_send) && (count < BLAST_CLIENT_SEND_BATCH) &&
+	        (client->seq * PACKET_CHUNK_SIZE < client->readers[client->current]->size)) {
+		ret = blast_client_prepare_data_chunk(client, blast_seq(client->seq), packets + count);
+		if (ret < 0)
+			break;
+		++client->seq;
+		++count;
+	}
+
+	//Packets are contiguous and equally sized, let the kernel split them into datagrams
+	sent = count ? udp_socket_sendto_segmented(client->sock, packets, sizeof(packet_payload_t) * count,
+	                                           sizeof(packet_payload_t), client->target) : 0;
+	sent /= sizeof(packet_payload_t);
+	for (isent = 0; isent < sent; ++isent) {
+		pending.seq = packets[isent].seq;
+		pending.last_send = client->last_send;
+		array_push(client->pending, pending);
+		client->last_send = timestamp;
+		client->packets_sent++;
+	}
+
+	//Unsent packets are prepared again on the next call
+	if (sent < count) {
+		client->seq -= count - sent;
+		ret = -1;
+	}
+
+	return (ret < 0) ? ret : (int)sent;
+}
+
 static int
 blast_client_congest_control(blast_client_t* client, tick_t current) {
 	static float64_t mbps = 20.0;
@@ -322,7 +378,6 @@ blast_client_congest_control(blast_client_t* client, tick_t current) {
 
 static int
 blast_client_send_data(blast_client_t* client) {
-	blast_pending_t pending;
 	bool only_pending;
 	int ret = 0;
 	uint64_t timestamp;
@@ -354,16 +409,10 @@ blast_client_send_data(blast_client_t* client) {
 
 	while ((num_sent < max_sent) &&
 	        (client->seq * PACKET_CHUNK_SIZE < client->readers[client->current]->size)) {
-		uint64_t seq = blast_seq(client->seq++);
-		ret = blast_client_send_data_chunk(client, seq);
-		if (ret < 0)
+		ret = blast_client_send_data_batch(client, max_sent - num_sent, timestamp);
+		if (ret <= 0)
 			break;
-		pending.seq = seq;
-		pending.last_send = client->last_send;
-		array_push(client->pending, pending);
-		client->last_send = timestamp;
-		client->packets_sent++;
-		++num_sent;
+		num_sent += ret;
 
 		blast_client_report_progress(client, false);
 	}
@@ -14,6 +14,7 @@
 #include "writer.h"
 
 #define BLAST_SERVER_TIMEOUT 30
+#define BLAST_SERVER_READ_BATCH 16
 
 typedef struct blast_server_source_t {
 	network_address_t*       address;
@@ -258,25 +259,35 @@ blast_server_process_payload(blast_server_t* server, socket_t* sock,
 
 static bool
 blast_server_read(blast_server_t* server, socket_t* sock) {
-	const network_address_t* address = 0;
-	char databuf[PACKET_DATABUF_SIZE];
-	size_t size = udp_socket_recvfrom(sock, databuf, sizeof(databuf), &address);
-	if (size == 0)
-		return false;
-	while (size > 0) {
-		packet_t* packet = (packet_t*)databuf;
-		if (packet->type == PACKET_HANDSHAKE) {
-			blast_server_process_handshake(server, sock, databuf, size, address);
-		}
-		else if (packet->type == PACKET_PAYLOAD) {
-			blast_server_process_payload(server, sock, databuf, size, address);
-		}
-		else {
-			log_warnf(HASH_BLAST, WARNING_SUSPICIOUS, STRING_CONST("Unknown datagram on socket"));
+	udp_datagram_t datagrams[BLAST_SERVER_READ_BATCH];
+	network_address_storage_t addresses[BLAST_SERVER_READ_BATCH];
+	char databuf[BLAST_SERVER_READ_BATCH][PACKET_DATABUF_SIZE];
+	size_t count, idgram;
+	bool received = false;
+
+	for (idgram = 0; idgram < BLAST_SERVER_READ_BATCH; ++idgram) {
+		datagrams[idgram].buffer = databuf[idgram];
+		datagrams[idgram].capacity = sizeof(databuf[idgram]);
+	}
+
+	while ((count = udp_socket_recvfrom_batch_storage(sock, datagrams, addresses, BLAST_SERVER_READ_BATCH)) > 0) {
+		received = true;
+		for (idgram = 0; idgram < count; ++idgram) {
+			packet_t* packet = (packet_t*)databuf[idgram];
+			size_t size = datagrams[idgram].size;
+			const network_address_t* address = datagrams[idgram].address;
+			if (packet->type == PACKET_HANDSHAKE) {
+				blast_server_process_handshake(server, sock, databuf[idgram], size, address);
+			}
+			else if (packet->type == PACKET_PAYLOAD) {
+				blast_server_process_payload(server, sock, databuf[idgram], size, address);
+			}
+			else {
+				log_warnf(HASH_BLAST, WARNING_SUSPICIOUS, STRING_CONST("Unknown datagram on socket"));
+			}
 		}
-		size = udp_socket_recvfrom(sock, databuf, sizeof(databuf), &address);
 	}
-	return true;
+	return received;
 }
 
 static void
@@ -362,6 +373,8 @@ blast_server(network_address_t** bind, bool daemon) {
 		socket_t* sock = udp_socket_allocate();
 
 		socket_set_blocking(sock, false);
+		//Payload streams arrive as runs of equal sized datagrams, let the kernel coalesce them
+		udp_socket_set_receive_offload(sock, true);
 
 		if (!network_address_ip_port(bind[isock]) && port)
 			network_address_ip_set_port(bind[isock], port);
@@ -0,0 +1,154 @@
+/* main.c  -  Network trace dump tool  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a network abstraction built on foundation streams. The latest source code is
+ * always available at
+ *
+ * https://github.com/rampantpixels/network_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without any restrictions.
+ *
+ */
+
+#include <foundation/foundation.h>
+#include <network/network.h>
+
+#include <stdlib.h>
+
+typedef struct {
+	uint64_t               thread;
+	network_trace_record_t record;
+} tracedump_entry_t;
+
+static void
+tracedump_print_usage(void);
+
+static int
+tracedump_file(const string_const_t path);
+
+int
+main_initialize(void) {
+	int ret = 0;
+	foundation_config_t config;
+	application_t application;
+
+	memset(&config, 0, sizeof(config));
+
+	memset(&application, 0, sizeof(application));
+	application.name = string_const(STRING_CONST("tracedump"));
+	application.short_name = string_const(STRING_CONST("tracedump"));
+	application.company = string_const(STRING_CONST("Rampant Pixels"));
+	application.flags = APPLICATION_UTILITY;
+
+	log_enable_prefix(false);
+	log_set_suppress(0, ERRORLEVEL_DEBUG);
+
+	if ((ret = foundation_initialize(memory_system_malloc(), application, config)) < 0)
+		return ret;
+
+	return 0;
+}
+
+int
+main_run(void* main_arg) {
+	const string_const_t* cmdline = environment_command_line();
+	int arg, asize;
+	int result = 0;
+
+	FOUNDATION_UNUSED(main_arg);
+
+	for (arg = 1, asize = array_size(cmdline); arg < asize; ++arg) {
+		if ((cmdline[arg].length > 1) && (cmdline[arg].str[0] == '-'))
+			continue;
+		if (tracedump_file(cmdline[arg]) < 0)
+			result = -1;
+	}
+
+	if (asize < 2)
+		tracedump_print_usage();
+
+	return result;
+}
+
+void
+main_finalize(void) {
+	foundation_finalize();
+}
+
+static int
+tracedump_compare(const void* lhs, const void* rhs) {
+	const tracedump_entry_t* first = lhs;
+	const tracedump_entry_t* second = rhs;
+	if (first->record.time < second->record.time)
+		return -1;
+	return (first->record.time > second->record.time) ? 1 : 0;
+}
+
+static int
+tracedump_file(const string_const_t path) {
+	network_trace_header_t header;
+	tracedump_entry_t* entries = 0;
+	stream_t* stream;
+	uint64_t ithread;
+	size_t ientry, esize;
+
+	stream = stream_open(STRING_ARGS(path), STREAM_IN | STREAM_BINARY);
+	if (!stream) {
+		log_errorf(0, ERROR_INVALID_VALUE, STRING_CONST("Unable to open trace file: %.*s"),
+		           STRING_FORMAT(path));
+		return -1;
+	}
+
+	if ((stream_read(stream, &header, sizeof(header)) != sizeof(header)) ||
+	        (header.magic != NETWORK_TRACE_MAGIC) || (header.version != NETWORK_TRACE_VERSION) ||
+	        !header.ticks_per_second) {
+		log_errorf(0, ERROR_INVALID_VALUE,
+		           STRING_CONST("Invalid trace file or byte order: %.*s"), STRING_FORMAT(path));
+		stream_deallocate(stream);
+		return -1;
+	}
+
+	for (ithread = 0; ithread < header.threads; ++ithread) {
+		uint64_t block[2];
+		uint64_t irec;
+		if (stream_read(stream, block, sizeof(block)) != sizeof(block))
+			break;
+		for (irec = 0; irec < block[1]; ++irec) {
+			tracedump_entry_t entry;
+			entry.thread = block[0];
+			if (stream_read(stream, &entry.record, sizeof(entry.record)) != sizeof(entry.record))
+				break;
+			array_push_memcpy(entries, &entry);
+		}
+	}
+	stream_deallocate(stream);
+
+	esize = array_size(entries);
+	if (esize)
+		qsort(entries, esize, sizeof(tracedump_entry_t), tracedump_compare);
+
+	log_infof(0, STRING_CONST("%.*s: %" PRIsize " records from %" PRIu64 " threads, started at %" PRItick " ms"),
+	          STRING_FORMAT(path), esize, header.threads, header.time_base);
+	for (ientry = 0; ientry < esize; ++ientry) {
+		const network_trace_record_t* record = &entries[ientry].record;
+		double seconds = (double)(record->time - header.tick_base) / (double)header.ticks_per_second;
+		string_const_t name = network_trace_event_name((network_trace_event_t)record->event);
+		log_infof(0, STRING_CONST("%14.6f thread %-16" PRIx64 " %-8.*s socket 0x%016" PRIx64
+		                          " fd %-6d bytes %-10" PRIu64 " error %u"),
+		          seconds, entries[ientry].thread, STRING_FORMAT(name), record->sock,
+		          record->fd, record->bytes, (unsigned int)record->error);
+	}
+
+	array_deallocate(entries);
+
+	return 0;
+}
+
+static void
+tracedump_print_usage(void) {
+	log_info(0, STRING_CONST(
+	             "tracedump usage:\n"
+	             "  tracedump <file> <file> <...>\n"
+	             "    Decode binary network trace files written by network_trace_write\n"
+	             "      <file>                   Trace file name (multiple)\n"
+	         ));
+}